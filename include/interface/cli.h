@@ -2,5 +2,24 @@
 
 
 namespace khnum {
-void RunCli();
+// Options:
+// --parser=openflux|maranas --model=path
+// --starts=N --threads=N (0 is the hardware concurrency) --pin --seed=N --basin-registry --basin-radius=R
+// --optimizer=alglib|native|geodesic --adaptive-tolerance --sampling=box|hit-and-run|halton (box by default)
+// --exchange-transform --exchange-scale=S --scaling=true|false (false by default)
+// --free-fluxes=priority|qr
+// --identifiability=off|warn|fix --identifiability-points=N
+// --screening-iterations=N (0 is no successive halving) --halving-factor=N
+// --time-budget=seconds --prioritize=true|false (true with the budget)
+// --start-log=path (no log by default) --resume (of the existing log)
+// --warm-start-library=directory --warm-start-fraction=F --warm-start-perturbation=P
+// --global=multistart|de --population=N (0 is 10 per free flux) --generations=N --polished=N --target-ssr=SSR
+// --telemetry=off|csv|json --telemetry-output=path
+// --linearized=true|false
+// --profile=off|free|all --profile-steps=N
+// --monte-carlo=N (0 is off) --resampling=measurements|residuals --monte-carlo-output=path
+// --posterior=off|mala|am --chains=N --burn-in=N --posterior-samples=N --thinning=N --posterior-output=path
+// --batch=directory of measurements csv --batch-output=path, the options of the logs, the time budget, the warm
+// starts, the screening, the basins, the global search and the statistics can't be used with it
+void RunCli(int argc, char **argv);
 }//namespace khnum
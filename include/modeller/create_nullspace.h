@@ -6,7 +6,20 @@
 
 namespace khnum {
 namespace modelling_utills {
-Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reactions);
+enum class FreeFluxSelection {
+    priority,  ///< the order of SortReactionsByType, the columns are swapped only at the zero pivots
+    pivoted_qr ///< the dependent fluxes are chosen by the column-pivoted QR, the fixed and set free fluxes stay free
+};
+
+// Returns A, Vdep = -A * Vfree. The reactions are reordered so the dependent fluxes go before the free ones
+Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reactions,
+                    FreeFluxSelection selection = FreeFluxSelection::priority);
+
+// Chooses the best conditioned basis of the stoichiometry matrix columns, linearly dependent metabolite rows are dropped
+Matrix GetNullspaceWithPivotedQR(const Matrix& original_matrix, std::vector<Reaction> &reactions);
+
+// Ratio of the largest and the smallest singular values
+double GetConditionNumber(const Matrix &matrix);
 
 bool ExchangeRowsToMakePivotNotNull(Matrix &matrix, const int column);
 
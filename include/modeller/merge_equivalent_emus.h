@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include "utilities/emu.h"
+
+
+namespace khnum {
+namespace modelling_utills {
+// An EMU is equivalent to the substrate EMU if every reaction producing it transfers all its atoms
+// from this substrate (pass-through metabolites, atoms which never separate), so their MIDs are equal for any fluxes.
+// Replaces such EMUs by the substrate and removes the reactions producing them.
+// Measured and input EMUs are kept
+std::vector<EmuReaction> MergeEquivalentEmus(const std::vector<EmuReaction> &reactions,
+                                             const std::vector<Emu> &measured_isotopes,
+                                             const std::vector<Emu> &input_emu_list);
+
+// Returns the number of unknown EMUs of the reactions, i.e. the produced ones, without building the networks
+size_t GetUnknownEmusCount(const std::vector<EmuReaction> &reactions);
+
+// Returns the number of unknown EMUs of the largest network component of the reactions, without building the networks
+size_t GetLargestNetworkSize(const std::vector<EmuReaction> &reactions, const std::vector<Emu> &input_emu_list);
+
+// Returns the total number of unknown EMUs and the largest network size
+std::pair<size_t, size_t> GetNetworksSize(const std::vector<EmuNetwork> &networks);
+} // namespace modelling_utills
+} // namespace khnum
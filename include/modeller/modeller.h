@@ -3,6 +3,7 @@
 #include "utilities/problem.h"
 #include "utilities/matrix.h"
 #include "parser/parser_results.h"
+#include "modeller/create_nullspace.h"
 
 
 namespace khnum {
@@ -14,10 +15,14 @@ public:
 
     void CreateEmuNetworks();
 
-    void CreateNullspaceMatrix();
+    void CreateNullspaceMatrix(modelling_utills::FreeFluxSelection selection =
+                                   modelling_utills::FreeFluxSelection::priority);
 
     void CalculateFluxBounds();
 
+    // Replaces the constraints nullspace * Vfree <= 0 by an equivalent smaller set, tightens the bounds
+    void PresolveConstraints();
+
     void CalculateMeasurementsCount();
 
     void CheckModelForErrors();
@@ -25,6 +30,8 @@ public:
     Problem GetProblem();
 
 private:
+    std::vector<EmuNetwork> CreateNetworkComponents(const std::vector<EmuReaction> &emu_reactions) const;
+
     std::vector<Reaction> reactions_;
     std::vector<Emu> measured_isotopes_;
     std::vector<Measurement> measurements_;
@@ -43,6 +50,7 @@ private:
 
     std::vector<double> lower_bounds_;
     std::vector<double> upper_bounds_;
+    LinearConstraints constraints_;
 
     int measurements_count_ = 0;
 };
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+namespace modelling_utills {
+// Reduces the constraints nullspace * Vfree <= 0 to an equivalent smaller set with GLPK:
+// tightens the free flux bounds to the extreme feasible values, moves the fixed fluxes to the right part,
+// removes the rows implied by the bounds, merges the parallel rows
+// and removes the rows implied by the other rows.
+// The bounds are tightened in place
+LinearConstraints PresolveConstraints(const Matrix &nullspace,
+                                      std::vector<double> &lower_bounds,
+                                      std::vector<double> &upper_bounds);
+
+// Returns the minimum and the maximum of objective * Vfree subject to the bounds and the constraints
+std::pair<double, double> GetFeasibleRange(const Eigen::VectorXd &objective,
+                                           const LinearConstraints &constraints,
+                                           const std::vector<double> &lower_bounds,
+                                           const std::vector<double> &upper_bounds);
+} // namespace modelling_utills
+} // namespace khnum
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "utilities/emu_and_mid.h"
 #include "utilities/reaction.h"
@@ -49,6 +50,8 @@ struct NetworkEmu {
     int order_in_usefull_emus;
 };
 
+using KnownEmus = std::unordered_map<Emu, NetworkEmu>;
+
 struct FinalEmu {
     Emu emu;
     int order_in_X;
@@ -4,15 +4,29 @@
 #include "simulator/simulator.h"
 
 namespace khnum {
+// of the linear system A * X = B * Y of one network
+struct NetworkSystemSize {
+    size_t unknown_emus;
+    size_t known_emus;
+    size_t A_nonzeros;
+    size_t B_nonzeros;
+};
+
 class SimulatorGenerator {
 public:
     SimulatorGenerator(const GeneratorParameters& parameters);
 
     Simulator Generate() const;
 
+    std::vector<NetworkSystemSize> GetSystemSizes() const;
+
+    // The free fluxes the sensitivities of every network are propagated for, the others are zero
+    std::vector<std::vector<size_t>> GetInfluencingFluxes() const;
+
 private:
-    std::vector<NetworkEmu> InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const;
+    KnownEmus InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const;
     SimulatorNetworkData FillSimulatorNetworkData(const GeneratorNetworkData& network_data, int network_size) const;
+    void FindInfluencingFluxes();
 
     GeneratorParameters parameters_;
 
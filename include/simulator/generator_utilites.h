@@ -13,38 +13,36 @@
 namespace khnum {
 namespace generator_utilites {
 void FillEmuLists(const std::vector<EmuReaction>& reactions,
-                  std::vector<NetworkEmu>& all_known_emus,
+                  KnownEmus& all_known_emus,
                   GeneratorNetworkData& network_data,
                   std::vector<std::vector<int>>& usefull_emus);
 
 void CheckAndInsertEmu(const Emu &emu,
-                       std::vector<NetworkEmu>& all_known_emus,
+                       KnownEmus& all_known_emus,
                        GeneratorNetworkData& network_data,
                        std::vector<std::vector<int>>& usefull_emus);
 
 
 Convolution ConvolveReaction(const EmuReaction& reaction,
-                             std::vector<NetworkEmu>& all_known_emus,
+                             KnownEmus& all_known_emus,
                              std::vector<std::vector<int>>& usefull_emus);
 
+// Assembles the sparse symbolic matrices directly, the elements are ordered by (i, j)
 void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
                             GeneratorNetworkData& network_data);
 
-int FindUnknownEmuPosition(const Emu &emu,
-                           const std::vector<Emu>& unknown_emus);
-
-int FindKnownEmuPosition(const Emu &emu,
-                         const std::vector<Emu>& known_emus);
-
-void ConvertToSparseMatrix(const std::vector<std::vector<FluxCombination>>& dense_matrix,
-                           std::vector<FluxCombination>& sparse_matrix);
+void AddToSparseMatrix(size_t i, size_t j, const FluxAndCoefficient &flux,
+                       std::unordered_map<size_t, size_t> &positions,
+                       size_t cols,
+                       std::vector<FluxCombination>& sparse_matrix);
 
 void FillFinalEmu(const std::vector<Measurement>& measured_isotopes,
+                  const std::unordered_map<Emu, int>& measured_isotope_positions,
                   GeneratorNetworkData& network_data);
 
 void InsertIntoAllKnownEmus(const std::vector<Emu>& unknown_emus,
                             int network_num,
-                            std::vector<NetworkEmu>& all_known_emus);
+                            KnownEmus& all_known_emus);
 
 int FindNetworkSize(const std::vector<EmuReaction>& reactions);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "utilities/matrix.h"
 #include "utilities/emu_and_mid.h"
@@ -16,6 +17,12 @@ struct SimulatorResult {
     std::vector<std::vector<EmuAndMid>> diff_results;
 };
 
+// contains derivatives of the simulated mids along a direction in the free fluxes space
+struct DirectionalDerivatives {
+    std::vector<EmuAndMid> first_derivative;
+    std::vector<EmuAndMid> second_derivative;
+};
+
 struct DerivativeData {
     Matrix dA_small;
     Matrix dB_small;
@@ -25,6 +32,19 @@ struct DerivativeData {
 
 enum class NetworkSize {small, big};
 
+// matrices and factorization of the network from the last simulation
+struct NetworkState {
+    Matrix X;
+    Matrix Y;
+    Matrix A_small;
+    Matrix B_small;
+    Matrix BY;
+    // the iterative solver keeps a reference to the factorized matrix
+    SparseMatrix A_big;
+    SparseMatrix B_big;
+    Eigen::HouseholderQR<Matrix> A_small_decomposition;
+};
+
 struct SimulatorNetworkData {
     NetworkSize size;
     std::vector<FluxCombination> symbolic_A;
@@ -40,6 +60,10 @@ struct SimulatorNetworkData {
     size_t Y_rows;
     size_t Y_cols;
     std::vector<DerivativeData> derivatives;
+
+    // positions of the free fluxes which can change MIDs of the network,
+    // derivatives by the others are zero by construction
+    std::vector<size_t> influencing_fluxes;
 };
 
 struct GeneratorNetworkData {
@@ -51,5 +75,8 @@ struct GeneratorNetworkData {
     std::vector<FluxCombination> symbolic_A;
     std::vector<FluxCombination> symbolic_B;
     std::unordered_map<int, int> reaction_to_convolution;
+    // positions in unknown_emus and known_emus
+    std::unordered_map<Emu, int> unknown_emu_positions;
+    std::unordered_map<Emu, int> known_emu_positions;
 };
 }
\ No newline at end of file
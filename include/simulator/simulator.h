@@ -5,13 +5,14 @@
 #include "utilities/emu_and_mid.h"
 #include "utilities/matrix.h"
 #include "utilities/reaction.h"
+#include "utilities/measurement.h"
 #include "simulator/flux_combination.h"
 #include "simulator/simulation_data.h"
 
 
 namespace khnum {
-
-
+// View of the residuals' jacobian, alglib matrices are row-major with a row stride
+using JacobianMap = Eigen::Map<Matrix, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
 
 class Simulator {
 public:
@@ -21,7 +22,34 @@ public:
 
     SimulatorResult CalculateMids(const std::vector<Flux> &fluxes, bool calculate_jacobian);
 
+    // The measurements in the order of the measured isotopes
+    void SetMeasurements(const std::vector<Measurement> &measurements);
+
+    // Replaces the measured values in the residuals order, the errors are kept
+    void SetMeasuredValues(const Eigen::VectorXd &measured_values);
+
+    // Writes (simulated - measured) / error in the residuals order and, if the jacobian is given,
+    // the derivatives of the residuals by the free fluxes. The simulated mids aren't copied
+    void CalculateResiduals(const std::vector<Flux> &fluxes, Eigen::Ref<Eigen::VectorXd> residuals,
+                            JacobianMap *jacobian);
+
+    // Calculates the first and the second derivatives of the simulated mids along the free fluxes direction.
+    // Reuses factorizations of the last simulation if it was done with the same fluxes
+    DirectionalDerivatives CalculateDirectionalDerivatives(const std::vector<Flux> &fluxes,
+                                                           const std::vector<double> &direction);
+
+    // Sets tolerance of the iterative solves of the big networks
+    void SetTolerance(double tolerance);
+
+    size_t GetLinearSolverIterations() const;
+
+    // The iterative solves which didn't reach the tolerance
+    size_t GetLinearSolverFailures() const;
+
 private:
+    // Simulates into the buffers below, they are reused between the calls
+    void Simulate(const std::vector<Flux> &fluxes, bool calculate_jacobian);
+
     const size_t total_networks_;
     const size_t total_free_fluxes_;
     const size_t total_mids_to_simulate_;
@@ -30,5 +58,22 @@ private:
     std::vector<Eigen::BiCGSTAB<SparseMatrix, Eigen::IncompleteLUT<SparseMatrix::Scalar>>> solvers_;
 
     std::vector<Matrix> corrections;
+
+    size_t linear_solver_iterations_ = 0;
+    size_t linear_solver_failures_ = 0;
+
+    // the last simulation
+    std::vector<Flux> last_fluxes_;
+    std::vector<NetworkState> states_;
+    std::vector<std::vector<Mid>> saved_mids_;
+    // MID's derivatives at [free_flux][network][i]
+    std::vector<std::vector<std::vector<Mid>>> saved_diff_mids_;
+    std::vector<EmuAndMid> simulated_mids_;
+    std::vector<std::vector<EmuAndMid>> diff_results_;
+    std::vector<double> sums_;
+
+    std::vector<size_t> residual_offsets_;
+    Eigen::VectorXd measured_values_;
+    Eigen::VectorXd inverse_errors_;
 };
 } // namespace khnum
\ No newline at end of file
@@ -21,6 +21,8 @@ void FillYMatrix(const std::vector<PositionOfSavedEmu> &Y_data,
                  const std::vector<Convolution> &convolutions,
                  Matrix &Y_out);
 
+// The Save*Emus functions overwrite the mids in place, the emus of the results are expected to be set
+
 void SaveNewEmus(const Matrix& X,
                  const std::vector<int>& usefull_emus,
                  const std::vector<FinalEmu>& final_emus,
@@ -36,10 +38,17 @@ void SaveNewDiffEmus(const Matrix& X,
                      std::vector<Mid>& saved_mids_out,
                      std::vector<EmuAndMid>& diff_result_out);
 
-Matrix GetCorrectedDiffMid(const Matrix& correction_matrix,
-                           Matrix mid,
-                           const Matrix& diff_mid,
-                           double sum);
+void SaveZeroDiffEmus(size_t mid_size,
+                      const std::vector<int>& usefull_emus,
+                      const std::vector<FinalEmu>& final_emus,
+                      const std::vector<EmuAndMid> &result,
+                      std::vector<Mid>& saved_mids_out,
+                      std::vector<EmuAndMid>& diff_result_out);
+
+// Copies rows of the usefull emus
+void SaveUsefullEmus(const Matrix& X,
+                     const std::vector<int>& usefull_emus,
+                     std::vector<Mid>& saved_mids_out);
 
 Mid ConvolvePartialDiff(const Convolution& convolution,
                         const std::vector<std::vector<Mid>>& known_d_mids,
@@ -55,5 +64,33 @@ void FillDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
                      const std::vector<std::vector<Mid>>& saved_mids,
                      Matrix& Y_out);
 
+void SaveNewSecondDiffEmus(const Matrix& dX,
+                           const Matrix& d2X,
+                           const std::vector<int>& usefull_emus,
+                           const std::vector<FinalEmu>& final_emus,
+                           const std::vector<EmuAndMid> &result,
+                           const std::vector<EmuAndMid> &diff_result,
+                           const std::vector<double>& sums,
+                           std::vector<Mid>& saved_mids_out,
+                           std::vector<EmuAndMid>& second_diff_result_out);
+
+// Differentiates the convolution by the first and the second elements
+Mid ConvolveSecondPartialDiff(const Convolution& convolution,
+                              const std::vector<std::vector<Mid>>& known_d_mids,
+                              const std::vector<std::vector<Mid>>& known_d2_mids,
+                              const std::vector<EmuAndMid>& input_mids,
+                              const std::vector<std::vector<Mid>>& saved_mids,
+                              size_t mid_size,
+                              size_t first_diff_position,
+                              size_t second_diff_position);
+
+void FillSecondDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
+                           const std::vector<std::vector<Mid>>& known_d_mids,
+                           const std::vector<std::vector<Mid>>& known_d2_mids,
+                           const std::vector<Convolution>& convolutions,
+                           const std::vector<EmuAndMid>& input_mids,
+                           const std::vector<std::vector<Mid>>& saved_mids,
+                           Matrix& Y_out);
+
 }
 }
\ No newline at end of file
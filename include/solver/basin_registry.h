@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <shared_mutex>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Converged solutions of the finished starts, shared by the workers of the multistart
+class BasinRegistry {
+public:
+    // The point is inside the basin of the known optimum x* if the root mean square of (x - x*) / (upper - lower) <= radius
+    BasinRegistry(const Eigen::VectorXd &lower_bounds, const Eigen::VectorXd &upper_bounds, double radius);
+
+    // Returns the number of the basin
+    size_t Add(const Eigen::VectorXd &free_fluxes, double ssr);
+
+    // Returns the basin if the point is inside the basin of a known optimum and the ssr is not better than the optimum's
+    std::optional<size_t> FindKnownBasin(const Eigen::VectorXd &free_fluxes, double ssr) const;
+
+    size_t GetSize() const;
+
+private:
+    bool IsInBasin(const Eigen::VectorXd &free_fluxes, size_t basin) const;
+
+    Eigen::VectorXd bounds_width_;
+    double radius_;
+    mutable std::shared_mutex mutex_;
+    std::vector<Eigen::VectorXd> optima_;
+    std::vector<double> ssrs_;
+};
+} // namespace khnum
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+#include <condition_variable>
+
+#include "utilities/problem.h"
+#include "simulator/generator.h"
+#include "solver/solver.h"
+#include "solver/solver_parameters.h"
+#include "statistics/flux_map.h"
+
+
+namespace khnum {
+struct BatchDataset {
+    std::string name;
+    // of the isotopes of the problem in its order
+    std::vector<Measurement> measurements;
+};
+
+// Reads the measurements.csv of one sample, the values and the errors of the measured isotopes of the problem.
+// The MIDs not summing to 1 are normalized like the ones of the model
+BatchDataset ReadBatchDataset(const std::string &path, const Problem &problem);
+
+// The *.csv files of the directory ordered by the name
+std::vector<BatchDataset> ReadBatchDatasets(const std::string &directory, const Problem &problem);
+
+struct BatchParameters {
+    // the cold starts of every dataset, all of them begin from the same points
+    size_t starts_per_dataset = 10;
+    // the hardware concurrency is used if zero
+    size_t total_workers = 0;
+    bool pin_workers = false;
+    // the random one is used if not set
+    std::optional<uint64_t> master_seed;
+    // of the warm starts from the optimum of the previous dataset
+    double warm_start_epsx = 1.e-7;
+    // a line per dataset: the dataset, its file, SSR, iterations of the best start, whether it was warm and all
+    // the model fluxes, empty for no file
+    std::string output_path = "batch.csv";
+};
+
+struct BatchResult {
+    // not set if no start of the dataset has finite SSR
+    std::optional<StartResult> best_result;
+    bool is_best_warm = false;
+    size_t total_starts = 0;
+};
+
+// Fits many datasets of one model. The workers share the generated model and take the starts of all the datasets
+// from one pool, every worker has one solver and only replaces its measurements between the datasets.
+// Besides its cold starts every dataset but the first is warm-started from the optimum of the previous one,
+// the warm start is run as soon as the previous dataset is finished and goes before the waiting cold starts
+class BatchFitter {
+public:
+    BatchFitter(const Problem &problem,
+                const SimulatorGenerator &generator,
+                const SolverParameters &solver_parameters,
+                const BatchParameters &parameters);
+
+    // Returns the results in the order of the datasets
+    std::vector<BatchResult> Run(const std::vector<BatchDataset> &datasets);
+
+private:
+    struct Task {
+        size_t dataset;
+        // the cold starts go first, the warm start is the last
+        size_t start;
+        bool is_warm;
+    };
+
+    void RunWorker(size_t worker, const std::vector<BatchDataset> &datasets);
+
+    // Waits for a task while some dataset isn't finished and no worker failed
+    std::optional<Task> GetNextTask();
+
+    void AddFinishedTask(const Task &task, const StartResult &result, const std::vector<BatchDataset> &datasets);
+
+    // Makes the warm start of the next dataset ready or skips it if the dataset has no optimum
+    void FinishDataset(size_t dataset, const std::vector<BatchDataset> &datasets);
+
+    void WriteResults(const std::vector<BatchDataset> &datasets) const;
+
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    SolverParameters solver_parameters_;
+    BatchParameters parameters_;
+    uint64_t master_seed_;
+    FluxMap flux_map_;
+    std::vector<int> model_fluxes_;
+    std::vector<Eigen::VectorXd> start_points_;
+
+    std::mutex mutex_;
+    std::condition_variable task_ready_;
+    size_t next_cold_task_ = 0;
+    std::deque<size_t> ready_warm_starts_;
+    std::vector<size_t> remaining_tasks_;
+    size_t finished_datasets_ = 0;
+    bool is_failed_ = false;
+    std::vector<BatchResult> results_;
+};
+} // namespace khnum
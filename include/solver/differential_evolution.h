@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <cstdint>
+
+#include "utilities/problem.h"
+#include "simulator/generator.h"
+#include "solver/solver.h"
+#include "solver/solver_parameters.h"
+#include "solver/telemetry.h"
+
+
+namespace khnum {
+struct DifferentialEvolutionParameters {
+    // 10 times the number of the not fixed free fluxes if zero
+    size_t population_size = 0;
+    int max_generations = 20;
+    // DE/current-to-best/1/bin: v = x + F * (best - x) + F * (x_r1 - x_r2), F is drawn from the range per trial
+    double min_differential_weight = 0.5;
+    double max_differential_weight = 1.0;
+    double crossover_rate = 0.9;
+    // the population is converged when (worst SSR - best SSR) <= tolerance * max(best SSR, 1)
+    double tolerance = 1.e-6;
+    // the search stops once the best SSR is at or below it
+    std::optional<double> target_ssr;
+    // the best distinct candidates polished by LM
+    size_t total_polished = 12;
+    // of the polishing, the candidates move little compared to the bound widths, so the scaled step criterion is tighter
+    double epsx = 1.e-7;
+    // the hardware concurrency is used if zero
+    size_t total_workers = 0;
+    bool pin_workers = false;
+    // the random one is used if not set
+    std::optional<uint64_t> master_seed;
+};
+
+struct DifferentialEvolutionReport {
+    int generations = 0;
+    // the search stopped at the target SSR
+    bool is_target_reached = false;
+    // of the polished candidates before the polishing, in the order of the results
+    std::vector<double> candidate_ssr;
+};
+
+// Differential evolution over the feasible polytope of the free fluxes. The trials leaving the polytope are pulled
+// back towards their parents, so the population stays feasible. Every generation is simulated as one batch over
+// the workers, every worker has its own solver of the shared model. The best candidates are polished by the solver
+class DifferentialEvolution {
+public:
+    DifferentialEvolution(const Problem &problem,
+                          const SimulatorGenerator &generator,
+                          const SolverParameters &solver_parameters,
+                          const DifferentialEvolutionParameters &parameters);
+
+    // The polishing starts and the busy and wall seconds of the workers are added to the telemetry
+    void SetTelemetry(Telemetry *telemetry);
+
+    // Returns the polished candidates ordered by their SSR before the polishing
+    std::vector<StartResult> Run();
+
+    // Of the last run
+    const DifferentialEvolutionReport &GetReport() const;
+
+    // The largest step from the feasible parent towards the trial which keeps the bounds and the constraints,
+    // it's in [0, 1]
+    double GetFeasibleStep(const Eigen::VectorXd &parent, const Eigen::VectorXd &direction) const;
+
+private:
+    // Fills the SSR of the points, infinity for the failed simulations
+    void EvaluateBatch(const std::vector<Eigen::VectorXd> &points, std::vector<double> &ssr);
+
+    void RunEvaluationWorker(size_t worker, const std::vector<Eigen::VectorXd> &points, std::vector<double> &ssr);
+
+    void RunPolishingWorker(size_t worker, const std::vector<Eigen::VectorXd> &points,
+                            std::vector<StartResult> &results);
+
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    SolverParameters solver_parameters_;
+    DifferentialEvolutionParameters parameters_;
+    uint64_t master_seed_;
+    size_t total_workers_ = 1;
+    Eigen::VectorXd lower_bounds_;
+    Eigen::VectorXd upper_bounds_;
+    // positions of the free fluxes with lower < upper bound
+    std::vector<int> variable_fluxes_;
+
+    std::vector<std::unique_ptr<Solver>> solvers_;
+    Telemetry *telemetry_ = nullptr;
+    std::atomic<size_t> next_point_;
+    DifferentialEvolutionReport report_;
+};
+} // namespace khnum
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include "utilities/matrix.h"
+#include "utilities/problem.h"
+#include "simulator/simulator.h"
+
+
+namespace khnum {
+// Compactified exchange fluxes: the optimizer sees u = x / (x + scale) in [0, 1) instead of x >= 0,
+// so the exchange fluxes from 0.001 to 125 get a comparable sensitivity. The other free fluxes are unchanged
+class ExchangeTransform {
+public:
+    ExchangeTransform() = default;
+
+    // positions of the transformed free fluxes
+    ExchangeTransform(const std::vector<int> &positions, double scale);
+
+    void ToVariables(Eigen::Ref<Eigen::VectorXd> free_fluxes) const;
+
+    void ToFluxes(Eigen::Ref<Eigen::VectorXd> variables) const;
+
+    // Multiplies the columns of the transformed fluxes by d flux / d variable
+    void ScaleJacobian(const Eigen::Ref<const Eigen::VectorXd> &variables, JacobianMap &jacobian) const;
+
+    bool IsEmpty() const;
+
+private:
+    std::vector<int> positions_;
+    double scale_ = 1.0;
+};
+
+// The positions of the exchange fluxes the transform is applied to: the not fixed ones bounded by zero below.
+// The constraints stay linear in the variables only if the transformed fluxes don't enter them
+std::vector<int> GetTransformedExchangeFluxes(const Problem &problem);
+} // namespace khnum
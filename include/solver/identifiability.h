@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+#include "simulator/generator.h"
+
+
+namespace khnum {
+struct IdentifiabilityReport {
+    // the feasible points with the finite jacobian
+    size_t total_points = 0;
+    // rank of the jacobians stacked over the points, the fixed free fluxes aren't counted
+    int rank = 0;
+    // of the stacked jacobian by the free fluxes scaled to the widths of their bounds
+    Eigen::VectorXd singular_values;
+    // root mean square over the points of the scaled jacobian columns norms, 0 for the fixed free fluxes
+    Eigen::VectorXd sensitivities;
+    // unit directions of the free fluxes the residuals don't change along
+    Matrix null_directions;
+    // positions of the free fluxes to fix so the rest of them have the full rank jacobian
+    std::vector<int> non_identifiable;
+    // the Chebyshev center of the free fluxes polytope, the non identifiable fluxes are fixed at it
+    Eigen::VectorXd fixing_point;
+};
+
+// Evaluates the analytic jacobian at the hit-and-run points of the feasible free fluxes,
+// the singular values below tolerance * the largest one are treated as zero.
+// The check is skipped with a warning if the free fluxes polytope has no interior to sample
+IdentifiabilityReport CheckIdentifiability(const Problem &problem, const SimulatorGenerator &generator,
+                                           uint64_t seed, size_t total_points = 10, double tolerance = 1.e-6);
+
+// Fixes the non identifiable free fluxes and moves them to the right part of the constraints
+void FixNonIdentifiableFluxes(const IdentifiabilityReport &report, Problem &problem);
+} // namespace khnum
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <functional>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Functions of the least squares problem min |r(x)|^2
+struct LeastSquaresFunctions {
+    std::function<void(const Eigen::VectorXd &x, Eigen::VectorXd &residuals)> residuals;
+
+    std::function<void(const Eigen::VectorXd &x, Eigen::VectorXd &residuals, Matrix &jacobian)> jacobian;
+
+    // Second derivative of the residuals at x along the direction
+    std::function<void(const Eigen::VectorXd &x, const Eigen::VectorXd &direction,
+                       Eigen::VectorXd &second_derivative)> second_directional_derivative;
+
+    // Called after every accepted step, the optimization stops if it returns false
+    std::function<bool(const Eigen::VectorXd &x, double ssr)> report;
+};
+
+struct LevenbergMarquardtParameters {
+    int max_iterations = 500;
+    double epsx = 0.0001;
+    double initial_damping = 0.001;
+    bool use_geodesic_acceleration = true;
+    // the accelerated step is rejected if 2 * |acceleration| / |velocity| > max_acceleration_ratio
+    double max_acceleration_ratio = 0.75;
+};
+
+struct LevenbergMarquardtReport {
+    int iterations = 0;
+    int residual_evaluations = 0;
+    int jacobian_evaluations = 0;
+    int second_derivative_evaluations = 0;
+    double ssr = 0.0;
+};
+
+// Levenberg-Marquardt, optionally with the geodesic acceleration
+// See Transtrum, Sethna "Improvements to the Levenberg-Marquardt algorithm for nonlinear least-squares minimization"
+// Box constraints and linear inequalities C * x <= d are kept by projecting the trial points on the feasible set
+class LevenbergMarquardt {
+public:
+    LevenbergMarquardt(const LeastSquaresFunctions &functions,
+                       const Eigen::VectorXd &lower_bounds,
+                       const Eigen::VectorXd &upper_bounds,
+                       const LevenbergMarquardtParameters &parameters);
+
+    void SetInequalityConstraints(const Matrix &matrix, const Eigen::VectorXd &right_part);
+
+    // Typical magnitudes of the variables, the optimization stops when |step / scale| <= epsx
+    void SetScale(const Eigen::VectorXd &scale);
+
+    void SetStepTolerance(double epsx);
+
+    Eigen::VectorXd Optimize(const Eigen::VectorXd &initial_point);
+
+    const LevenbergMarquardtReport &GetReport() const;
+
+private:
+    // Decomposes [J * P; sqrt(damping * D) * P], where P are the free directions
+    void DecomposeDampedSystem(double damping);
+
+    // Returns P * z minimizing |J * P * z + residuals|^2 + damping * |sqrt(D) * P * z|^2
+    void SolveDampedSystem(const Eigen::VectorXd &residuals, Eigen::VectorXd &solution);
+
+    Eigen::VectorXd ProjectOnBounds(const Eigen::VectorXd &x) const;
+
+    // Returns rows of the active constraints (including the bounds) which the step violates
+    Matrix GetBlockingConstraints(const Eigen::VectorXd &x, const Eigen::VectorXd &step) const;
+
+    // Returns an orthonormal basis of the null space
+    Matrix GetNullSpace(const Matrix &matrix) const;
+
+    bool IsFeasible(const Eigen::VectorXd &x) const;
+
+    // Returns the closest point satisfying the bounds and the inequalities
+    Eigen::VectorXd ProjectOnFeasibleSet(const Eigen::VectorXd &point) const;
+
+    LeastSquaresFunctions functions_;
+    Eigen::VectorXd lower_bounds_;
+    Eigen::VectorXd upper_bounds_;
+    Matrix constraints_;
+    Eigen::VectorXd constraints_right_part_;
+    Eigen::VectorXd scale_;
+    LevenbergMarquardtParameters parameters_;
+    LevenbergMarquardtReport report_;
+
+    // Buffers reused between the iterations and the Optimize calls
+    Eigen::VectorXd residuals_;
+    Eigen::VectorXd trial_residuals_;
+    Eigen::VectorXd second_derivative_;
+    Matrix jacobian_;
+    Eigen::VectorXd scaling_;
+    Eigen::VectorXd damping_diagonal_;
+    Matrix free_directions_;
+    Matrix augmented_matrix_;
+    Eigen::VectorXd augmented_right_part_;
+    Eigen::HouseholderQR<Matrix> decomposition_;
+    Eigen::VectorXd velocity_;
+    Eigen::VectorXd acceleration_;
+    Eigen::VectorXd step_;
+    Eigen::VectorXd trial_point_;
+};
+} // namespace khnum
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <cstdint>
+
+#include "utilities/problem.h"
+#include "simulator/generator.h"
+#include "solver/solver.h"
+#include "solver/solver_parameters.h"
+#include "solver/basin_registry.h"
+#include "solver/start_log.h"
+#include "solver/telemetry.h"
+
+
+namespace khnum {
+struct MultistartParameters {
+    size_t total_starts = 30;
+    // the hardware concurrency is used if zero
+    size_t total_workers = 0;
+    bool pin_workers = false;
+    // the random one is used if not set
+    std::optional<uint64_t> master_seed;
+    // terminate the starts heading into the already found optima,
+    // which starts are terminated depends on the scheduling
+    bool use_basin_registry = false;
+    double basin_radius = 0.05;
+    // Successive halving: every start runs screening_iterations steps simulated with the loose tolerance,
+    // the best 1 / halving_factor of them continue for halving_factor times more steps and so on.
+    // The survivors of the rung reaching the solver's max_iterations are refined at full accuracy.
+    // All the starts are run at full accuracy if zero
+    int screening_iterations = 0;
+    int halving_factor = 3;
+    // Seconds of the wall clock for all the starts. No start is handed out once the rest of the budget is shorter
+    // than half of the average start, the running ones are cancelled at the deadline
+    std::optional<double> time_budget;
+    // the starts are run in the order of the SSR at their start points, so the promising ones finish first
+    bool prioritize_starts = false;
+    // the finished starts are appended to the binary log, no log if empty
+    std::string log_path;
+    // the starts completed in the log aren't run again, the successive halving can't be resumed
+    bool resume = false;
+    // the directory of the warm start library, no library if empty
+    std::string warm_start_library;
+    // the part of the starts seeded from the optima of the library, perturbed by perturbation * the bound widths
+    double warm_start_fraction = 0.25;
+    double warm_start_perturbation = 0.02;
+    // of the warm starts, they begin close to the optima, so the scaled step criterion is tighter
+    double warm_start_epsx = 1.e-7;
+};
+
+// Runs the starts over a pool of workers, every worker has its own solver.
+// The starts are split between the workers' queues, an idle worker steals them from the back of the others' queues
+class MultistartScheduler {
+public:
+    MultistartScheduler(const Problem &problem,
+                        const SimulatorGenerator &generator,
+                        const SolverParameters &solver_parameters,
+                        const MultistartParameters &parameters);
+
+    // Returns the results of the run starts ordered by the start number
+    std::vector<StartResult> Run();
+
+    // The starts and the workers are added to the telemetry
+    void SetTelemetry(Telemetry *telemetry);
+
+    // The best of the finished starts so far, can be called by the other threads during the run
+    std::optional<StartResult> GetBestResult() const;
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> starts;
+    };
+
+    // Runs the starts on the workers, returns the results ordered by the start number
+    // The results of the final starts are appended to the log, the screening ones aren't
+    std::vector<StartResult> RunStarts(const std::vector<size_t> &starts, const SolverParameters &solver_parameters,
+                                       bool use_basin_registry, bool is_final);
+
+    std::vector<StartResult> RunSuccessiveHalving(std::vector<size_t> starts);
+
+    // The points the solver draws from the start seeds with the box sampling
+    std::vector<Eigen::VectorXd> GetBoxStartPoints(const Eigen::VectorXd &lower_bounds,
+                                                   const Eigen::VectorXd &upper_bounds) const;
+
+    // Orders the starts by the SSR at their start points, the failed simulations go last
+    std::vector<size_t> GetPrioritizedStarts();
+
+    void RunRankingWorker(size_t worker, std::vector<double> &ssr);
+
+    // The error of the worker, e.g. of the start log, stops the other workers and is rethrown by RunStarts
+    void RunWorker(size_t worker, const SolverParameters &solver_parameters, bool use_basin_registry, bool is_final,
+                   std::vector<StartResult> &results);
+
+    std::optional<size_t> GetNextStart(size_t worker);
+
+    // Updates the best result and the average duration of the starts
+    void AddFinishedStart(const StartResult &result);
+
+    bool IsBudgetSpent() const;
+
+    void PrintBasinRegistryReport(const std::vector<StartResult> &results) const;
+
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    SolverParameters solver_parameters_;
+    MultistartParameters parameters_;
+    uint64_t master_seed_;
+    size_t total_workers_ = 1;
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<size_t> stolen_starts_;
+    std::vector<size_t> worker_starts_;
+    std::unique_ptr<BasinRegistry> basin_registry_;
+    std::unique_ptr<StartLog> start_log_;
+    Telemetry *telemetry_ = nullptr;
+    std::vector<Eigen::VectorXd> start_points_;
+    // the successive halving continues the starts from the points of the previous rung
+    std::vector<std::optional<Eigen::VectorXd>> continued_points_;
+
+    std::vector<bool> is_warm_start_;
+    bool is_prioritized_ = false;
+    std::atomic<size_t> next_start_;
+    std::atomic<bool> is_worker_failed_{false};
+    std::chrono::steady_clock::time_point start_time_;
+    std::optional<std::chrono::steady_clock::time_point> deadline_;
+    mutable std::mutex best_mutex_;
+    std::optional<StartResult> best_result_;
+    double best_seconds_ = 0.0;
+    // of the current RunStarts, the cancelled starts aren't counted
+    size_t finished_starts_ = 0;
+    double finished_seconds_ = 0.0;
+};
+
+void PinThreadToCore(size_t core);
+} // namespace khnum
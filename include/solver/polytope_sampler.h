@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <random>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Samples the polytope lower <= x <= upper, constraints * x <= right_part.
+// Coordinates with equal bounds are fixed, the others should span a full-dimensional polytope
+class PolytopeSampler {
+public:
+    PolytopeSampler(const Eigen::VectorXd &lower_bounds, const Eigen::VectorXd &upper_bounds,
+                    const Matrix &constraints, const Eigen::VectorXd &right_part);
+
+    // Hit-and-run in the rounded polytope, the chain is continued between the calls
+    std::vector<Eigen::VectorXd> Sample(size_t count, std::mt19937 &random_source);
+
+    // Halton points of the polytope bounding box which are inside the polytope,
+    // the rest is sampled with hit-and-run if too few of them are inside
+    std::vector<Eigen::VectorXd> SampleLowDiscrepancy(size_t count, std::mt19937 &random_source);
+
+    // Chebyshev center, the center of the largest ball inside the polytope
+    const Eigen::VectorXd &GetCenter() const;
+
+private:
+    // Finds the Chebyshev center and the bounding box with GLPK
+    void SolveLinearProblems();
+
+    // Makes the polytope close to isotropic: hit-and-run samples its covariance,
+    // then the directions are drawn from the ellipsoid of that covariance
+    void Round();
+
+    void MakeHitAndRunStep(std::mt19937 &random_source);
+
+    Eigen::VectorXd GetFullPoint(const Eigen::VectorXd &free_point) const;
+
+    Eigen::VectorXd fixed_point_;
+    std::vector<int> free_coordinates_;
+
+    // free coordinates y: inequalities * y <= inequalities_right_part, the bounds included
+    Matrix inequalities_;
+    Eigen::VectorXd inequalities_right_part_;
+
+    Eigen::VectorXd center_;
+    Eigen::VectorXd bounding_box_lower_;
+    Eigen::VectorXd bounding_box_upper_;
+    // directions are rounding_ * u with u uniform on the unit sphere
+    Matrix rounding_;
+    Eigen::VectorXd current_point_;
+    size_t thinning_;
+    Eigen::VectorXd full_center_;
+};
+
+// Radical inverse of the index in the base, the coordinate of the Halton sequence
+double GetRadicalInverse(size_t index, int base);
+} // namespace khnum
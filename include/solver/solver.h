@@ -2,47 +2,154 @@
 
 #include "alglib/ap.h"
 #include <random>
+#include <chrono>
 
 #include "alglib/optimization.h"
 #include "utilities/problem.h"
 #include "simulator/simulator.h"
 #include "simulator/generator.h"
+#include "solver/solver_parameters.h"
+#include "solver/levenberg_marquardt.h"
+#include "solver/basin_registry.h"
+#include "solver/exchange_transform.h"
+#include "solver/telemetry.h"
 
 
 namespace khnum {
+struct StartResult {
+    size_t start;
+    uint64_t seed;
+    alglib::real_1d_array free_fluxes;
+    double ssr;
+    int iterations;
+    // residual and jacobian evaluations
+    int evaluations;
+    // the start was heading into an already found optimum
+    bool is_terminated_early;
+    // the basin in the registry the start converged or was heading to
+    std::optional<size_t> basin;
+    double seconds;
+    // the successive halving didn't promote the start to the full refinement
+    bool is_screened_out = false;
+    // the deadline passed while the start was running, the result is the point reached
+    bool is_cancelled = false;
+};
+
+// Returns the reproducible seed of the start (splitmix64 of the master seed and the start number)
+uint64_t GetStartSeed(uint64_t master_seed, size_t start);
+
+// Returns the uniform point of the box drawn from the start seed, the solver starts from it without the initial point
+Eigen::VectorXd GetBoxStartPoint(const Eigen::VectorXd &lower_bounds, const Eigen::VectorXd &upper_bounds,
+                                 uint64_t seed);
+
+// Returns the start points of the free fluxes satisfying the bounds and the constraints,
+// empty for the box sampling
+std::vector<Eigen::VectorXd> SampleStartPoints(const Eigen::VectorXd &lower_bounds,
+                                               const Eigen::VectorXd &upper_bounds,
+                                               const LinearConstraints &constraints,
+                                               StartSampling sampling,
+                                               size_t total_starts,
+                                               uint64_t master_seed);
+
 // See http://www.alglib.net/optimization/levenbergmarquardt.php
 // and http://www.alglib.net/translator/man/manual.cpp.html#example_minlm_d_v before reading this code
 
 class Solver {
 public:
-    Solver(const Problem &problem, const SimulatorGenerator &generator);
+    Solver(const Problem &problem, const SimulatorGenerator &generator,
+           const SolverParameters &parameters = SolverParameters());
 
     void Solve();
 
+    // Runs one start from the initial point or the random point of the box,
+    // the optimizer state is reused between the starts
+    StartResult SolveFromStart(size_t start, uint64_t seed,
+                               const std::optional<Eigen::VectorXd> &initial_point = std::nullopt);
+
     std::vector<alglib::real_1d_array> GetResult();
 
+    // The starts are terminated early if they are heading into the optima of the registry.
+    // The converged starts are added to it
+    void SetBasinRegistry(BasinRegistry *registry);
+
+    // The starts running past the deadline are cancelled at the next report of the optimizer,
+    // they aren't added to the basin registry and aren't polished at the tight tolerance
+    void SetDeadline(std::optional<std::chrono::steady_clock::time_point> deadline);
+
+    // The counters of the next starts are added to the telemetry, the worker is the one running the solver
+    void SetTelemetry(Telemetry *telemetry, size_t worker);
+
+    // Replaces epsx of the parameters for the next starts
+    void SetStepTolerance(double epsx);
+
+    // Residuals of the free fluxes, not of the optimizer variables
+    void CalculateResiduals(const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals);
+
+    // Residuals and their jacobian by the free fluxes, not by the optimizer variables
+    void CalculateJacobian(const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals, Matrix &jacobian);
+
+    // Adds coefficients * free fluxes = value to the constraints of the next starts.
+    // The exchange transform must be off, it would make the equality nonlinear
+    void PinFlux(const Eigen::VectorXd &coefficients, double value);
+
+    void UnpinFlux();
+
+    // Replaces the measured values of the residuals, e.g. by the resampled ones
+    void SetMeasuredValues(const Eigen::VectorXd &measured_values);
+
+    // Replaces the measured values and their errors, e.g. by the ones of another sample.
+    // The measurements must be of the same isotopes in the same order
+    void SetMeasurements(const std::vector<Measurement> &measurements);
+
 private:
     void SetOptimizationParameters();
 
     // Set constraints so the fluxes always > 0
     void SetConstraints();
 
-    void GenerateInitialPoints(std::mt19937 &random_source);
+    // The inequalities and the pinned flux as two inequalities
+    void SetNativeConstraints();
 
     void PrintStartMessage();
 
     alglib::real_1d_array RunOptimization();
 
-    void CalculateResidual(const alglib::real_1d_array &free_fluxes,
-                           alglib::real_1d_array &residuals);
+    void Optimize();
+
+    alglib::real_1d_array RunNativeOptimization();
+
+    // The residuals, the jacobian and the second derivatives are computed with Eigen without alglib arrays
+    void CreateNativeOptimizer();
+
+    void SetSimulationTolerance(double tolerance);
+
+    // Tightens the simulation tolerance as the SSR decrease and the step size shrink
+    void UpdateSimulationTolerance(const alglib::real_1d_array &free_fluxes, double ssr);
+
+    // Checks the point against the basin registry every basin_check_period calls
+    bool IsHeadingIntoKnownBasin(const Eigen::VectorXd &free_fluxes, double ssr);
 
-    std::vector<Flux> CalculateAllFluxesFromFree(const alglib::real_1d_array &free_fluxes_alglib);
+    // Marks the start cancelled if the deadline has passed
+    bool IsPastDeadline();
 
-    void Fillf0Array(alglib::real_1d_array &residuals, const std::vector<EmuAndMid> &simulated_mids);
+    // The simulation time is counted only with the telemetry
+    double *GetSimulationTimer();
 
-    double GetSSR(const alglib::real_1d_array &residuals);
+    // The optimizer reports the steps if any of their users is on
+    bool IsReportNeeded() const;
 
-    void PrintFinalMessage(const alglib::real_1d_array &free_fluxes);
+    // Returns all the fluxes from the optimizer variables, the buffer is reused by the next call
+    const std::vector<Flux> &CalculateAllFluxesFromFree(const alglib::real_1d_array &variables_alglib);
+
+    const std::vector<Flux> &CalculateAllFluxesFromFree(const Eigen::Ref<const Eigen::VectorXd> &variables);
+
+    // Widths of the variable bounds, 1 for the fixed variables
+    Eigen::VectorXd GetVariableScales() const;
+
+    // Fills mids divided by the measurement errors in the residuals order
+    void FillWeightedMids(Eigen::VectorXd &weighted_mids, const std::vector<EmuAndMid> &mids);
+
+    void PrintFinalMessage(const alglib::real_1d_array &free_fluxes, int total_steps, size_t linear_solver_iterations);
 
     friend void AlglibCallback(const alglib::real_1d_array &free_fluxes,
                                alglib::real_1d_array &residuals, void *ptr);
@@ -51,17 +158,15 @@ private:
                                       alglib::real_1d_array &fi,
                                       alglib::real_2d_array &jac, void *ptr);
 
-    void FillJacobian(alglib::real_2d_array &jac);
+    friend void ReportCallback(const alglib::real_1d_array &free_fluxes, double func, void *ptr);
 
 public:
-    bool in_jacobian = false;
     int iteration_;
     alglib::real_1d_array free_fluxes_;
     alglib::minlmstate state_;
     alglib::minlmreport report_;
     std::vector<alglib::real_1d_array> all_solutions_;
     std::optional<Simulator> new_simulator_;
-    std::vector<std::vector<EmuAndMid>> diff_results_;
 
     int nullity_;
     int reactions_num_;
@@ -71,10 +176,50 @@ public:
     std::vector<ReactionsName> reactions_;
 
     Matrix nullspace_;
+    LinearConstraints constraints_;
+    // matrix * Vfree = right_part, the pinned flux
+    LinearConstraints equalities_;
+    Eigen::VectorXd depended_fluxes_;
+    std::vector<Flux> all_fluxes_;
     std::vector<Measurement> measured_mids_;
 
     alglib::real_1d_array lower_bounds_;
     alglib::real_1d_array upper_bounds_;
+
+    // The optimizer works with the transformed free fluxes
+    ExchangeTransform exchange_transform_;
+    Eigen::VectorXd variable_lower_bounds_;
+    Eigen::VectorXd variable_upper_bounds_;
+    Eigen::VectorXd free_fluxes_buffer_;
+
+    SolverParameters parameters_;
+    double simulation_tolerance_;
+    double previous_ssr_;
+    alglib::real_1d_array previous_point_;
+    size_t total_linear_solver_iterations_ = 0;
+
+    bool is_state_created_ = false;
+    // used instead of state_ with the native optimizers
+    std::optional<LevenbergMarquardt> native_optimizer_;
+    double final_ssr_ = 0.0;
+    int final_steps_ = 0;
+    int final_evaluations_ = 0;
+
+    BasinRegistry *basin_registry_ = nullptr;
+    int reports_since_basin_check_ = 0;
+    int basin_hits_ = 0;
+    bool is_terminated_early_ = false;
+    std::optional<size_t> basin_;
+
+    std::optional<std::chrono::steady_clock::time_point> deadline_;
+    bool is_cancelled_ = false;
+
+    Telemetry *telemetry_ = nullptr;
+    size_t telemetry_worker_ = 0;
+    int final_residual_evaluations_ = 0;
+    int final_jacobian_evaluations_ = 0;
+    double simulation_seconds_ = 0.0;
+    std::vector<double> ssr_trajectory_;
 };
 
 void AlglibCallback(const alglib::real_1d_array &free_fluxes,
@@ -83,4 +228,6 @@ void AlglibCallback(const alglib::real_1d_array &free_fluxes,
 void JacobianCallback(const alglib::real_1d_array &free_fluxes,
                       alglib::real_1d_array &fi,
                       alglib::real_2d_array &jac, void *ptr);
+
+void ReportCallback(const alglib::real_1d_array &free_fluxes, double func, void *ptr);
 } // namespace khnum
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <cstdint>
+
+
+namespace khnum {
+enum class Optimizer {
+    alglib_lm,   ///< alglib minlm
+    native_lm,   ///< Eigen Levenberg-Marquardt, uses the analytic jacobian
+    geodesic_lm  ///< native_lm with the geodesic acceleration, uses the analytic second derivatives
+};
+
+enum class StartSampling {
+    box,         ///< uniform in the free flux bounds, ignores the constraints
+    hit_and_run, ///< uniform in the feasible polytope
+    halton       ///< low-discrepancy points of the feasible polytope
+};
+
+struct SolverParameters {
+    Optimizer optimizer = Optimizer::alglib_lm;
+    StartSampling start_sampling = StartSampling::box;
+    int max_iterations = 500;
+    double epsx = 0.0001;
+    // seeds of the starts are derived from it, the random one is used if not set
+    std::optional<uint64_t> seed;
+
+    // The free exchange fluxes which don't enter the constraints are optimized
+    // as x / (x + exchange_scale), see ExchangeTransform
+    bool use_exchange_transform = false;
+    double exchange_scale = 1.0;
+    // The widths of the variable bounds are passed to the optimizer as the variable scales,
+    // the step of the stopping criterion |step / scale| <= epsx is scaled too
+    bool use_variable_scaling = false;
+
+    // Tighten the tolerance of the iterative big network solves as the fit converges:
+    // loose while far from the optimum and full accuracy near it
+    bool use_adaptive_tolerance = false;
+    double loose_tolerance = 1.e-4;
+    double tight_tolerance = std::numeric_limits<double>::epsilon();
+    // tolerance = tolerance_factor * (relative SSR decrease or relative step, whichever is larger)
+    double tolerance_factor = 0.1;
+
+    // With the basin registry the start is checked every basin_check_period steps
+    // and terminated after basin_confirmations checks in a row inside a known basin
+    int basin_check_period = 3;
+    int basin_confirmations = 2;
+};
+} // namespace khnum
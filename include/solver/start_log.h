@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+
+#include "solver/solver.h"
+
+
+namespace khnum {
+// The log is the header followed by the fixed size records in the native byte order, so it can be mapped
+// as an array, e.g. by numpy.memmap with the offset of the header:
+//  header: char magic[8] "KHNUMLOG", uint32 version, uint32 nullity, uint64 total_starts, uint64 master_seed,
+//          32 reserved bytes
+//  record: uint64 start, uint64 seed, double ssr, double seconds, int32 iterations, int32 evaluations,
+//          uint32 flags, uint32 reserved, double free_fluxes[nullity]
+struct StartLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nullity;
+    uint64_t total_starts;
+    uint64_t master_seed;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(StartLogHeader) == 64, "The header layout is a part of the log format");
+
+struct StartLogRecord {
+    uint64_t start;
+    uint64_t seed;
+    double ssr;
+    double seconds;
+    int32_t iterations;
+    int32_t evaluations;
+    uint32_t flags;
+    uint32_t reserved;
+};
+static_assert(sizeof(StartLogRecord) == 48, "The record layout is a part of the log format");
+
+// the bits of StartLogRecord::flags
+constexpr uint32_t kTerminatedEarly = 1;
+constexpr uint32_t kScreenedOut = 2;
+constexpr uint32_t kCancelled = 4;
+
+struct StartLogContents {
+    StartLogHeader header;
+    // in the order of writing, a start may be logged again after its cancellation
+    std::vector<StartResult> results;
+};
+
+// The record cut by a crash is dropped
+StartLogContents ReadStartLog(const std::string &path);
+
+// Appends the finished starts to the binary log as soon as they finish, so a restarted run can skip them
+class StartLog {
+public:
+    // The resumed log must be of the same free fluxes and starts, its cut record is overwritten.
+    // Otherwise the log is created, the existing one isn't overwritten
+    StartLog(const std::string &path, int nullity, size_t total_starts, uint64_t master_seed, bool resume);
+
+    // The last result of every start of the resumed log, except the cancelled ones
+    std::vector<StartResult> GetCompletedResults() const;
+
+    // Thread-safe, the record is flushed to the file before returning
+    void Append(const StartResult &result);
+
+private:
+    std::string path_;
+    int nullity_;
+    std::vector<StartResult> logged_results_;
+    std::mutex mutex_;
+    std::ofstream output_;
+};
+} // namespace khnum
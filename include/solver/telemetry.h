@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+
+
+namespace khnum {
+enum class TelemetryFormat {
+    csv,  ///< <path>_starts.csv with the trajectory as ';' separated SSRs and <path>_workers.csv
+    json  ///< <path>.json with the starts and the workers
+};
+
+struct StartTelemetry {
+    size_t start;
+    size_t worker;
+    int iterations;
+    int residual_evaluations;
+    int jacobian_evaluations;
+    size_t linear_solver_iterations;
+    size_t linear_solver_failures;
+    // in the simulator, the rest of the start is in the optimizer
+    double simulation_seconds;
+    double seconds;
+    double ssr;
+    // SSR of every accepted step
+    std::vector<double> ssr_trajectory;
+};
+
+struct WorkerTelemetry {
+    size_t starts = 0;
+    // running the starts
+    double busy_seconds = 0.0;
+    // from the worker's start to its end
+    double wall_seconds = 0.0;
+};
+
+// Collects the counters of the starts and the workers, the solvers without it don't read the clock
+class Telemetry {
+public:
+    Telemetry(TelemetryFormat format, const std::string &path);
+
+    // Thread-safe
+    void AddStart(StartTelemetry &&start);
+
+    // Thread-safe, the workers of the successive runs are summed
+    void AddWorker(size_t worker, const WorkerTelemetry &telemetry);
+
+    void PrintSummary() const;
+
+    void Write() const;
+
+private:
+    void WriteCsv() const;
+
+    void WriteJson() const;
+
+    TelemetryFormat format_;
+    std::string path_;
+    mutable std::mutex mutex_;
+    std::vector<StartTelemetry> starts_;
+    std::vector<WorkerTelemetry> workers_;
+};
+
+// Adds the seconds of its scope to the counter, the clock isn't read if the counter is null
+class ScopedTimer {
+public:
+    explicit ScopedTimer(double *seconds);
+
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer &) = delete;
+
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    double *seconds_;
+    std::chrono::steady_clock::time_point start_;
+};
+} // namespace khnum
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <optional>
+#include <cstdint>
+
+#include "utilities/problem.h"
+#include "solver/solver.h"
+
+
+namespace khnum {
+// FNV-1a of the model structure: the reactions in the free fluxes order, the nullspace of the free flux selection,
+// the EMU networks of the atom mappings and the measured isotopes. The measured values and the bounds aren't hashed,
+// so the refits of the same model with the new measurements share the library
+uint64_t GetModelHash(const Problem &problem);
+
+struct WarmStartStatistics {
+    size_t total_runs = 0;
+    // a start hits if its SSR is close to the best SSR of its run
+    size_t warm_starts = 0;
+    size_t warm_hits = 0;
+    double warm_seconds = 0.0;
+    size_t cold_starts = 0;
+    size_t cold_hits = 0;
+    double cold_seconds = 0.0;
+};
+
+// The distinct optima of the previous runs of the model, stored in the directory as <model hash>.txt
+class WarmStartLibrary {
+public:
+    // Loads the optima of the model if the library has them. The optima are distinct if the root mean square
+    // of their difference divided by the bound widths is above the radius
+    WarmStartLibrary(const std::string &directory, const Problem &problem, size_t capacity = 20,
+                     double radius = 0.05);
+
+    size_t GetSize() const;
+
+    // The optimum perturbed by the normal noise of perturbation * the bound widths and moved into the bounds.
+    // The perturbation is halved until the point satisfies the constraints, nullopt if the optimum itself doesn't
+    std::optional<Eigen::VectorXd> GetStartPoint(size_t optimum, double perturbation,
+                                                 std::mt19937 &random_source) const;
+
+    // Adds the distinct optima of the run, the best of them and the most hit old ones are kept in this order.
+    // The optimum of the start is the library optimum it was seeded from, nullopt for the sampled starts.
+    // Returns the statistics of the run
+    WarmStartStatistics Update(const std::vector<StartResult> &results,
+                               const std::vector<std::optional<size_t>> &start_optima);
+
+    void Save() const;
+
+    const WarmStartStatistics &GetStatistics() const;
+
+    std::string GetPath() const;
+
+private:
+    struct Optimum {
+        Eigen::VectorXd free_fluxes;
+        // of the last run it was found in
+        double ssr;
+        size_t uses;
+        size_t hits;
+    };
+
+    void Load();
+
+    // The root mean square of the difference divided by the bound widths
+    double GetDistance(const Eigen::VectorXd &lhs, const Eigen::VectorXd &rhs) const;
+
+    bool IsFeasible(const Eigen::VectorXd &free_fluxes) const;
+
+    std::string directory_;
+    const Problem &problem_;
+    uint64_t model_hash_;
+    size_t capacity_;
+    double radius_;
+    Eigen::VectorXd lower_bounds_;
+    Eigen::VectorXd upper_bounds_;
+    Eigen::VectorXd bounds_width_;
+    std::vector<Optimum> optima_;
+    WarmStartStatistics statistics_;
+};
+
+void PrintWarmStartStatistics(const WarmStartStatistics &run_statistics, const WarmStartStatistics &total_statistics);
+} // namespace khnum
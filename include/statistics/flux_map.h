@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// All the fluxes in the order of problem.reactions are coefficients * Vfree + offsets:
+// the isotopomer balance reactions are 1, the dependent fluxes are -nullspace * Vfree
+struct FluxMap {
+    Matrix coefficients;
+    Eigen::VectorXd offsets;
+};
+
+FluxMap GetFluxMap(const Problem &problem);
+
+// The isotopomer balance reactions aren't fluxes of the model
+bool IsModelFlux(const FluxMap &flux_map, int reaction);
+
+// The positions of the model fluxes in problem.reactions
+std::vector<int> GetModelFluxes(const FluxMap &flux_map);
+} // namespace khnum
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+#include "simulator/generator.h"
+#include "solver/solver_parameters.h"
+
+
+namespace khnum {
+struct ParameterCovariance {
+    Matrix covariance;
+    // the directions of the parameters which don't change the residuals, a column per direction
+    Matrix null_directions;
+    int rank;
+};
+
+// The covariance (J^T J)^-1 of the weighted least squares restricted to the null space of the active rows,
+// the parameters pinned by the active bounds and constraints have no variance along the rows.
+// The columns are scaled by the scales before the SVD, the singular values below tolerance * the largest
+// are the null directions, they are left out of the covariance
+ParameterCovariance GetParameterCovariance(const Matrix &jacobian, const Matrix &active_rows,
+                                           const Eigen::VectorXd &scales, double tolerance = 1.e-8);
+
+struct LinearizedStatistics {
+    // all the fluxes at the optimum in the order of problem.reactions
+    Eigen::VectorXd fluxes;
+    // of the free fluxes
+    ParameterCovariance free_flux_covariance;
+    // of all the fluxes in the order of problem.reactions
+    Matrix covariance;
+    Matrix correlations;
+    // infinite for the fluxes which change along the null directions
+    Eigen::VectorXd standard_errors;
+    // positions of the free fluxes at their bounds and of the constraints rows active at the optimum
+    std::vector<int> active_bounds;
+    std::vector<int> active_constraints;
+
+    double ssr;
+    int degrees_of_freedom;
+    // the 95% range of the SSR, the fit is accepted if the SSR is inside it
+    double ssr_lower;
+    double ssr_upper;
+    bool is_fit_accepted;
+};
+
+// The linearized statistics at the optimum of the free fluxes, costs one jacobian evaluation
+LinearizedStatistics GetLinearizedStatistics(const Problem &problem, const SimulatorGenerator &generator,
+                                             const SolverParameters &solver_parameters,
+                                             const Eigen::VectorXd &optimum, double tolerance = 1.e-8);
+
+// The standard errors of the model fluxes, the strongly correlated free fluxes and the chi-square test
+void PrintLinearizedStatistics(const Problem &problem, const LinearizedStatistics &statistics);
+} // namespace khnum
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+#include "simulator/generator.h"
+#include "solver/solver_parameters.h"
+#include "statistics/flux_map.h"
+
+
+namespace khnum {
+struct StartResult;
+
+enum class Resampling {
+    measurements, ///< the measured values are drawn from N(mid, error^2)
+    residuals     ///< the weighted residuals of the best fit are bootstrapped around the simulated values
+};
+
+struct MonteCarloParameters {
+    size_t total_replicates = 500;
+    Resampling resampling = Resampling::measurements;
+    // of every refit, they are warm-started from the best fit
+    int max_iterations = 100;
+    // the refits move little compared to the bound widths, so the scaled step criterion is tighter
+    double epsx = 1.e-7;
+    // the hardware concurrency is used if zero
+    size_t total_workers = 0;
+    uint64_t seed = 0;
+    // a line per replicate: the replicate, SSR, iterations and all the model fluxes, empty for no file
+    std::string output_path = "monte_carlo.csv";
+};
+
+struct FluxDistribution {
+    // position in problem.reactions
+    int reaction;
+    std::string name;
+    double mean;
+    double standard_deviation;
+    // 2.5% and 97.5% quantiles
+    double lower;
+    double upper;
+};
+
+// Refits the replicates of the measurements. The workers share the generated model,
+// every worker has one solver and only replaces its measured values between the replicates
+class MonteCarlo {
+public:
+    MonteCarlo(const Problem &problem,
+               const SimulatorGenerator &generator,
+               const SolverParameters &solver_parameters,
+               const MonteCarloParameters &parameters);
+
+    // The optimum is of the free fluxes, the replicates with not finite SSR are dropped
+    std::vector<FluxDistribution> Run(const Eigen::VectorXd &optimum);
+
+    // Draws the measured values of the replicate in the residuals order, the same seed gives the same values.
+    // The best fit residuals are only used by the residuals resampling
+    void Resample(const Eigen::VectorXd &best_fit_residuals, uint64_t seed, Eigen::VectorXd &measured_values) const;
+
+private:
+    void RunWorker(const Eigen::VectorXd &optimum, const Eigen::VectorXd &best_fit_residuals,
+                   std::vector<Eigen::VectorXd> &replicate_fluxes);
+
+    void WriteReplicate(size_t replicate, const StartResult &result, const Eigen::VectorXd &fluxes);
+
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    SolverParameters solver_parameters_;
+    MonteCarloParameters parameters_;
+    FluxMap flux_map_;
+    std::vector<int> model_fluxes_;
+    // in the residuals order
+    Eigen::VectorXd measured_values_;
+    Eigen::VectorXd errors_;
+
+    std::atomic<size_t> next_replicate_;
+    std::mutex output_mutex_;
+    std::ofstream output_;
+};
+} // namespace khnum
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+#include "simulator/generator.h"
+#include "solver/solver_parameters.h"
+#include "statistics/flux_map.h"
+
+
+namespace khnum {
+class Solver;
+
+enum class Proposal {
+    adaptive_metropolis, ///< the random walk with the covariance adapted during the burn-in
+    mala                 ///< Metropolis adjusted Langevin, drifts along the preconditioned gradient of the log posterior
+};
+
+struct SamplerParameters {
+    Proposal proposal = Proposal::mala;
+    size_t total_chains = 4;
+    // per chain, the step is adapted during all the burn-in, the covariance in the windows of its middle
+    size_t burn_in = 1000;
+    // per chain after the burn-in, every thinning-th is kept
+    size_t total_samples = 2000;
+    size_t thinning = 1;
+    // the hardware concurrency is used if zero
+    size_t total_workers = 0;
+    uint64_t seed = 0;
+    // a line per kept sample: the chain, the sample, the log posterior and all the model fluxes, empty for no file
+    std::string output_path = "posterior.csv";
+};
+
+struct ChainDiagnostics {
+    // split R-hat, close to 1 for the converged chains
+    double r_hat;
+    // by the Geyer initial monotone sequence of the autocorrelations of all the chains
+    double effective_sample_size;
+};
+
+// The chains have the same length, R-hat is 1 and ESS is the total samples for the constant values
+ChainDiagnostics GetChainDiagnostics(const std::vector<std::vector<double>> &chains);
+
+struct FluxPosterior {
+    // position in problem.reactions
+    int reaction;
+    std::string name;
+    double mean;
+    double standard_deviation;
+    // 2.5% and 97.5% quantiles
+    double lower;
+    double upper;
+    ChainDiagnostics diagnostics;
+};
+
+// Samples the posterior exp(-SSR / 2) of the free fluxes with the flat prior on the feasible polytope.
+// The free fluxes fixed by their bounds aren't sampled. The proposal covariance starts from the linearized
+// covariance at the optimum. The chains run in parallel, every worker has its own solver of the shared model
+class PosteriorSampler {
+public:
+    PosteriorSampler(const Problem &problem,
+                     const SimulatorGenerator &generator,
+                     const SolverParameters &solver_parameters,
+                     const SamplerParameters &parameters);
+
+    // The optimum is of the free fluxes, the chains start around it
+    std::vector<FluxPosterior> Run(const Eigen::VectorXd &optimum);
+
+    // The accepted part of the proposals after the burn-in of all the chains of the last run
+    double GetAcceptanceRate() const;
+
+private:
+    struct Chain {
+        // the kept free fluxes
+        std::vector<Eigen::VectorXd> samples;
+        size_t accepted;
+        size_t evaluations;
+        double seconds;
+    };
+
+    void RunWorker(const Eigen::VectorXd &optimum, const Matrix &initial_covariance, std::vector<Chain> &chains);
+
+    void RunChain(Solver &solver, size_t chain_number, const Eigen::VectorXd &optimum,
+                  const Matrix &initial_covariance, Chain &chain);
+
+    // -inf for the failed simulations, the gradient is of the sampled fluxes
+    double GetLogPosterior(Solver &solver, const Eigen::VectorXd &free_fluxes, Eigen::VectorXd *gradient) const;
+
+    bool IsFeasible(const Eigen::VectorXd &free_fluxes) const;
+
+    void WriteSample(size_t chain_number, size_t sample, double log_posterior, const Eigen::VectorXd &free_fluxes);
+
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    SolverParameters solver_parameters_;
+    SamplerParameters parameters_;
+    FluxMap flux_map_;
+    std::vector<int> model_fluxes_;
+    Eigen::VectorXd lower_bounds_;
+    Eigen::VectorXd upper_bounds_;
+    // positions of the free fluxes with lower < upper bound
+    std::vector<int> sampled_fluxes_;
+    double acceptance_rate_ = 0.0;
+
+    std::atomic<size_t> next_chain_;
+    std::mutex output_mutex_;
+    std::ofstream output_;
+};
+} // namespace khnum
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <utility>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+#include "simulator/generator.h"
+#include "solver/solver_parameters.h"
+#include "statistics/flux_map.h"
+
+
+namespace khnum {
+struct ProfileParameters {
+    // SSR increase at the interval ends, the chi-square quantile of one degree of freedom for 95% confidence
+    double threshold = 3.84;
+    // refits in every direction from the optimum until the threshold is crossed
+    int max_steps = 12;
+    // refits of the crossed end, it's found if the SSR increase there is threshold * (1 +- tolerance)
+    int max_refinements = 10;
+    double threshold_tolerance = 0.05;
+    // of every refit, they are warm-started from the previous profile point
+    int max_iterations = 50;
+    // the refits move little compared to the bound widths, so the scaled step criterion is tighter
+    double epsx = 1.e-7;
+    // the first step as a fraction of the flux feasible range
+    double initial_step = 0.02;
+    // the hardware concurrency is used if zero
+    size_t total_workers = 0;
+};
+
+struct FluxInterval {
+    // position in problem.reactions
+    int reaction;
+    std::string name;
+    double value;
+    double lower;
+    double upper;
+    // the threshold was crossed, otherwise the end is the feasible limit or the last step
+    bool is_lower_found;
+    bool is_upper_found;
+    int refits;
+    // the lowest SSR seen on the profile, lower than the optimum's if the fit wasn't global
+    double lowest_ssr;
+};
+
+// Profile likelihood: the flux is pinned at the values stepping outward from the optimum,
+// the other free fluxes are refitted by a short warm-started LM. The interval ends are where
+// the SSR increase crosses the threshold, sqrt(SSR increase) is interpolated between the steps
+// and refined by the refits at the interpolated values.
+// The profiles of the different fluxes are run in parallel, every worker has its own solver
+class ProfileLikelihood {
+public:
+    ProfileLikelihood(const Problem &problem,
+                      const SimulatorGenerator &generator,
+                      const SolverParameters &solver_parameters,
+                      const ProfileParameters &parameters);
+
+    // The profiled fluxes are coefficients * Vfree + offsets of the flux map instead of GetFluxMap(problem)
+    ProfileLikelihood(const Problem &problem,
+                      const SimulatorGenerator &generator,
+                      const SolverParameters &solver_parameters,
+                      const ProfileParameters &parameters,
+                      const FluxMap &flux_map);
+
+    // The reactions are the positions in problem.reactions, the optimum is of the free fluxes
+    std::vector<FluxInterval> Run(const Eigen::VectorXd &optimum, double optimum_ssr,
+                                  const std::vector<int> &reactions);
+
+private:
+    // The ranges are the feasible minimum and maximum of the fluxes
+    void RunWorker(const Eigen::VectorXd &optimum, double optimum_ssr, const std::vector<int> &reactions,
+                   const std::vector<std::pair<double, double>> &ranges, std::vector<FluxInterval> &intervals);
+
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    SolverParameters solver_parameters_;
+    ProfileParameters parameters_;
+    FluxMap flux_map_;
+    std::atomic<size_t> next_reaction_;
+};
+} // namespace khnum
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <vector>
+
+
+namespace khnum {
+// Linear interpolation between the closest ranks of the sorted values, NaN if there are no values
+double GetQuantile(const std::vector<double> &sorted_values, double probability);
+} // namespace khnum
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 
 
 
@@ -52,4 +53,13 @@ bool operator==(EmuSubstrate const &lhs, EmuSubstrate const &rhs);
 bool operator!=(EmuSubstrate const &lhs, EmuSubstrate const &rhs);
 
 bool operator==(const EmuReaction &lhs, const EmuReaction &rhs);
-} //namespace khnum
\ No newline at end of file
+} //namespace khnum
+
+
+namespace std {
+// need this for unordered stl containers
+template<>
+struct hash<khnum::Emu> {
+    size_t operator()(const khnum::Emu &emu) const;
+};
+} // namespace std
\ No newline at end of file
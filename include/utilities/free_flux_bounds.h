@@ -0,0 +1,12 @@
+#pragma once
+
+#include <utility>
+
+#include "utilities/problem.h"
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Returns the lower and the upper bounds of the free fluxes, they go first in the bounds of the problem
+std::pair<Eigen::VectorXd, Eigen::VectorXd> GetFreeFluxBounds(const Problem &problem);
+} // namespace khnum
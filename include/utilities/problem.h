@@ -24,6 +24,12 @@ struct GeneratorParameters {
     std::vector<int> free_fluxes_id;
 };
 
+// matrix * Vfree <= right_part
+struct LinearConstraints {
+    Matrix matrix;
+    Eigen::VectorXd right_part;
+};
+
 struct Problem {
     std::vector<ReactionsName> reactions;
     size_t reactions_total;
@@ -34,6 +40,10 @@ struct Problem {
     bool use_analytic_jacobian = false;
     std::vector<double> lower_bounds;
     std::vector<double> upper_bounds;
+    // the free fluxes constraints equivalent to nullspace * Vfree <= 0
+    LinearConstraints constraints;
+    // positions of the free fluxes which are the backward fluxes of the reversible reactions
+    std::vector<int> exchange_fluxes;
     GeneratorParameters simulator_parameters_;
 };
 } //namesapce khnum
\ No newline at end of file
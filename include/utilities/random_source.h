@@ -0,0 +1,10 @@
+#pragma once
+
+#include <random>
+#include <cstdint>
+
+
+namespace khnum {
+// Returns the Mersenne Twister seeded by both halves of the 64-bit seed
+std::mt19937 CreateRandomSource(uint64_t seed);
+} // namespace khnum
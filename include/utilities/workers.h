@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <functional>
+
+
+namespace khnum {
+// Returns the hardware concurrency for zero requested workers, there are no more workers than the tasks
+// and at least one
+size_t GetTotalWorkers(size_t requested_workers, size_t total_tasks);
+
+// Runs every worker on its own thread and rethrows the first error once all of them finish,
+// an exception leaving a thread would terminate the program. The error is flagged in is_failed if it's given,
+// so the other workers can stop early
+void RunWorkers(size_t total_workers, const std::function<void(size_t worker)> &run_worker,
+                std::atomic<bool> *is_failed = nullptr);
+} // namespace khnum
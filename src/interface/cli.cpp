@@ -2,79 +2,368 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
 #include <vector>
 #include <memory>
-#include <thread>
+#include <string>
+#include <map>
+#include <random>
+#include <optional>
+#include <cmath>
+#include <filesystem>
+#include <functional>
 #include "alglib/ap.h"
-#include <chrono>
 
 #include "simulator/generator.h"
 #include "modeller/modeller.h"
 #include "parser/open_flux_parser/open_flux_parser.h"
 #include "solver/solver.h"
+#include "solver/exchange_transform.h"
+#include "solver/multistart_scheduler.h"
+#include "solver/start_log.h"
+#include "solver/telemetry.h"
+#include "solver/batch_fitter.h"
+#include "solver/differential_evolution.h"
+#include "solver/identifiability.h"
+#include "statistics/flux_map.h"
+#include "statistics/linearized_statistics.h"
+#include "statistics/profile_likelihood.h"
+#include "statistics/monte_carlo.h"
+#include "statistics/posterior_sampler.h"
 #include "clusterizer/clusterizer.h"
 #include "parser/maranas_parser.h"
 
 
 namespace khnum {
-void RunCli() {
+namespace {
+// Parses --key=value and --flag arguments
+std::map<std::string, std::string> ParseOptions(int argc, char **argv) {
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument.rfind("--", 0) != 0) {
+            throw std::runtime_error("Unknown argument " + argument);
+        }
+        const size_t equal_sign = argument.find('=');
+        if (equal_sign == std::string::npos) {
+            options[argument.substr(2)] = "true";
+        } else {
+            options[argument.substr(2, equal_sign - 2)] = argument.substr(equal_sign + 1);
+        }
+    }
+    return options;
+}
+
+std::string GetOption(std::map<std::string, std::string> &options, const std::string &key,
+                      const std::string &default_value) {
+    auto option = options.find(key);
+    if (option == options.end()) {
+        return default_value;
+    }
+    const std::string value = option->second;
+    options.erase(option);
+    return value;
+}
+
+// The post-fit statistics are optional, a failed stage is reported and the rest of the run goes on
+void RunPostFitStage(const std::string &name, const std::function<void()> &stage) {
     try {
-        //std::unique_ptr<IParser> parser(new ParserOpenFlux("../modelLast"));
-        std::unique_ptr<IParser> parser(new ParserMaranas("../modelMaranas/"));
+        stage();
+    } catch (std::runtime_error &error) {
+        std::cerr << name << " skipped: " << error.what() << std::endl;
+    }
+}
+} // namespace
+
+
+void RunCli(int argc, char **argv) {
+    try {
+        std::map<std::string, std::string> options = ParseOptions(argc, argv);
+        // the batch only fits the datasets, these options would be silently ignored
+        if (options.count("batch")) {
+            for (const char *option : {"telemetry", "telemetry-output", "start-log", "resume",
+                                       "warm-start-library", "warm-start-fraction", "warm-start-perturbation",
+                                       "time-budget", "prioritize", "screening-iterations", "halving-factor",
+                                       "basin-registry", "basin-radius", "global", "population", "generations",
+                                       "polished", "target-ssr", "linearized", "profile", "profile-steps",
+                                       "monte-carlo", "resampling", "monte-carlo-output", "posterior",
+                                       "chains", "burn-in", "posterior-samples", "thinning",
+                                       "posterior-output"}) {
+                if (options.count(option)) {
+                    throw std::runtime_error(std::string("--") + option + " can't be used with --batch");
+                }
+            }
+        }
+        const std::string parser_type = GetOption(options, "parser", "maranas");
+        const std::string model_path = GetOption(options, "model", "../modelMaranas/");
+
+        SolverParameters solver_parameters;
+        const std::string optimizer = GetOption(options, "optimizer", "alglib");
+        if (optimizer == "alglib") {
+            solver_parameters.optimizer = Optimizer::alglib_lm;
+        } else if (optimizer == "native") {
+            solver_parameters.optimizer = Optimizer::native_lm;
+        } else if (optimizer == "geodesic") {
+            solver_parameters.optimizer = Optimizer::geodesic_lm;
+        } else {
+            throw std::runtime_error("Unknown optimizer " + optimizer);
+        }
+        const std::string sampling = GetOption(options, "sampling", "box");
+        if (sampling == "box") {
+            solver_parameters.start_sampling = StartSampling::box;
+        } else if (sampling == "hit-and-run") {
+            solver_parameters.start_sampling = StartSampling::hit_and_run;
+        } else if (sampling == "halton") {
+            solver_parameters.start_sampling = StartSampling::halton;
+        } else {
+            throw std::runtime_error("Unknown start sampling " + sampling);
+        }
+        solver_parameters.use_adaptive_tolerance = GetOption(options, "adaptive-tolerance", "false") == "true";
+        solver_parameters.use_exchange_transform = GetOption(options, "exchange-transform", "false") == "true";
+        solver_parameters.exchange_scale = std::stod(GetOption(options, "exchange-scale", "1"));
+        solver_parameters.use_variable_scaling = GetOption(options, "scaling", "false") == "true";
+
+        const std::string free_fluxes = GetOption(options, "free-fluxes", "priority");
+        modelling_utills::FreeFluxSelection free_flux_selection;
+        if (free_fluxes == "priority") {
+            free_flux_selection = modelling_utills::FreeFluxSelection::priority;
+        } else if (free_fluxes == "qr") {
+            free_flux_selection = modelling_utills::FreeFluxSelection::pivoted_qr;
+        } else {
+            throw std::runtime_error("Unknown free flux selection " + free_fluxes);
+        }
+
+        const std::string identifiability = GetOption(options, "identifiability", "warn");
+        if (identifiability != "off" && identifiability != "warn" && identifiability != "fix") {
+            throw std::runtime_error("Unknown identifiability check " + identifiability);
+        }
+        const size_t identifiability_points = std::stoul(GetOption(options, "identifiability-points", "10"));
+
+        const bool use_linearized_statistics = GetOption(options, "linearized", "true") == "true";
+
+        const std::string profile = GetOption(options, "profile", "off");
+        if (profile != "off" && profile != "free" && profile != "all") {
+            throw std::runtime_error("Unknown profile likelihood fluxes " + profile);
+        }
+        ProfileParameters profile_parameters;
+        profile_parameters.max_steps = std::stoi(GetOption(options, "profile-steps", "12"));
+
+        MonteCarloParameters monte_carlo_parameters;
+        monte_carlo_parameters.total_replicates = std::stoul(GetOption(options, "monte-carlo", "0"));
+        const std::string resampling = GetOption(options, "resampling", "measurements");
+        if (resampling == "measurements") {
+            monte_carlo_parameters.resampling = Resampling::measurements;
+        } else if (resampling == "residuals") {
+            monte_carlo_parameters.resampling = Resampling::residuals;
+        } else {
+            throw std::runtime_error("Unknown resampling " + resampling);
+        }
+        monte_carlo_parameters.output_path = GetOption(options, "monte-carlo-output", "monte_carlo.csv");
+
+        const std::string posterior = GetOption(options, "posterior", "off");
+        SamplerParameters sampler_parameters;
+        if (posterior == "mala") {
+            sampler_parameters.proposal = Proposal::mala;
+        } else if (posterior == "am") {
+            sampler_parameters.proposal = Proposal::adaptive_metropolis;
+        } else if (posterior != "off") {
+            throw std::runtime_error("Unknown posterior sampler " + posterior);
+        }
+        sampler_parameters.total_chains = std::stoul(GetOption(options, "chains", "4"));
+        sampler_parameters.burn_in = std::stoul(GetOption(options, "burn-in", "1000"));
+        sampler_parameters.total_samples = std::stoul(GetOption(options, "posterior-samples", "2000"));
+        sampler_parameters.thinning = std::stoul(GetOption(options, "thinning", "1"));
+        sampler_parameters.output_path = GetOption(options, "posterior-output", "posterior.csv");
+
+        MultistartParameters multistart_parameters;
+        multistart_parameters.total_starts = std::stoul(GetOption(options, "starts", "30"));
+        multistart_parameters.total_workers = std::stoul(GetOption(options, "threads", "0"));
+        multistart_parameters.pin_workers = GetOption(options, "pin", "false") == "true";
+        multistart_parameters.use_basin_registry = GetOption(options, "basin-registry", "false") == "true";
+        multistart_parameters.basin_radius = std::stod(GetOption(options, "basin-radius", "0.05"));
+        multistart_parameters.screening_iterations = std::stoi(GetOption(options, "screening-iterations", "0"));
+        multistart_parameters.halving_factor = std::stoi(GetOption(options, "halving-factor", "3"));
+        const std::string time_budget = GetOption(options, "time-budget", "");
+        if (!time_budget.empty()) {
+            multistart_parameters.time_budget = std::stod(time_budget);
+        }
+        // the budgeted run wants the good results first
+        multistart_parameters.prioritize_starts =
+            GetOption(options, "prioritize", time_budget.empty() ? "false" : "true") == "true";
+        multistart_parameters.log_path = GetOption(options, "start-log", "");
+        multistart_parameters.resume = GetOption(options, "resume", "false") == "true";
+        multistart_parameters.warm_start_library = GetOption(options, "warm-start-library", "");
+        multistart_parameters.warm_start_fraction = std::stod(GetOption(options, "warm-start-fraction", "0.25"));
+        multistart_parameters.warm_start_perturbation =
+            std::stod(GetOption(options, "warm-start-perturbation", "0.02"));
+        const std::string seed = GetOption(options, "seed", "");
+        if (!seed.empty()) {
+            multistart_parameters.master_seed = std::stoull(seed);
+        } else if (multistart_parameters.resume && !multistart_parameters.log_path.empty() &&
+                   std::filesystem::exists(multistart_parameters.log_path)) {
+            // the resumed starts are of the logged seed
+            multistart_parameters.master_seed = ReadStartLog(multistart_parameters.log_path).header.master_seed;
+        }
+
+        // a directory of measurements.csv files of the samples fitted against the model instead of its own ones
+        const std::string batch = GetOption(options, "batch", "");
+        BatchParameters batch_parameters;
+        batch_parameters.output_path = GetOption(options, "batch-output", "batch.csv");
+        batch_parameters.starts_per_dataset = multistart_parameters.total_starts;
+        batch_parameters.total_workers = multistart_parameters.total_workers;
+        batch_parameters.pin_workers = multistart_parameters.pin_workers;
+        batch_parameters.master_seed = multistart_parameters.master_seed;
+
+        const std::string telemetry_format = GetOption(options, "telemetry", "off");
+        std::unique_ptr<Telemetry> telemetry;
+        if (telemetry_format == "csv" || telemetry_format == "json") {
+            telemetry = std::make_unique<Telemetry>(
+                telemetry_format == "csv" ? TelemetryFormat::csv : TelemetryFormat::json,
+                GetOption(options, "telemetry-output", "telemetry"));
+        } else if (telemetry_format != "off") {
+            throw std::runtime_error("Unknown telemetry format " + telemetry_format);
+        }
+
+        const std::string global = GetOption(options, "global", "multistart");
+        if (global != "multistart" && global != "de") {
+            throw std::runtime_error("Unknown global search " + global);
+        }
+        DifferentialEvolutionParameters evolution_parameters;
+        evolution_parameters.population_size = std::stoul(GetOption(options, "population", "0"));
+        evolution_parameters.max_generations = std::stoi(GetOption(options, "generations", "20"));
+        evolution_parameters.total_polished = std::stoul(GetOption(options, "polished", "12"));
+        const std::string target_ssr = GetOption(options, "target-ssr", "");
+        if (!target_ssr.empty()) {
+            evolution_parameters.target_ssr = std::stod(target_ssr);
+        }
+        evolution_parameters.total_workers = multistart_parameters.total_workers;
+        evolution_parameters.pin_workers = multistart_parameters.pin_workers;
+        evolution_parameters.master_seed = multistart_parameters.master_seed;
+
+        if (!options.empty()) {
+            throw std::runtime_error("Unknown option --" + options.begin()->first);
+        }
+
+        std::unique_ptr<IParser> parser;
+        if (parser_type == "openflux") {
+            parser.reset(new ParserOpenFlux(model_path));
+        } else if (parser_type == "maranas") {
+            parser.reset(new ParserMaranas(model_path));
+        } else {
+            throw std::runtime_error("Unknown parser " + parser_type);
+        }
         parser->Parse();
 
         Modeller modeller(parser->GetResults());
 
         modeller.CalculateInputSubstrateMids();
         modeller.CreateEmuNetworks();
-        modeller.CreateNullspaceMatrix();
+        modeller.CreateNullspaceMatrix(free_flux_selection);
         modeller.CalculateFluxBounds();
+        modeller.PresolveConstraints();
         modeller.CalculateMeasurementsCount();
         modeller.CheckModelForErrors();
 
         Problem problem = modeller.GetProblem();
         SimulatorGenerator generator(problem.simulator_parameters_);
-        std::vector<alglib::real_1d_array> allSolutions;
 
-        bool use_multithread = false;
-        if (use_multithread) {
-            const unsigned int num_threads = std::thread::hardware_concurrency();
-            std::cout << num_threads << std::endl;
-
-            std::vector<std::vector<alglib::real_1d_array>> one_thread_solutions(num_threads);
-            auto one_thread = [&generator](const Problem &problem, std::vector<alglib::real_1d_array> &result) {
-                Solver solver(problem, generator);
-                solver.Solve();
-                result = solver.GetResult();
-            };
-
-            std::vector<std::thread> threads;
-            for (int i = 0; i < num_threads; ++i) {
-                threads.push_back(std::thread(one_thread, std::ref(problem), std::ref(one_thread_solutions[i])));
+        if (identifiability != "off") {
+            const uint64_t seed = multistart_parameters.master_seed ? *multistart_parameters.master_seed
+                                                                    : std::random_device()();
+            const IdentifiabilityReport report =
+                CheckIdentifiability(problem, generator, seed, identifiability_points);
+            if (identifiability == "fix") {
+                FixNonIdentifiableFluxes(report, problem);
             }
-            std::chrono::time_point<std::chrono::system_clock> start, end;
-            start = std::chrono::system_clock::now();
-            for (std::thread &t : threads) {
-                t.join();
+        }
+
+        // every solver applies the same transform, it's reported once
+        if (solver_parameters.use_exchange_transform) {
+            std::cout << "Exchange transform: " << GetTransformedExchangeFluxes(problem).size() << " of "
+                      << problem.exchange_fluxes.size() << " exchange fluxes are compactified" << std::endl;
+        }
+
+        if (!batch.empty()) {
+            BatchFitter batch_fitter(problem, generator, solver_parameters, batch_parameters);
+            batch_fitter.Run(ReadBatchDatasets(batch, problem));
+            return;
+        }
+
+        std::vector<StartResult> results;
+        if (global == "de") {
+            DifferentialEvolution evolution(problem, generator, solver_parameters, evolution_parameters);
+            evolution.SetTelemetry(telemetry.get());
+            results = evolution.Run();
+        } else {
+            MultistartScheduler scheduler(problem, generator, solver_parameters, multistart_parameters);
+            scheduler.SetTelemetry(telemetry.get());
+            results = scheduler.Run();
+        }
+        if (telemetry) {
+            telemetry->PrintSummary();
+            telemetry->Write();
+        }
+        std::vector<alglib::real_1d_array> allSolutions;
+        std::optional<StartResult> best_result;
+        for (const StartResult &result : results) {
+            if (!result.is_screened_out) {
+                allSolutions.push_back(result.free_fluxes);
+                // the failed simulations and the cancelled starts aren't the best fit, a NaN would never be replaced
+                if (!result.is_cancelled && std::isfinite(result.ssr) &&
+                    (!best_result || result.ssr < best_result->ssr)) {
+                    best_result = result;
+                }
             }
-            end = std::chrono::system_clock::now();
-            double elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>
-                    (end-start).count();
+        }
+        // the clusterizer needs a solution
+        if (allSolutions.empty()) {
+            throw std::runtime_error(multistart_parameters.time_budget ?
+                                     "No start completed within the time budget" : "No start was run");
+        }
 
-            elapsed_milliseconds /= 1000;
-            std::cout << "Average time: " << static_cast<double>(elapsed_milliseconds) / (num_threads * 30)
-                << " seconds per iteration" << std::endl;
+        if (use_linearized_statistics && best_result && std::isfinite(best_result->ssr)) {
+            RunPostFitStage("Linearized statistics", [&]() {
+                const LinearizedStatistics statistics =
+                    GetLinearizedStatistics(problem, generator, solver_parameters,
+                                            Eigen::Map<const Eigen::VectorXd>(best_result->free_fluxes.getcontent(),
+                                                                              best_result->free_fluxes.length()));
+                PrintLinearizedStatistics(problem, statistics);
+            });
+        }
 
-            for (const auto &vec : one_thread_solutions) {
-                for (const alglib::real_1d_array &solution : vec) {
-                    allSolutions.push_back(solution);
+        if (profile != "off" && best_result) {
+            profile_parameters.total_workers = multistart_parameters.total_workers;
+            const FluxMap flux_map = GetFluxMap(problem);
+            std::vector<int> reactions;
+            const int first_free_flux = problem.reactions_total - problem.nullspace.cols();
+            for (int reaction = profile == "free" ? first_free_flux : 0;
+                 reaction < static_cast<int>(problem.reactions_total); ++reaction) {
+                if (IsModelFlux(flux_map, reaction)) {
+                    reactions.push_back(reaction);
                 }
             }
+            ProfileLikelihood profile_likelihood(problem, generator, solver_parameters, profile_parameters);
+            profile_likelihood.Run(Eigen::Map<const Eigen::VectorXd>(best_result->free_fluxes.getcontent(),
+                                                                     best_result->free_fluxes.length()),
+                                   best_result->ssr, reactions);
+        }
 
-        } else {
-            Solver solver(problem, generator);
-            solver.Solve();
-            allSolutions = solver.GetResult();
+        if (monte_carlo_parameters.total_replicates > 0 && best_result) {
+            monte_carlo_parameters.total_workers = multistart_parameters.total_workers;
+            monte_carlo_parameters.seed = best_result->seed;
+            RunPostFitStage("Monte Carlo", [&]() {
+                MonteCarlo monte_carlo(problem, generator, solver_parameters, monte_carlo_parameters);
+                monte_carlo.Run(Eigen::Map<const Eigen::VectorXd>(best_result->free_fluxes.getcontent(),
+                                                                  best_result->free_fluxes.length()));
+            });
+        }
+
+        if (posterior != "off" && best_result && std::isfinite(best_result->ssr)) {
+            sampler_parameters.total_workers = multistart_parameters.total_workers;
+            sampler_parameters.seed = best_result->seed;
+            PosteriorSampler sampler(problem, generator, solver_parameters, sampler_parameters);
+            sampler.Run(Eigen::Map<const Eigen::VectorXd>(best_result->free_fluxes.getcontent(),
+                                                          best_result->free_fluxes.length()));
         }
 
         Clasterizer clusterizer(allSolutions);
@@ -90,8 +379,10 @@ void RunCli() {
 
     } catch (std::runtime_error &error) {
         std::cerr << error.what() << std::endl;
+    } catch (std::logic_error &error) {
+        std::cerr << "Wrong option value: " << error.what() << std::endl;
     }
 
     return;
 }
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
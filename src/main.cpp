@@ -1,6 +1,6 @@
 #include "interface/cli.h"
 #include <iostream>
-int main() {
-    khnum::RunCli();
+int main(int argc, char **argv) {
+    khnum::RunCli(argc, argv);
     return 0;
-} //namespace khnum
\ No newline at end of file
+} //namespace khnum
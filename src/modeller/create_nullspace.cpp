@@ -1,5 +1,9 @@
 #include "modeller/create_nullspace.h"
 
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
 #include "utilities/reaction.h"
 #include "utilities/matrix.h"
 
@@ -11,6 +15,38 @@
 namespace khnum {
 namespace modelling_utills {
 const double epsilon = 1.e-12;
+
+namespace {
+// Returns the positions of the linearly independent columns, the best conditioned go first.
+// The columns are normalized, so the pivoting prefers the most orthogonal ones rather than the longest
+std::vector<int> SelectIndependentColumns(const Matrix &columns) {
+    std::vector<int> selected;
+    if (columns.cols() == 0) {
+        return selected;
+    }
+    Matrix normalized = columns;
+    for (int column = 0; column < normalized.cols(); ++column) {
+        const double norm = normalized.col(column).norm();
+        if (norm > epsilon) {
+            normalized.col(column) /= norm;
+        }
+    }
+    const Eigen::ColPivHouseholderQR<Matrix> decomposition(normalized);
+    for (int i = 0; i < decomposition.rank(); ++i) {
+        selected.push_back(decomposition.colsPermutation().indices()(i));
+    }
+    return selected;
+}
+
+Matrix GetColumns(const Matrix &matrix, const std::vector<int> &columns) {
+    Matrix result(matrix.rows(), columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        result.col(i) = matrix.col(columns[i]);
+    }
+    return result;
+}
+} // namespace
+
 // Transform stoichiometry matrix to form
 /*
  *
@@ -23,10 +59,16 @@ const double epsilon = 1.e-12;
 // So Vdep = -A * Vfree
 // And return the A matrix
 
-Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reactions) {
+Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reactions, FreeFluxSelection selection) {
+    if (selection == FreeFluxSelection::pivoted_qr) {
+        return GetNullspaceWithPivotedQR(original_matrix, reactions);
+    }
+
     // As we work with the diagonal elements, pivot.column == pivot.row
     // So below I use it as synonymous
     Matrix matrix = original_matrix;
+    // the columns of the dependent fluxes are the first ones
+    Matrix basis = original_matrix;
 
     std::cout << matrix.cols() << " " << matrix.rows() << std::endl;
     Eigen::FullPivLU<Matrix> dec(matrix);
@@ -46,6 +88,7 @@ Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reacti
                         "Can't transform stoichiometry matrix at column number " + std::to_string(column));
                 }
                 matrix.col(column).swap(matrix.col(column_to_swap));
+                basis.col(column).swap(basis.col(column_to_swap));
                 std::swap(reactions[metabolite_balance_reactions_total + column],
                           reactions[metabolite_balance_reactions_total + column_to_swap]);
                 std::cout << "Reaction num " << metabolite_balance_reactions_total + column << " and num "
@@ -72,10 +115,121 @@ Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reacti
     }
 
     Matrix result = matrix.block(0, matrix.rows(), matrix.rows(), matrix.cols() - matrix.rows());
+    std::cout << "Dependent fluxes basis condition number: "
+              << GetConditionNumber(basis.leftCols(matrix.rows())) << std::endl;
+    return result;
+}
+
+
+// S * P = [B N], B * Vdep + N * Vfree = 0, so A = B^-1 * N.
+// The pivoted QR of the metabolite rows drops the linearly dependent balances,
+// then the pivoted QR of the columns chooses B among the fluxes without a basis and not set free.
+// If they don't span S the rest of B is chosen among the fixed and set free fluxes
+// by the pivoted QR of their parts orthogonal to the chosen columns
+Matrix GetNullspaceWithPivotedQR(const Matrix& original_matrix, std::vector<Reaction> &reactions) {
+    const int metabolite_balance_reactions_total = reactions.size() - original_matrix.cols();
+
+    const Eigen::ColPivHouseholderQR<Matrix> rows_decomposition(original_matrix.transpose());
+    const int rank = rows_decomposition.rank();
+    Matrix matrix(rank, original_matrix.cols());
+    for (int row = 0; row < rank; ++row) {
+        matrix.row(row) = original_matrix.row(rows_decomposition.colsPermutation().indices()(row));
+    }
+
+    std::vector<int> candidates;
+    std::vector<int> user_free;
+    for (int column = 0; column < matrix.cols(); ++column) {
+        const Reaction &reaction = reactions[metabolite_balance_reactions_total + column];
+        if (std::isnan(reaction.basis) && !reaction.is_set_free) {
+            candidates.push_back(column);
+        } else {
+            user_free.push_back(column);
+        }
+    }
+
+    std::vector<int> dependent;
+    for (int position : SelectIndependentColumns(GetColumns(matrix, candidates))) {
+        dependent.push_back(candidates[position]);
+    }
+    if (static_cast<int>(dependent.size()) < rank) {
+        const Matrix chosen = GetColumns(matrix, dependent);
+        Matrix orthogonal_parts = GetColumns(matrix, user_free);
+        if (!dependent.empty()) {
+            const Eigen::HouseholderQR<Matrix> decomposition(chosen);
+            const Matrix orthonormal_basis = decomposition.householderQ() * Matrix::Identity(rank, dependent.size());
+            orthogonal_parts -= orthonormal_basis * (orthonormal_basis.transpose() * orthogonal_parts);
+        }
+        for (int position : SelectIndependentColumns(orthogonal_parts)) {
+            if (static_cast<int>(dependent.size()) < rank) {
+                dependent.push_back(user_free[position]);
+            }
+        }
+    }
+    if (static_cast<int>(dependent.size()) < rank) {
+        throw std::runtime_error("Can't choose the dependent fluxes of the stoichiometry matrix");
+    }
+    // a dependent flux keeps only the bounds of the flux balance
+    std::string fixed_dependent;
+    std::string user_free_dependent;
+    for (int column : dependent) {
+        const Reaction &reaction = reactions[metabolite_balance_reactions_total + column];
+        if (std::isnan(reaction.basis) && !reaction.is_set_free) {
+            continue;
+        }
+        if (!std::isnan(reaction.basis) && (std::isnan(reaction.deviation) || reaction.deviation == 0.0)) {
+            fixed_dependent += " " + reaction.name;
+        } else {
+            user_free_dependent += " " + reaction.name;
+        }
+    }
+    if (!fixed_dependent.empty()) {
+        throw std::runtime_error("The fixed fluxes" + fixed_dependent +
+                                 " must be dependent, the other fluxes don't span the stoichiometry matrix");
+    }
+    if (!user_free_dependent.empty()) {
+        std::cout << "Pivoted QR free flux selection: the set free or measured fluxes" << user_free_dependent
+                  << " are dependent, their bounds are dropped" << std::endl;
+    }
+
+    std::vector<bool> is_dependent(matrix.cols(), false);
+    for (int column : dependent) {
+        is_dependent[column] = true;
+    }
+    std::vector<int> order = dependent;
+    for (const std::vector<int> &free_columns : {candidates, user_free}) {
+        for (int column : free_columns) {
+            if (!is_dependent[column]) {
+                order.push_back(column);
+            }
+        }
+    }
+
+    const std::vector<Reaction> unordered_reactions = reactions;
+    for (size_t i = 0; i < order.size(); ++i) {
+        reactions[metabolite_balance_reactions_total + i] =
+            unordered_reactions[metabolite_balance_reactions_total + order[i]];
+    }
+
+    const Matrix ordered_matrix = GetColumns(matrix, order);
+    const Matrix basis = ordered_matrix.leftCols(rank);
+    const Matrix result = basis.partialPivLu().solve(ordered_matrix.rightCols(matrix.cols() - rank));
+
+    std::cout << "Pivoted QR free flux selection: " << original_matrix.rows() - rank
+              << " dependent metabolite balances dropped, " << matrix.cols() - rank << " free fluxes, "
+              << "dependent fluxes basis condition number: " << GetConditionNumber(basis) << std::endl;
     return result;
 }
 
 
+double GetConditionNumber(const Matrix &matrix) {
+    if (matrix.size() == 0) {
+        return 1.0;
+    }
+    const Eigen::VectorXd singular_values = Eigen::BDCSVD<Matrix>(matrix).singularValues();
+    return singular_values(0) / singular_values(singular_values.size() - 1);
+}
+
+
 bool ExchangeRowsToMakePivotNotNull(Matrix &matrix, const int column) {
     double max_pivot = abs(matrix(column, column));
     int max_row = column;
@@ -0,0 +1,223 @@
+#include "modeller/merge_equivalent_emus.h"
+
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#include "utilities/emu.h"
+
+
+namespace khnum {
+namespace modelling_utills {
+namespace {
+// Returns the produced EMUs with the only substrate of all their producing reactions
+std::map<Emu, Emu> FindEquivalentEmus(const std::vector<EmuReaction> &reactions,
+                                      const std::set<Emu> &kept_emus) {
+    std::map<Emu, Emu> single_substrate;
+    std::set<Emu> not_equivalent;
+    for (const EmuReaction &reaction : reactions) {
+        const Emu &product = reaction.right.emu;
+        if (reaction.left.size() == 1 && reaction.left[0].emu == product) {
+            continue;
+        }
+        if (reaction.left.size() != 1) {
+            not_equivalent.insert(product);
+            continue;
+        }
+
+        auto substrate = single_substrate.find(product);
+        if (substrate == single_substrate.end()) {
+            single_substrate.emplace(product, reaction.left[0].emu);
+        } else if (!(substrate->second == reaction.left[0].emu)) {
+            not_equivalent.insert(product);
+        }
+    }
+
+    std::map<Emu, Emu> equivalent_emus;
+    for (const auto &[product, substrate] : single_substrate) {
+        if (!not_equivalent.count(product) && !kept_emus.count(product)) {
+            equivalent_emus.emplace(product, substrate);
+        }
+    }
+    return equivalent_emus;
+}
+
+
+// Replaces the chains E -> F -> G with E -> G, F -> G
+void ResolveChains(std::map<Emu, Emu> &equivalent_emus) {
+    std::vector<Emu> products;
+    for (const auto &equivalence : equivalent_emus) {
+        products.push_back(equivalence.first);
+    }
+
+    for (const Emu &product : products) {
+        Emu root = equivalent_emus.at(product);
+        size_t steps = 0;
+        auto next = equivalent_emus.find(root);
+        while (next != equivalent_emus.end() && steps <= equivalent_emus.size()) {
+            root = next->second;
+            next = equivalent_emus.find(root);
+            ++steps;
+        }
+        if (steps > equivalent_emus.size()) {
+            // a cycle without any inflow, its EMUs are kept
+            equivalent_emus.erase(product);
+            continue;
+        }
+        equivalent_emus.at(product) = root;
+    }
+}
+
+
+// Tarjan's search of the strongly connected components of the single substrate reactions,
+// which are the network components CreateNetworkComponents builds
+class ComponentSearch {
+public:
+    ComponentSearch(std::vector<std::vector<size_t>> successors, std::vector<bool> is_unknown) :
+        successors_{std::move(successors)},
+        is_unknown_{std::move(is_unknown)},
+        order_(successors_.size(), -1),
+        lowlink_(successors_.size(), 0),
+        is_on_stack_(successors_.size(), false) {}
+
+    // Returns the largest number of unknown EMUs of a component
+    size_t GetLargestComponent() {
+        for (size_t emu = 0; emu < successors_.size(); ++emu) {
+            if (order_[emu] < 0) {
+                Visit(emu);
+            }
+        }
+        return largest_component_;
+    }
+
+private:
+    void Visit(size_t emu) {
+        order_[emu] = lowlink_[emu] = next_order_++;
+        stack_.push_back(emu);
+        is_on_stack_[emu] = true;
+        for (size_t successor : successors_[emu]) {
+            if (order_[successor] < 0) {
+                Visit(successor);
+                lowlink_[emu] = std::min(lowlink_[emu], lowlink_[successor]);
+            } else if (is_on_stack_[successor]) {
+                lowlink_[emu] = std::min(lowlink_[emu], order_[successor]);
+            }
+        }
+        if (lowlink_[emu] != order_[emu]) {
+            return;
+        }
+        size_t unknowns = 0;
+        size_t member;
+        do {
+            member = stack_.back();
+            stack_.pop_back();
+            is_on_stack_[member] = false;
+            unknowns += is_unknown_[member];
+        } while (member != emu);
+        largest_component_ = std::max(largest_component_, unknowns);
+    }
+
+    std::vector<std::vector<size_t>> successors_;
+    std::vector<bool> is_unknown_;
+    std::vector<int> order_;
+    std::vector<int> lowlink_;
+    std::vector<bool> is_on_stack_;
+    std::vector<size_t> stack_;
+    int next_order_ = 0;
+    size_t largest_component_ = 0;
+};
+} // namespace
+
+
+std::vector<EmuReaction> MergeEquivalentEmus(const std::vector<EmuReaction> &reactions,
+                                             const std::vector<Emu> &measured_isotopes,
+                                             const std::vector<Emu> &input_emu_list) {
+    std::set<Emu> kept_emus(measured_isotopes.begin(), measured_isotopes.end());
+    kept_emus.insert(input_emu_list.begin(), input_emu_list.end());
+
+    std::vector<EmuReaction> merged_reactions = reactions;
+    // merging may make the other EMUs equivalent, e.g. if E is produced from F and G and F is equivalent to G
+    while (true) {
+        std::map<Emu, Emu> equivalent_emus = FindEquivalentEmus(merged_reactions, kept_emus);
+        if (equivalent_emus.empty()) {
+            break;
+        }
+        ResolveChains(equivalent_emus);
+
+        std::vector<EmuReaction> new_reactions;
+        for (EmuReaction &reaction : merged_reactions) {
+            if (equivalent_emus.count(reaction.right.emu)) {
+                continue;
+            }
+            for (EmuSubstrate &substrate : reaction.left) {
+                auto equivalence = equivalent_emus.find(substrate.emu);
+                if (equivalence != equivalent_emus.end()) {
+                    substrate.emu = equivalence->second;
+                }
+            }
+            new_reactions.push_back(std::move(reaction));
+        }
+        merged_reactions = std::move(new_reactions);
+    }
+
+    return merged_reactions;
+}
+
+
+size_t GetUnknownEmusCount(const std::vector<EmuReaction> &reactions) {
+    std::set<Emu> unknown_emus;
+    for (const EmuReaction &reaction : reactions) {
+        unknown_emus.insert(reaction.right.emu);
+    }
+    return unknown_emus.size();
+}
+
+
+size_t GetLargestNetworkSize(const std::vector<EmuReaction> &reactions, const std::vector<Emu> &input_emu_list) {
+    const std::set<Emu> input_emus(input_emu_list.begin(), input_emu_list.end());
+    std::map<Emu, size_t> positions;
+    const auto get_position = [&positions](const Emu &emu) {
+        return positions.emplace(emu, positions.size()).first->second;
+    };
+    std::vector<std::pair<size_t, size_t>> edges;
+    std::set<size_t> unknown_emus;
+    for (const EmuReaction &reaction : reactions) {
+        // the input EMUs are known
+        if (input_emus.count(reaction.right.emu)) {
+            continue;
+        }
+        const size_t product = get_position(reaction.right.emu);
+        unknown_emus.insert(product);
+        if (reaction.left.size() == 1) {
+            edges.emplace_back(get_position(reaction.left[0].emu), product);
+        }
+    }
+
+    std::vector<std::vector<size_t>> successors(positions.size());
+    for (const auto &[substrate, product] : edges) {
+        successors[substrate].push_back(product);
+    }
+    std::vector<bool> is_unknown(positions.size(), false);
+    for (size_t emu : unknown_emus) {
+        is_unknown[emu] = true;
+    }
+    return ComponentSearch(std::move(successors), std::move(is_unknown)).GetLargestComponent();
+}
+
+
+std::pair<size_t, size_t> GetNetworksSize(const std::vector<EmuNetwork> &networks) {
+    size_t total_unknowns = 0;
+    size_t largest_network = 0;
+    for (const EmuNetwork &network : networks) {
+        std::set<Emu> unknown_emus;
+        for (const EmuReaction &reaction : network) {
+            unknown_emus.insert(reaction.right.emu);
+        }
+        total_unknowns += unknown_emus.size();
+        largest_network = std::max(largest_network, unknown_emus.size());
+    }
+    return {total_unknowns, largest_network};
+}
+} // namespace modelling_utills
+} // namespace khnum
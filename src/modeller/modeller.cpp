@@ -14,7 +14,9 @@
 #include "modeller/create_stoichiometry_matrix.h"
 #include "modeller/create_nullspace.h"
 #include "modeller/calculate_flux_bounds.h"
+#include "modeller/presolve_constraints.h"
 #include "modeller/check_model.h"
+#include "modeller/merge_equivalent_emus.h"
 
 #include "utilities/debug_utills/debug_prints.h"
 
@@ -36,13 +38,30 @@ void Modeller::CalculateInputSubstrateMids() {
 
 
 void Modeller::CreateEmuNetworks() {
-    std::vector<EmuNetwork> networks = modelling_utills::CreateEmuNetworks(all_emu_reactions_, input_emu_list_, measured_isotopes_);
+    const std::vector<EmuReaction> merged_emu_reactions =
+        modelling_utills::MergeEquivalentEmus(all_emu_reactions_, measured_isotopes_, input_emu_list_);
+
+    // the unmerged networks aren't built, only their EMUs are counted
+    const size_t unknowns_before = modelling_utills::GetUnknownEmusCount(all_emu_reactions_);
+    const size_t largest_network_before = modelling_utills::GetLargestNetworkSize(all_emu_reactions_, input_emu_list_);
+    emu_networks_ = CreateNetworkComponents(merged_emu_reactions);
+    const auto [unknowns_after, largest_network_after] = modelling_utills::GetNetworksSize(emu_networks_);
+
+    std::cout << "EMU merging: " << unknowns_before << " -> " << unknowns_after << " unknown EMUs, "
+              << "the largest network " << largest_network_before << " -> " << largest_network_after << std::endl;
+}
+
+
+std::vector<EmuNetwork> Modeller::CreateNetworkComponents(const std::vector<EmuReaction> &emu_reactions) const {
+    std::vector<EmuNetwork> all_components;
+    std::vector<EmuNetwork> networks = modelling_utills::CreateEmuNetworks(emu_reactions, input_emu_list_, measured_isotopes_);
     for (EmuNetwork &network : networks) {
         std::vector<EmuNetwork> components = modelling_utills::CreateNetworkComponents(network);
         for (const EmuNetwork &component : components) {
-            emu_networks_.push_back(component);
+            all_components.push_back(component);
         }
     }
+    return all_components;
 }
 
 
@@ -56,17 +75,33 @@ void Modeller::CalculateFluxBounds() {
         lower_bounds_[i] = reactions_[reactions_.size() - nullity + i].computed_lower_bound;
         upper_bounds_[i] = reactions_[reactions_.size() - nullity + i].computed_upper_bound;
     }
+    constraints_.matrix = nullspace_;
+    constraints_.right_part = Eigen::VectorXd::Zero(nullspace_.rows());
 }
 
 
-void Modeller::CreateNullspaceMatrix() {
+void Modeller::PresolveConstraints() {
+    const std::vector<double> lower_bounds_before = lower_bounds_;
+    const std::vector<double> upper_bounds_before = upper_bounds_;
+    constraints_ = modelling_utills::PresolveConstraints(nullspace_, lower_bounds_, upper_bounds_);
+
+    size_t tightened_bounds = 0;
+    for (size_t i = 0; i < lower_bounds_.size(); ++i) {
+        tightened_bounds += (lower_bounds_[i] != lower_bounds_before[i]) + (upper_bounds_[i] != upper_bounds_before[i]);
+    }
+    std::cout << "Constraints presolve: " << nullspace_.rows() << " -> " << constraints_.matrix.rows()
+              << " inequalities, " << tightened_bounds << " bounds tightened" << std::endl;
+}
+
+
+void Modeller::CreateNullspaceMatrix(modelling_utills::FreeFluxSelection selection) {
     std::vector<std::string> full_metabolite_list = modelling_utills::CreateFullMetaboliteList(reactions_);
     std::vector<std::string> included_metabolites = modelling_utills::CreateIncludedMetaboliteList(full_metabolite_list,
                                                                                  excluded_metabolites_);
 
     stoichiometry_matrix_ = modelling_utills::CreateStoichiometryMatrix(reactions_, included_metabolites);
 
-    nullspace_ = modelling_utills::GetNullspace(stoichiometry_matrix_, reactions_);
+    nullspace_ = modelling_utills::GetNullspace(stoichiometry_matrix_, reactions_, selection);
     id_to_position_in_depended_fluxes_.resize(reactions_.size());
     const size_t isotopomer_balance_reactions_total = reactions_.size() - nullspace_.rows() - nullspace_.cols();
     for (size_t i = 0; i < reactions_.size(); ++i) {
@@ -108,6 +143,13 @@ Problem Modeller::GetProblem() {
     problem.measurements_count = measurements_count_;
     problem.lower_bounds = lower_bounds_;
     problem.upper_bounds = upper_bounds_;
+    problem.constraints = constraints_;
+    const int nullity = nullspace_.cols();
+    for (int i = 0; i < nullity; ++i) {
+        if (reactions_[reactions_.size() - nullity + i].type == ReactionType::Backward) {
+            problem.exchange_fluxes.push_back(i);
+        }
+    }
     problem.reactions_total = reactions_.size();
 
     GeneratorParameters& simulator_parameters = problem.simulator_parameters_;
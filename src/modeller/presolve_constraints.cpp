@@ -0,0 +1,192 @@
+#include "modeller/presolve_constraints.h"
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <glpk/glpk.h>
+
+
+namespace khnum {
+namespace modelling_utills {
+namespace {
+const double tolerance = 1.e-9;
+
+// lower <= x <= upper, constraints * x <= right_part
+glp_prob *CreateLinearProblem(const Matrix &constraints, const Eigen::VectorXd &right_part,
+                              const std::vector<double> &lower_bounds, const std::vector<double> &upper_bounds) {
+    glp_prob *linear_problem = glp_create_prob();
+    glp_add_cols(linear_problem, constraints.cols());
+    for (int col = 0; col < constraints.cols(); ++col) {
+        glp_set_col_bnds(linear_problem, col + 1, lower_bounds[col] == upper_bounds[col] ? GLP_FX : GLP_DB,
+                         lower_bounds[col], upper_bounds[col]);
+    }
+    if (constraints.rows() == 0) {
+        return linear_problem;
+    }
+
+    glp_add_rows(linear_problem, constraints.rows());
+    std::vector<int> row_index = {0};
+    std::vector<int> col_index = {0};
+    std::vector<double> coefficients = {0.0};
+    for (int row = 0; row < constraints.rows(); ++row) {
+        glp_set_row_bnds(linear_problem, row + 1, GLP_UP, 0.0, right_part(row));
+        for (int col = 0; col < constraints.cols(); ++col) {
+            if (constraints(row, col) != 0.0) {
+                row_index.push_back(row + 1);
+                col_index.push_back(col + 1);
+                coefficients.push_back(constraints(row, col));
+            }
+        }
+    }
+    glp_load_matrix(linear_problem, coefficients.size() - 1, row_index.data(), col_index.data(),
+                    coefficients.data());
+    return linear_problem;
+}
+
+// Minimizes or maximizes objective * x, returns false if the problem has no optimum
+bool Optimize(glp_prob *linear_problem, const Eigen::VectorXd &objective, int direction, double &optimum) {
+    for (int col = 0; col < objective.size(); ++col) {
+        glp_set_obj_coef(linear_problem, col + 1, objective(col));
+    }
+    glp_set_obj_dir(linear_problem, direction);
+    const bool is_solved = glp_simplex(linear_problem, NULL) == 0 && glp_get_status(linear_problem) == GLP_OPT;
+    optimum = glp_get_obj_val(linear_problem);
+    return is_solved;
+}
+} // namespace
+
+
+LinearConstraints PresolveConstraints(const Matrix &nullspace,
+                                      std::vector<double> &lower_bounds,
+                                      std::vector<double> &upper_bounds) {
+    const int nullity = nullspace.cols();
+    Matrix constraints = nullspace;
+    Eigen::VectorXd right_part = Eigen::VectorXd::Zero(nullspace.rows());
+    if (nullity == 0) {
+        return {Matrix(0, 0), Eigen::VectorXd()};
+    }
+
+    // the bounds become the extreme values of the feasible fluxes,
+    // the constraints implied by them are removed below
+    glp_term_out(GLP_OFF);
+    glp_prob *linear_problem = CreateLinearProblem(constraints, right_part, lower_bounds, upper_bounds);
+    for (int col = 0; col < nullity; ++col) {
+        if (lower_bounds[col] == upper_bounds[col]) {
+            continue;
+        }
+        double lowest = 0.0;
+        double highest = 0.0;
+        const Eigen::VectorXd objective = Eigen::VectorXd::Unit(nullity, col);
+        if (!Optimize(linear_problem, objective, GLP_MIN, lowest) ||
+            !Optimize(linear_problem, objective, GLP_MAX, highest)) {
+            glp_delete_prob(linear_problem);
+            throw std::runtime_error("The free flux bounds and the constraints have no feasible point");
+        }
+        lower_bounds[col] = std::max(lower_bounds[col], lowest);
+        upper_bounds[col] = std::min(upper_bounds[col], highest);
+        if (upper_bounds[col] - lower_bounds[col] <= tolerance * (1.0 + std::abs(upper_bounds[col]))) {
+            upper_bounds[col] = lower_bounds[col];
+        }
+    }
+    glp_delete_prob(linear_problem);
+
+    // the fixed fluxes are moved to the right part
+    for (int col = 0; col < nullity; ++col) {
+        if (lower_bounds[col] == upper_bounds[col]) {
+            right_part -= constraints.col(col) * lower_bounds[col];
+            constraints.col(col).setZero();
+        }
+    }
+
+    // the rows implied by the bounds are removed, the rest are normalized
+    // and only the lowest of the parallel rows is kept
+    std::vector<int> kept_rows;
+    for (int row = 0; row < constraints.rows(); ++row) {
+        double highest = 0.0;
+        double scale = 1.0;
+        for (int col = 0; col < nullity; ++col) {
+            const double coefficient = constraints(row, col);
+            highest += std::max(coefficient * lower_bounds[col], coefficient * upper_bounds[col]);
+            scale += std::abs(coefficient) * std::max(std::abs(lower_bounds[col]), std::abs(upper_bounds[col]));
+        }
+        if (highest <= right_part(row) + tolerance * scale) {
+            continue;
+        }
+
+        const double norm = constraints.row(row).norm();
+        if (norm == 0.0) {
+            throw std::runtime_error("The fixed free fluxes violate the constraints");
+        }
+        constraints.row(row) /= norm;
+        right_part(row) /= norm;
+
+        bool is_parallel = false;
+        for (int &kept_row : kept_rows) {
+            if ((constraints.row(kept_row) - constraints.row(row)).norm() <= tolerance) {
+                if (right_part(row) < right_part(kept_row)) {
+                    kept_row = row;
+                }
+                is_parallel = true;
+                break;
+            }
+        }
+        if (!is_parallel) {
+            kept_rows.push_back(row);
+        }
+    }
+
+    LinearConstraints reduced;
+    reduced.matrix.resize(kept_rows.size(), nullity);
+    reduced.right_part.resize(kept_rows.size());
+    for (size_t row = 0; row < kept_rows.size(); ++row) {
+        reduced.matrix.row(row) = constraints.row(kept_rows[row]);
+        reduced.right_part(row) = right_part(kept_rows[row]);
+    }
+
+    // a row is implied by the others if the maximum of its left part subject to them doesn't exceed its right part.
+    // The implied rows are freed one by one, so the remaining rows still define the same set
+    std::vector<int> necessary_rows;
+    linear_problem = CreateLinearProblem(reduced.matrix, reduced.right_part, lower_bounds, upper_bounds);
+    for (int row = 0; row < reduced.matrix.rows(); ++row) {
+        glp_set_row_bnds(linear_problem, row + 1, GLP_FR, 0.0, 0.0);
+        double highest = 0.0;
+        if (Optimize(linear_problem, reduced.matrix.row(row).transpose(), GLP_MAX, highest) &&
+            highest <= reduced.right_part(row) + tolerance * (1.0 + std::abs(reduced.right_part(row)))) {
+            continue;
+        }
+        glp_set_row_bnds(linear_problem, row + 1, GLP_UP, 0.0, reduced.right_part(row));
+        necessary_rows.push_back(row);
+    }
+    glp_delete_prob(linear_problem);
+
+    LinearConstraints result;
+    result.matrix.resize(necessary_rows.size(), nullity);
+    result.right_part.resize(necessary_rows.size());
+    for (size_t row = 0; row < necessary_rows.size(); ++row) {
+        result.matrix.row(row) = reduced.matrix.row(necessary_rows[row]);
+        result.right_part(row) = reduced.right_part(necessary_rows[row]);
+    }
+    return result;
+}
+
+
+std::pair<double, double> GetFeasibleRange(const Eigen::VectorXd &objective,
+                                           const LinearConstraints &constraints,
+                                           const std::vector<double> &lower_bounds,
+                                           const std::vector<double> &upper_bounds) {
+    glp_term_out(GLP_OFF);
+    glp_prob *linear_problem =
+        CreateLinearProblem(constraints.matrix, constraints.right_part, lower_bounds, upper_bounds);
+    double lowest = 0.0;
+    double highest = 0.0;
+    const bool is_solved = Optimize(linear_problem, objective, GLP_MIN, lowest) &&
+                           Optimize(linear_problem, objective, GLP_MAX, highest);
+    glp_delete_prob(linear_problem);
+    if (!is_solved) {
+        throw std::runtime_error("The free flux bounds and the constraints have no feasible point");
+    }
+    return {lowest, highest};
+}
+} // namespace modelling_utills
+} // namespace khnum
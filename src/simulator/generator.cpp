@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cmath>
 #include "simulator/generator.h"
 #include "simulator/generator_utilites.h"
 #include "simulator/simulator.h"
@@ -9,14 +10,19 @@ SimulatorGenerator::SimulatorGenerator(const GeneratorParameters& parameters) {
     parameters_ = parameters;
 
     std::vector<std::vector<int>> usefull_emus(parameters.networks.size());
-    std::vector<NetworkEmu> all_known_emus = InitializeInputEmus(parameters.input_mids);
+    KnownEmus all_known_emus = InitializeInputEmus(parameters.input_mids);
+    std::unordered_map<Emu, int> measured_isotope_positions;
+    for (size_t i = 0; i < parameters.measurements.size(); ++i) {
+        // emplace keeps the first measurement of the emu
+        measured_isotope_positions.emplace(parameters.measurements[i].emu, i);
+    }
     for (size_t network_num = 0; network_num < parameters.networks.size(); ++network_num) {
         GeneratorNetworkData network_data;
         const std::vector<EmuReaction>& reactions = parameters.networks[network_num];
 
         generator_utilites::FillEmuLists(reactions, all_known_emus, network_data, usefull_emus);
         generator_utilites::CreateSymbolicMatrices(reactions, network_data);
-        generator_utilites::FillFinalEmu(parameters.measurements, network_data);
+        generator_utilites::FillFinalEmu(parameters.measurements, measured_isotope_positions, network_data);
         generator_utilites::InsertIntoAllKnownEmus(network_data.unknown_emus, network_num, all_known_emus);
 
         int network_size = generator_utilites::FindNetworkSize(reactions);
@@ -28,14 +34,99 @@ SimulatorGenerator::SimulatorGenerator(const GeneratorParameters& parameters) {
             simulator_network_data_[network_num].usefull_emus.push_back(position);
         }
     }
+
+    FindInfluencingFluxes();
 }
 
 Simulator SimulatorGenerator::Generate() const {
     return Simulator(simulator_network_data_, parameters_.input_mids, parameters_.measured_isotopes.size());
 }
 
-std::vector<NetworkEmu> SimulatorGenerator::InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const {
-    std::vector<NetworkEmu> all_known_emus;
+std::vector<NetworkSystemSize> SimulatorGenerator::GetSystemSizes() const {
+    std::vector<NetworkSystemSize> sizes;
+    for (const SimulatorNetworkData &network : simulator_network_data_) {
+        sizes.push_back({network.A_rows, network.B_cols, network.symbolic_A.size(), network.symbolic_B.size()});
+    }
+    return sizes;
+}
+
+std::vector<std::vector<size_t>> SimulatorGenerator::GetInfluencingFluxes() const {
+    std::vector<std::vector<size_t>> influencing_fluxes;
+    for (const SimulatorNetworkData &network : simulator_network_data_) {
+        influencing_fluxes.push_back(network.influencing_fluxes);
+    }
+    return influencing_fluxes;
+}
+
+// The free flux influences the network if it changes the network's A or B matrices
+// or influences one of the networks the known emus come from.
+// Networks are sorted so all the known emus come from the previous networks
+void SimulatorGenerator::FindInfluencingFluxes() {
+    const double epsilon = 1.e-12;
+    const size_t total_free_fluxes = parameters_.free_fluxes_id.size();
+    std::vector<std::vector<char>> is_influenced(simulator_network_data_.size(),
+                                                 std::vector<char>(total_free_fluxes, false));
+    size_t total_skipped = 0;
+    for (size_t network_num = 0; network_num < simulator_network_data_.size(); ++network_num) {
+        SimulatorNetworkData &network = simulator_network_data_[network_num];
+        std::vector<char> &influenced = is_influenced[network_num];
+
+        for (size_t flux = 0; flux < total_free_fluxes; ++flux) {
+            const DerivativeData &derivatives = network.derivatives[flux];
+            if (network.size == NetworkSize::small) {
+                influenced[flux] = (derivatives.dA_small.size() > 0 && derivatives.dA_small.cwiseAbs().maxCoeff() > epsilon) ||
+                                   (derivatives.dB_small.size() > 0 && derivatives.dB_small.cwiseAbs().maxCoeff() > epsilon);
+            } else {
+                for (const SparseMatrix *matrix : {&derivatives.dA_big, &derivatives.dB_big}) {
+                    for (int k = 0; k < matrix->outerSize() && !influenced[flux]; ++k) {
+                        for (SparseMatrix::InnerIterator it(*matrix, k); it; ++it) {
+                            if (std::abs(it.value()) > epsilon) {
+                                influenced[flux] = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<int> upstream_networks;
+        for (const PositionOfSavedEmu &known_emu : network.Y_data) {
+            upstream_networks.push_back(known_emu.network);
+        }
+        for (const Convolution &convolution : network.convolutions) {
+            for (const PositionOfSavedEmu &element : convolution.elements) {
+                upstream_networks.push_back(element.network);
+            }
+        }
+        for (int upstream : upstream_networks) {
+            if (upstream == -1) {
+                continue;
+            }
+            for (size_t flux = 0; flux < total_free_fluxes; ++flux) {
+                if (is_influenced[upstream][flux]) {
+                    influenced[flux] = true;
+                }
+            }
+        }
+
+        network.influencing_fluxes.clear();
+        for (size_t flux = 0; flux < total_free_fluxes; ++flux) {
+            if (influenced[flux]) {
+                network.influencing_fluxes.push_back(flux);
+            } else {
+                ++total_skipped;
+            }
+        }
+    }
+
+    std::cout << "Jacobian sparsity: " << total_skipped << " of "
+              << simulator_network_data_.size() * total_free_fluxes
+              << " network sensitivities are structurally zero" << std::endl;
+}
+
+KnownEmus SimulatorGenerator::InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const {
+    KnownEmus all_known_emus;
     for (size_t i = 0; i < input_mids.size(); ++i) {
         NetworkEmu input_emu;
         input_emu.emu = input_mids[i].emu;
@@ -43,7 +134,7 @@ std::vector<NetworkEmu> SimulatorGenerator::InitializeInputEmus(const std::vecto
         input_emu.order_in_usefull_emus = i;
         input_emu.order_in_X = i;
         input_emu.is_usefull = true;
-        all_known_emus.push_back(input_emu);
+        all_known_emus.emplace(input_mids[i].emu, input_emu);
     }
 
     return all_known_emus;
@@ -2,7 +2,7 @@
 
 #include <vector>
 #include <algorithm>
-#include <set>
+#include <unordered_set>
 #include <unordered_map>
 #include <iostream>
 
@@ -15,11 +15,26 @@
 namespace khnum {
 namespace generator_utilites {
 
+namespace {
+struct ConvolutionHash {
+    size_t operator()(const Convolution &convolution) const {
+        size_t result = std::hash<int>()(convolution.flux_id);
+        for (const PositionOfSavedEmu &element : convolution.elements) {
+            result = result * 31 + std::hash<int>()(element.network);
+            result = result * 31 + std::hash<int>()(element.position);
+        }
+        return result;
+    }
+};
+} // namespace
+
+
 void FillEmuLists(const std::vector<EmuReaction>& reactions,
-                  std::vector<NetworkEmu>& all_known_emus,
+                  KnownEmus& all_known_emus,
                   GeneratorNetworkData& network_data,
                   std::vector<std::vector<int>>& usefull_emus) {
-    std::set<Emu> seen_emus;
+    std::unordered_set<Emu> seen_emus;
+    std::unordered_set<Convolution, ConvolutionHash> seen_convolutions;
     size_t reaction_num = 0;
     for (const EmuReaction &reaction : reactions) {
         if (reaction.left.size() == 1) {
@@ -31,8 +46,7 @@ void FillEmuLists(const std::vector<EmuReaction>& reactions,
             Convolution convolution = ConvolveReaction(reaction, all_known_emus, usefull_emus);
 
             std::vector<Convolution>& convolutions = network_data.convolutions;
-            auto already_has = std::find(convolutions.begin(), convolutions.end(), convolution);
-            if (already_has == convolutions.end()) {
+            if (seen_convolutions.insert(convolution).second) {
                 convolutions.push_back(convolution);
             } else {
                 throw std::runtime_error("wtf");
@@ -41,6 +55,7 @@ void FillEmuLists(const std::vector<EmuReaction>& reactions,
         }
 
         if (seen_emus.find(reaction.right.emu) == seen_emus.end()) {
+            network_data.unknown_emu_positions[reaction.right.emu] = network_data.unknown_emus.size();
             network_data.unknown_emus.push_back(reaction.right.emu);
             seen_emus.insert(reaction.right.emu);
         }
@@ -50,50 +65,45 @@ void FillEmuLists(const std::vector<EmuReaction>& reactions,
 
 
 void CheckAndInsertEmu(const Emu &emu,
-                       std::vector<NetworkEmu>& all_known_emus,
+                       KnownEmus& all_known_emus,
                        GeneratorNetworkData& network_data,
                        std::vector<std::vector<int>>& usefull_emus) {
-    auto it = std::find_if(all_known_emus.begin(),
-                           all_known_emus.end(),
-                           [&emu](const NetworkEmu& known_emu) {
-                               return known_emu.emu == emu;
-                           });
+    auto it = all_known_emus.find(emu);
 
     if (it != all_known_emus.end()) {
-        if (!it->is_usefull) {
-            it->is_usefull = true;
-            usefull_emus[it->network].push_back(it->order_in_X);
-            it->order_in_usefull_emus = usefull_emus[it->network].size() - 1;
+        NetworkEmu &known_emu = it->second;
+        if (!known_emu.is_usefull) {
+            known_emu.is_usefull = true;
+            usefull_emus[known_emu.network].push_back(known_emu.order_in_X);
+            known_emu.order_in_usefull_emus = usefull_emus[known_emu.network].size() - 1;
         }
-        network_data.known_emus.push_back(it->emu);
-        network_data.Y_data.push_back({it->network, it->order_in_usefull_emus});
+        network_data.known_emu_positions[emu] = network_data.known_emus.size();
+        network_data.known_emus.push_back(known_emu.emu);
+        network_data.Y_data.push_back({known_emu.network, known_emu.order_in_usefull_emus});
     } else {
+        network_data.unknown_emu_positions[emu] = network_data.unknown_emus.size();
         network_data.unknown_emus.push_back(emu);
     }
 }
 
 
 Convolution ConvolveReaction(const EmuReaction& reaction,
-                             std::vector<NetworkEmu>& all_known_emus,
+                             KnownEmus& all_known_emus,
                              std::vector<std::vector<int>>& usefull_emus) {
     Convolution convolution;
     convolution.flux_id = reaction.id;
     for (const EmuSubstrate& emu : reaction.left) {
-        auto it = std::find_if(all_known_emus.begin(),
-                               all_known_emus.end(),
-                               [&emu](const NetworkEmu& known_emu) {
-                                   return known_emu.emu == emu.emu;
-                               });
-
-        if (!it->is_usefull) {
-            it->is_usefull = true;
-            usefull_emus[it->network].push_back(it->order_in_X);
-            it->order_in_usefull_emus = usefull_emus[it->network].size() - 1;
+        NetworkEmu &known_emu = all_known_emus.at(emu.emu);
+
+        if (!known_emu.is_usefull) {
+            known_emu.is_usefull = true;
+            usefull_emus[known_emu.network].push_back(known_emu.order_in_X);
+            known_emu.order_in_usefull_emus = usefull_emus[known_emu.network].size() - 1;
         }
 
         PositionOfSavedEmu new_known_emu;
-        new_known_emu.network = it->network;
-        new_known_emu.position = it->order_in_usefull_emus;
+        new_known_emu.network = known_emu.network;
+        new_known_emu.position = known_emu.order_in_usefull_emus;
         convolution.elements.emplace_back(new_known_emu);
     }
 
@@ -103,123 +113,87 @@ Convolution ConvolveReaction(const EmuReaction& reaction,
 
 void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
                             GeneratorNetworkData& network_data) {
-    const std::vector<Emu>& unknown_emus = network_data.unknown_emus;
-    const std::vector<Emu> known_emus = network_data.known_emus;
-    const std::vector<Convolution> convolutions = network_data.convolutions;
+    const size_t unknown_size = network_data.unknown_emus.size();
+    const size_t known_size = network_data.known_emus.size() + network_data.convolutions.size();
 
-    const int unknown_size = unknown_emus.size();
-    const int known_size = known_emus.size() + convolutions.size();
-
-    // A[unknown_size][unknown_size]
-    std::vector<std::vector<FluxCombination>> A(unknown_size, std::vector<FluxCombination>(unknown_size));
-
-    // B[unknown_size][known_size]
-    std::vector<std::vector<FluxCombination>> B(unknown_size, std::vector<FluxCombination>(known_size));
+    // position of the (i, j) element in the sparse matrix by i * cols + j
+    std::unordered_map<size_t, size_t> A_positions;
+    std::unordered_map<size_t, size_t> B_positions;
+    std::vector<FluxCombination>& A = network_data.symbolic_A;
+    std::vector<FluxCombination>& B = network_data.symbolic_B;
 
     size_t reaction_num = 0;
     for (const EmuReaction &reaction : reactions) {
-        size_t position_of_product = FindUnknownEmuPosition(reaction.right.emu, unknown_emus);
+        const size_t position_of_product = network_data.unknown_emu_positions.at(reaction.right.emu);
 
         FluxAndCoefficient substrate_element;
         substrate_element.coefficient = -reaction.rate;
         substrate_element.id = reaction.id;
-        A[position_of_product][position_of_product].fluxes.emplace_back(substrate_element);
+        AddToSparseMatrix(position_of_product, position_of_product, substrate_element, A_positions, unknown_size, A);
 
         if (reaction.left.size() > 1) {
-            int position_of_convolution = network_data.reaction_to_convolution.at(reaction_num);
+            const size_t position_of_convolution = network_data.reaction_to_convolution.at(reaction_num);
             FluxAndCoefficient convolution_element;
             convolution_element.coefficient = -reaction.rate;
             convolution_element.id = reaction.id;
-            B[position_of_product][known_emus.size() + position_of_convolution].fluxes.emplace_back(convolution_element);
+            AddToSparseMatrix(position_of_product, network_data.known_emus.size() + position_of_convolution,
+                              convolution_element, B_positions, known_size, B);
 
         } else {
-            EmuSubstrate substrate = reaction.left[0];
+            const EmuSubstrate &substrate = reaction.left[0];
 
-            // returns -1 if emu is unknown
-            int position_of_substrate = FindKnownEmuPosition(substrate.emu, known_emus);
-            if (position_of_substrate == -1) {
-                position_of_substrate = FindUnknownEmuPosition(substrate.emu, unknown_emus);
+            auto known_position = network_data.known_emu_positions.find(substrate.emu);
+            if (known_position == network_data.known_emu_positions.end()) {
+                const size_t position_of_substrate = network_data.unknown_emu_positions.at(substrate.emu);
                 FluxAndCoefficient product;
                 product.coefficient = reaction.rate;
                 product.id = reaction.id;
-                A[position_of_product][position_of_substrate].fluxes.emplace_back(product);
+                AddToSparseMatrix(position_of_product, position_of_substrate, product, A_positions, unknown_size, A);
             } else {
                 FluxAndCoefficient substrate_element;
                 substrate_element.coefficient = -reaction.rate;
                 substrate_element.id = reaction.id;
-                B[position_of_product][position_of_substrate].fluxes.emplace_back(substrate_element);
+                AddToSparseMatrix(position_of_product, known_position->second, substrate_element,
+                                  B_positions, known_size, B);
             }
         }
         ++reaction_num;
     }
 
-    ConvertToSparseMatrix(A, network_data.symbolic_A);
-    ConvertToSparseMatrix(B, network_data.symbolic_B);
+    std::sort(A.begin(), A.end(), compare);
+    std::sort(B.begin(), B.end(), compare);
 }
 
 
-
-int FindUnknownEmuPosition(const Emu &emu,
-                           const std::vector<Emu>& unknown_emus) {
-    auto position = find(unknown_emus.begin(),
-                         unknown_emus.end(),
-                         emu);
-    if (position != unknown_emus.end()) {
-        return position - unknown_emus.begin();
-    } else {
-        return -1;
-    }
-}
-
-
-int FindKnownEmuPosition(const Emu &emu,
-                         const std::vector<Emu>& known_emus) {
-    auto position = find_if(known_emus.begin(),
-                            known_emus.end(),
-                            [&emu](const Emu &known_emu) {
-                                return known_emu == emu;
-                            });
-
-    if (position != known_emus.end()) {
-        return position - known_emus.begin();
-    } else {
-        return -1;
-    }
-}
-
-void ConvertToSparseMatrix(const std::vector<std::vector<FluxCombination>>& dense_matrix,
-                           std::vector<FluxCombination>& sparse_matrix) {
-    for (size_t i = 0; i < dense_matrix.size(); ++i) {
-        for (size_t j = 0; j < dense_matrix[0].size(); ++j) {
-            if (!dense_matrix[i][j].fluxes.empty()) {
-                FluxCombination matrix_element = dense_matrix[i][j];
-                matrix_element.i = i;
-                matrix_element.j = j;
-                sparse_matrix.emplace_back(matrix_element);
-            } else {
-            }
-        }
+void AddToSparseMatrix(size_t i, size_t j, const FluxAndCoefficient &flux,
+                       std::unordered_map<size_t, size_t> &positions,
+                       size_t cols,
+                       std::vector<FluxCombination>& sparse_matrix) {
+    auto [position, is_new] = positions.emplace(i * cols + j, sparse_matrix.size());
+    if (is_new) {
+        FluxCombination matrix_element;
+        matrix_element.i = i;
+        matrix_element.j = j;
+        sparse_matrix.emplace_back(matrix_element);
     }
+    sparse_matrix[position->second].fluxes.emplace_back(flux);
 }
 
 
 void FillFinalEmu(const std::vector<Measurement>& measured_isotopes,
+                  const std::unordered_map<Emu, int>& measured_isotope_positions,
                   GeneratorNetworkData& network_data) {
     const std::vector<Emu>& unknown_emus = network_data.unknown_emus;
     for (size_t i = 0; i < unknown_emus.size(); ++i) {
-        Emu emu = unknown_emus[i];
-        auto it = std::find_if(measured_isotopes.begin(),
-                               measured_isotopes.end(),
-                               [&emu](const Measurement& measured_emu) {
-                                   return measured_emu.emu == emu;
-                               });
-
-        if (it != measured_isotopes.end()) {
+        const Emu &emu = unknown_emus[i];
+        auto it = measured_isotope_positions.find(emu);
+
+        if (it != measured_isotope_positions.end()) {
             FinalEmu final_emu;
             final_emu.emu = emu;
             final_emu.order_in_X = i;
-            final_emu.position_in_result = it - measured_isotopes.begin();
-            final_emu.correction_matrix = it->correction_matrix;
+            final_emu.position_in_result = it->second;
+            final_emu.correction_matrix = measured_isotopes[it->second].correction_matrix;
             network_data.final_emus.push_back(final_emu);
         }
     }
@@ -227,14 +201,14 @@ void FillFinalEmu(const std::vector<Measurement>& measured_isotopes,
 
 void InsertIntoAllKnownEmus(const std::vector<Emu>& unknown_emus,
                             int network_num,
-                            std::vector<NetworkEmu>& all_known_emus) {
+                            KnownEmus& all_known_emus) {
     for (size_t i = 0; i < unknown_emus.size(); ++i) {
         NetworkEmu new_emu;
         new_emu.order_in_X = i;
         new_emu.emu = unknown_emus[i];
         new_emu.is_usefull = false;
         new_emu.network = network_num;
-        all_known_emus.push_back(new_emu);
+        all_known_emus.emplace(unknown_emus[i], new_emu);
     }
 }
 
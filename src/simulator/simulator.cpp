@@ -11,47 +11,109 @@ namespace khnum {
 
 
 SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool calculate_jacobian) {
+    Simulate(fluxes, calculate_jacobian);
+
     SimulatorResult result;
-    std::vector<double> sums(total_mids_to_simulate_);
-    std::vector<EmuAndMid>& simulated_mids = result.simulated_mids;
-    simulated_mids.resize(total_mids_to_simulate_);
-
-    std::vector<std::vector<EmuAndMid>>& diff_results = result.diff_results;
-    diff_results.resize(total_free_fluxes_);
-    for (std::vector<EmuAndMid>& vec : diff_results) {
-        vec.resize(total_mids_to_simulate_);
+    result.simulated_mids = simulated_mids_;
+    if (calculate_jacobian) {
+        result.diff_results = diff_results_;
+    }
+    return result;
+}
+
+
+void Simulator::SetMeasurements(const std::vector<Measurement> &measurements) {
+    residual_offsets_.clear();
+    std::vector<double> measured_values;
+    std::vector<double> inverse_errors;
+    for (const Measurement &measurement : measurements) {
+        residual_offsets_.push_back(measured_values.size());
+        for (size_t mass_shift = 0; mass_shift < measurement.errors.size(); ++mass_shift) {
+            measured_values.push_back(measurement.mid[mass_shift]);
+            inverse_errors.push_back(1.0 / measurement.errors[mass_shift]);
+        }
     }
+    measured_values_ = Eigen::Map<Eigen::VectorXd>(measured_values.data(), measured_values.size());
+    inverse_errors_ = Eigen::Map<Eigen::VectorXd>(inverse_errors.data(), inverse_errors.size());
+}
 
-    std::vector<std::vector<Mid>> saved_mids(total_networks_);
-    // contains MID's derivative at [free_flux][network][i]
-    std::vector<std::vector<std::vector<Mid>>> saved_diff_mids(total_free_fluxes_);
-    for (auto& vec : saved_diff_mids) {
-        vec.resize(total_networks_);
+
+void Simulator::SetMeasuredValues(const Eigen::VectorXd &measured_values) {
+    measured_values_ = measured_values;
+}
+
+
+void Simulator::CalculateResiduals(const std::vector<Flux> &fluxes, Eigen::Ref<Eigen::VectorXd> residuals,
+                                   JacobianMap *jacobian) {
+    Simulate(fluxes, jacobian != nullptr);
+
+    for (size_t isotope = 0; isotope < residual_offsets_.size(); ++isotope) {
+        const Mid &mid = simulated_mids_[isotope].mid;
+        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
+            const size_t residual = residual_offsets_[isotope] + mass_shift;
+            residuals(residual) = (mid[mass_shift] - measured_values_(residual)) * inverse_errors_(residual);
+        }
+    }
+    if (!jacobian) {
+        return;
     }
+    for (size_t flux = 0; flux < total_free_fluxes_; ++flux) {
+        for (size_t isotope = 0; isotope < residual_offsets_.size(); ++isotope) {
+            const Mid &diff_mid = diff_results_[flux][isotope].mid;
+            for (size_t mass_shift = 0; mass_shift < diff_mid.size(); ++mass_shift) {
+                const size_t residual = residual_offsets_[isotope] + mass_shift;
+                (*jacobian)(residual, flux) = diff_mid[mass_shift] * inverse_errors_(residual);
+            }
+        }
+    }
+}
+
+
+void Simulator::Simulate(const std::vector<Flux> &fluxes, bool calculate_jacobian) {
+    std::vector<double> &sums = sums_;
+    std::vector<EmuAndMid> &simulated_mids = simulated_mids_;
+    std::vector<std::vector<EmuAndMid>> &diff_results = diff_results_;
+    std::vector<std::vector<Mid>> &saved_mids = saved_mids_;
+    std::vector<std::vector<std::vector<Mid>>> &saved_diff_mids = saved_diff_mids_;
     size_t total_big_networks = 0;
     for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
         const SimulatorNetworkData &network = networks_[network_num];
         if (network.size == NetworkSize::small) {
-            Matrix A = Matrix::Zero(network.A_rows, network.A_cols);
+            NetworkState &state = states_[network_num];
+            Matrix &A = state.A_small;
+            A.setZero(network.A_rows, network.A_cols);
             simulator_utilities::FillSmallFluxMatrix(network.symbolic_A, fluxes, A);
 
-            Matrix B = Matrix::Zero(network.B_rows, network.B_cols);
+            Matrix &B = state.B_small;
+            B.setZero(network.B_rows, network.B_cols);
             simulator_utilities::FillSmallFluxMatrix(network.symbolic_B, fluxes, B);
 
-            Matrix Y = Matrix::Zero(network.Y_rows, network.Y_cols);
+            Matrix &Y = state.Y;
+            Y.setZero(network.Y_rows, network.Y_cols);
             simulator_utilities::FillYMatrix(network.Y_data,input_mids_, saved_mids,
                                              network.convolutions, Y);
 
-            const Matrix BY = B * Y;
-            auto A_decomposition = A.householderQr();
-            const Matrix X = A_decomposition.solve(BY);
+            state.BY.noalias() = B * Y;
+            Eigen::HouseholderQR<Matrix> &A_decomposition = state.A_small_decomposition;
+            A_decomposition.compute(A);
+            Matrix &X = state.X;
+            X = A_decomposition.solve(state.BY);
             simulator_utilities::SaveNewEmus(X, network.usefull_emus, network.final_emus, saved_mids[network_num], simulated_mids,
                                              sums);
             if (!calculate_jacobian) {
                 continue;
             }
             Matrix dY = Matrix::Zero(network.Y_rows, network.Y_cols);
+            auto next_influencing_flux = network.influencing_fluxes.begin();
             for (size_t flux = 0; flux < total_free_fluxes_; ++flux) {
+                if (next_influencing_flux == network.influencing_fluxes.end() || *next_influencing_flux != flux) {
+                    // dX is zero by construction
+                    simulator_utilities::SaveZeroDiffEmus(network.Y_cols, network.usefull_emus, network.final_emus,
+                                                          simulated_mids, saved_diff_mids[flux][network_num],
+                                                          diff_results[flux]);
+                    continue;
+                }
+                ++next_influencing_flux;
                 const DerivativeData &derivatives = network.derivatives.at(flux);
 
                 dY.setZero();
@@ -65,17 +127,21 @@ SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool c
                                                      sums, saved_diff_mids[flux][network_num], diff_results[flux]);
             }
         } else {
-            SparseMatrix A(network.A_rows, network.A_cols);
+            NetworkState &state = states_[network_num];
+            SparseMatrix &A = state.A_big;
+            A = SparseMatrix(network.A_rows, network.A_cols);
             std::vector<Triplet> A_triplets;
             simulator_utilities::FillBigFluxMatrix(network.symbolic_A, fluxes, A_triplets);
             A.setFromTriplets(A_triplets.begin(), A_triplets.end());
 
-            SparseMatrix B(network.B_rows, network.B_cols);
+            SparseMatrix &B = state.B_big;
+            B = SparseMatrix(network.B_rows, network.B_cols);
             std::vector<Triplet> B_triplets;
             simulator_utilities::FillBigFluxMatrix(network.symbolic_B, fluxes, B_triplets);
             B.setFromTriplets(B_triplets.begin(), B_triplets.end());
 
-            Matrix Y = Matrix::Zero(network.Y_rows, network.Y_cols);
+            Matrix &Y = state.Y;
+            Y.setZero(network.Y_rows, network.Y_cols);
             simulator_utilities::FillYMatrix(network.Y_data,input_mids_, saved_mids,
                                              network.convolutions, Y);
 
@@ -84,8 +150,11 @@ SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool c
             solver.factorize(A);
             const Matrix guess = Matrix::Constant(network.A_rows, network.Y_cols, 1.0 / network.Y_cols);
 
-            const Matrix X = solver.solveWithGuess(BY, guess);
+            Matrix &X = state.X;
+            X = solver.solveWithGuess(BY, guess);
+            linear_solver_iterations_ += solver.iterations();
             if (solver.info() != Eigen::Success) {
+                ++linear_solver_failures_;
                 std::cout << "NOT SUCCESS " << solver.info() << std::endl;
                 std::cout << solver.error() << std::endl;
                 std::cout << solver.iterations() << std::endl;
@@ -97,7 +166,16 @@ SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool c
                 continue;
             }
             Matrix dY = Matrix::Zero(network.Y_rows, network.Y_cols);
+            auto next_influencing_flux = network.influencing_fluxes.begin();
             for (size_t flux = 0; flux < total_free_fluxes_; ++flux) {
+                if (next_influencing_flux == network.influencing_fluxes.end() || *next_influencing_flux != flux) {
+                    // dX is zero by construction
+                    simulator_utilities::SaveZeroDiffEmus(network.Y_cols, network.usefull_emus, network.final_emus,
+                                                          simulated_mids, saved_diff_mids[flux][network_num],
+                                                          diff_results[flux]);
+                    continue;
+                }
+                ++next_influencing_flux;
                 const DerivativeData &derivatives = network.derivatives.at(flux);
 
                 dY.setZero();
@@ -107,9 +185,11 @@ SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool c
                 // Right Part of A * dX = (...)
                 Matrix RightPart = derivatives.dB_big * Y - derivatives.dA_big * X + B * dY;
                 Matrix dX = solver.solve(RightPart);
+                linear_solver_iterations_ += solver.iterations();
 
 
                 if (solver.info() != Eigen::Success) {
+                    ++linear_solver_failures_;
                     std::cout << "NOT SUCCESS " << solver.info() << std::endl;
                     std::cout << solver.error() << std::endl;
                     std::cout << solver.iterations() << std::endl;
@@ -123,9 +203,90 @@ SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool c
 
 
     }
+
+    last_fluxes_ = fluxes;
+}
+
+
+// Let A * X = B * Y, where A and B linearly depend on the free fluxes, so their second derivatives are zero.
+// Differentiating twice along the direction:
+// A * dX = dB * Y + B * dY - dA * X
+// A * d2X = 2 * dB * dY + B * d2Y - 2 * dA * dX
+DirectionalDerivatives Simulator::CalculateDirectionalDerivatives(const std::vector<Flux> &fluxes,
+                                                                  const std::vector<double> &direction) {
+    if (fluxes != last_fluxes_) {
+        CalculateMids(fluxes, false);
+    }
+
+    DirectionalDerivatives result;
+    result.first_derivative = simulated_mids_;
+    result.second_derivative = simulated_mids_;
+
+    // contains MID's directional derivatives at [network][i]
+    std::vector<std::vector<Mid>> saved_diff_mids(total_networks_);
+    std::vector<std::vector<Mid>> saved_second_diff_mids(total_networks_);
+    size_t total_big_networks = 0;
+    for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        const SimulatorNetworkData &network = networks_[network_num];
+        const NetworkState &state = states_[network_num];
+
+        Matrix dY = Matrix::Zero(network.Y_rows, network.Y_cols);
+        simulator_utilities::FillDiffYMatrix(network.Y_data, saved_diff_mids, network.convolutions,
+                                             input_mids_, saved_mids_, dY);
+        Matrix d2Y = Matrix::Zero(network.Y_rows, network.Y_cols);
+        simulator_utilities::FillSecondDiffYMatrix(network.Y_data, saved_diff_mids, saved_second_diff_mids,
+                                                   network.convolutions, input_mids_, saved_mids_, d2Y);
+        Matrix dX;
+        Matrix d2X;
+        if (network.size == NetworkSize::small) {
+            Matrix dA = Matrix::Zero(network.A_rows, network.A_cols);
+            Matrix dB = Matrix::Zero(network.B_rows, network.B_cols);
+            for (size_t flux : network.influencing_fluxes) {
+                dA += direction[flux] * network.derivatives[flux].dA_small;
+                dB += direction[flux] * network.derivatives[flux].dB_small;
+            }
+
+            dX = state.A_small_decomposition.solve(dB * state.Y + state.B_small * dY - dA * state.X);
+            d2X = state.A_small_decomposition.solve(2.0 * dB * dY + state.B_small * d2Y - 2.0 * dA * dX);
+        } else {
+            SparseMatrix dA(network.A_rows, network.A_cols);
+            SparseMatrix dB(network.B_rows, network.B_cols);
+            for (size_t flux : network.influencing_fluxes) {
+                dA += direction[flux] * network.derivatives[flux].dA_big;
+                dB += direction[flux] * network.derivatives[flux].dB_big;
+            }
+
+            Eigen::BiCGSTAB<SparseMatrix, Eigen::IncompleteLUT<SparseMatrix::Scalar>> &solver = solvers_[total_big_networks++];
+            dX = solver.solve(dB * state.Y + state.B_big * dY - dA * state.X);
+            linear_solver_iterations_ += solver.iterations();
+            d2X = solver.solve(2.0 * dB * dY + state.B_big * d2Y - 2.0 * dA * dX);
+            linear_solver_iterations_ += solver.iterations();
+        }
+
+        simulator_utilities::SaveNewDiffEmus(dX, network.usefull_emus, network.final_emus, simulated_mids_,
+                                             sums_, saved_diff_mids[network_num], result.first_derivative);
+        simulator_utilities::SaveNewSecondDiffEmus(dX, d2X, network.usefull_emus, network.final_emus,
+                                                   simulated_mids_, result.first_derivative, sums_,
+                                                   saved_second_diff_mids[network_num], result.second_derivative);
+    }
+
     return result;
 }
 
+void Simulator::SetTolerance(double tolerance) {
+    for (auto &solver : solvers_) {
+        solver.setTolerance(tolerance);
+    }
+}
+
+size_t Simulator::GetLinearSolverIterations() const {
+    return linear_solver_iterations_;
+}
+
+size_t Simulator::GetLinearSolverFailures() const {
+    return linear_solver_failures_;
+}
+
 Simulator::Simulator(const std::vector<SimulatorNetworkData>& networks,
                      const std::vector<EmuAndMid>& input_mids,
                      const size_t total_mids_to_simulate) :
@@ -134,7 +295,20 @@ Simulator::Simulator(const std::vector<SimulatorNetworkData>& networks,
                                             total_mids_to_simulate_{total_mids_to_simulate},
                                             input_mids_{input_mids},
                                             networks_{networks},
-                                            solvers_{networks_.size()}{
+                                            solvers_{networks_.size()},
+                                            states_(networks.size()),
+                                            saved_mids_(networks.size()),
+                                            saved_diff_mids_(total_free_fluxes_,
+                                                             std::vector<std::vector<Mid>>(networks.size())),
+                                            simulated_mids_(total_mids_to_simulate),
+                                            sums_(total_mids_to_simulate) {
+    for (const SimulatorNetworkData &network : networks) {
+        for (const FinalEmu &final_emu : network.final_emus) {
+            simulated_mids_[final_emu.position_in_result].emu = final_emu.emu;
+        }
+    }
+    diff_results_.assign(total_free_fluxes_, simulated_mids_);
+
     int total_big_networks = 0;
     for (const SimulatorNetworkData &network : networks) {
         if (network.size == NetworkSize::big) {
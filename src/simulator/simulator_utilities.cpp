@@ -33,12 +33,8 @@ void FillYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
                  Matrix& Y_out) {
     for (size_t i = 0; i < Y_data.size(); ++i) {
         const PositionOfSavedEmu& known_emu = Y_data[i];
-        Mid mid;
-        if (known_emu.network == -1) {
-            mid = input_mids[known_emu.position].mid;
-        } else {
-            mid = saved_mids[known_emu.network][known_emu.position];
-        }
+        const Mid &mid = known_emu.network == -1 ? input_mids[known_emu.position].mid :
+                                                   saved_mids[known_emu.network][known_emu.position];
         for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
             Y_out(i, mass_shift) = mid[mass_shift];
         }
@@ -66,37 +62,24 @@ void SaveNewEmus(const Matrix& X,
                  std::vector<Mid>& saved_mids_out,
                  std::vector<EmuAndMid>& result_out,
                  std::vector<double>& sums_out) {
-    for (int position : usefull_emus) {
-        Mid new_mid;
-        for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-            new_mid.push_back(X(position, mass_shift));
-        }
-        saved_mids_out.push_back(new_mid);
-    }
+    SaveUsefullEmus(X, usefull_emus, saved_mids_out);
 
     for (const FinalEmu& final_emu : final_emus) {
-        Mid result_mid;
+        Mid &result_mid = result_out[final_emu.position_in_result].mid;
         if (final_emu.correction_matrix.rows() > 0) {
-            Matrix original_mid = X.row(final_emu.order_in_X);
-            Matrix corrected_mid = final_emu.correction_matrix * original_mid.transpose();
-            double sum = 0.0;
-            for (int i = 0; i < corrected_mid.rows(); ++i) {
-                sum += corrected_mid(i, 0);
-            }
+            const Eigen::VectorXd corrected_mid = final_emu.correction_matrix * X.row(final_emu.order_in_X).transpose();
+            const double sum = corrected_mid.sum();
             sums_out[final_emu.position_in_result] = sum;
-            for (int mass_shift = 0; mass_shift < corrected_mid.rows(); ++mass_shift) {
-                result_mid.push_back(corrected_mid(mass_shift, 0) / sum);
+            result_mid.resize(corrected_mid.size());
+            for (int mass_shift = 0; mass_shift < corrected_mid.size(); ++mass_shift) {
+                result_mid[mass_shift] = corrected_mid(mass_shift) / sum;
             }
         } else {
+            result_mid.resize(X.cols());
             for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-                result_mid.push_back(X(final_emu.order_in_X, mass_shift));
+                result_mid[mass_shift] = X(final_emu.order_in_X, mass_shift);
             }
         }
-
-        EmuAndMid result_emu;
-        result_emu.emu = final_emu.emu;
-        result_emu.mid = result_mid;
-        result_out[final_emu.position_in_result] = result_emu;
     }
 }
 
@@ -107,60 +90,56 @@ void SaveNewDiffEmus(const Matrix& X,
                      const std::vector<double>& sums,
                      std::vector<Mid>& saved_mids_out,
                      std::vector<EmuAndMid>& diff_result_out) {
-    for (int position : usefull_emus) {
-        Mid new_mid;
-        for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-            new_mid.push_back(X(position, mass_shift));
-        }
-        saved_mids_out.push_back(new_mid);
-    }
+    SaveUsefullEmus(X, usefull_emus, saved_mids_out);
 
     for (const FinalEmu& final_emu : final_emus) {
-        Mid result_mid;
+        Mid &result_mid = diff_result_out[final_emu.position_in_result].mid;
         if (final_emu.correction_matrix.rows() > 0) {
-            Matrix mid(result[final_emu.position_in_result].mid.size(), 1);
-            for (int i = 0; i < result[final_emu.position_in_result].mid.size(); ++i) {
-                mid(i, 0) = result[final_emu.position_in_result].mid[i];
-            }
-
-            Matrix diff_mid = X.row(final_emu.order_in_X);
-            Matrix corrected_mid = GetCorrectedDiffMid(final_emu.correction_matrix,
-                                                       mid,
-                                                       diff_mid.transpose(),
-                                                       sums[final_emu.position_in_result]);
-
-
-            for (int mass_shift = 0; mass_shift < corrected_mid.rows(); ++mass_shift) {
-                result_mid.push_back(corrected_mid(mass_shift, 0));
+            // d(C * x / sum) = (C * dx - mid * dsum) / sum
+            const Mid &mid = result[final_emu.position_in_result].mid;
+            const Eigen::VectorXd corrected_diff = final_emu.correction_matrix * X.row(final_emu.order_in_X).transpose();
+            const double diff_sum = corrected_diff.sum();
+            result_mid.resize(corrected_diff.size());
+            for (int mass_shift = 0; mass_shift < corrected_diff.size(); ++mass_shift) {
+                result_mid[mass_shift] = (corrected_diff(mass_shift) - mid[mass_shift] * diff_sum) /
+                                         sums[final_emu.position_in_result];
             }
         } else {
+            result_mid.resize(X.cols());
             for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-                result_mid.push_back(X(final_emu.order_in_X, mass_shift));
+                result_mid[mass_shift] = X(final_emu.order_in_X, mass_shift);
             }
         }
-
-        EmuAndMid result_emu;
-        result_emu.emu = final_emu.emu;
-        result_emu.mid = result_mid;
-        diff_result_out[final_emu.position_in_result] = result_emu;
     }
 }
 
-Matrix GetCorrectedDiffMid(const Matrix& correction_matrix,
-                           Matrix mid,
-                           const Matrix& diff_mid,
-                           double sum) {
-    Matrix corrected_diff_mid = correction_matrix * diff_mid;
-    double diff_sum = 0.0;
-    for (int i = 0; i < corrected_diff_mid.rows(); ++i) {
-        diff_sum += corrected_diff_mid(i, 0);
-    }
-    mid *= diff_sum;
-    corrected_diff_mid -= mid;
-    corrected_diff_mid /= sum;
-    return corrected_diff_mid;
+void SaveZeroDiffEmus(size_t mid_size,
+                      const std::vector<int>& usefull_emus,
+                      const std::vector<FinalEmu>& final_emus,
+                      const std::vector<EmuAndMid> &result,
+                      std::vector<Mid>& saved_mids_out,
+                      std::vector<EmuAndMid>& diff_result_out) {
+    saved_mids_out.resize(usefull_emus.size());
+    for (Mid &mid : saved_mids_out) {
+        mid.assign(mid_size, 0.0);
+    }
+
+    for (const FinalEmu& final_emu : final_emus) {
+        diff_result_out[final_emu.position_in_result].mid.assign(result[final_emu.position_in_result].mid.size(), 0.0);
+    }
 }
 
+void SaveUsefullEmus(const Matrix& X,
+                     const std::vector<int>& usefull_emus,
+                     std::vector<Mid>& saved_mids_out) {
+    saved_mids_out.resize(usefull_emus.size());
+    for (size_t i = 0; i < usefull_emus.size(); ++i) {
+        saved_mids_out[i].resize(X.cols());
+        for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
+            saved_mids_out[i][mass_shift] = X(usefull_emus[i], mass_shift);
+        }
+    }
+}
 
 void FillDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
                      const std::vector<std::vector<Mid>>& known_d_mids,
@@ -170,14 +149,13 @@ void FillDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
                      Matrix& Y_out) {
     for (size_t i = 0; i < Y_data.size(); ++i) {
         const PositionOfSavedEmu known_emu = Y_data[i];
-        Mid mid;
         if (known_emu.network == -1) {
             // Do nothing. Because:
             // mid = std::vector<double> (Y_out.cols(), 0.0);
             // and Y_out(i, ...) is already zero
-        } else {
-            mid = known_d_mids[known_emu.network][known_emu.position];
+            continue;
         }
+        const Mid &mid = known_d_mids[known_emu.network][known_emu.position];
         for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
             Y_out(i, mass_shift) = mid[mass_shift];
         }
@@ -230,5 +208,127 @@ Mid ConvolvePartialDiff(const Convolution& convolution,
     }
     return mid_part;
 }
+
+void SaveNewSecondDiffEmus(const Matrix& dX,
+                           const Matrix& d2X,
+                           const std::vector<int>& usefull_emus,
+                           const std::vector<FinalEmu>& final_emus,
+                           const std::vector<EmuAndMid> &result,
+                           const std::vector<EmuAndMid> &diff_result,
+                           const std::vector<double>& sums,
+                           std::vector<Mid>& saved_mids_out,
+                           std::vector<EmuAndMid>& second_diff_result_out) {
+    for (int position : usefull_emus) {
+        Mid new_mid;
+        for (int mass_shift = 0; mass_shift < d2X.cols(); ++mass_shift) {
+            new_mid.push_back(d2X(position, mass_shift));
+        }
+        saved_mids_out.push_back(new_mid);
+    }
+
+    for (const FinalEmu& final_emu : final_emus) {
+        Mid result_mid;
+        if (final_emu.correction_matrix.rows() > 0) {
+            // Let mid = C * x / sum, where sum = 1^T * C * x, then
+            // d2mid = (C * d2x - 2 * dmid * dsum - mid * d2sum) / sum
+            const Matrix corrected_diff = final_emu.correction_matrix * dX.row(final_emu.order_in_X).transpose();
+            const Matrix corrected_second_diff = final_emu.correction_matrix * d2X.row(final_emu.order_in_X).transpose();
+            const double diff_sum = corrected_diff.sum();
+            const double second_diff_sum = corrected_second_diff.sum();
+
+            const Mid &mid = result[final_emu.position_in_result].mid;
+            const Mid &diff_mid = diff_result[final_emu.position_in_result].mid;
+            for (int mass_shift = 0; mass_shift < corrected_second_diff.rows(); ++mass_shift) {
+                result_mid.push_back((corrected_second_diff(mass_shift, 0) - 2.0 * diff_mid[mass_shift] * diff_sum -
+                                      mid[mass_shift] * second_diff_sum) / sums[final_emu.position_in_result]);
+            }
+        } else {
+            for (int mass_shift = 0; mass_shift < d2X.cols(); ++mass_shift) {
+                result_mid.push_back(d2X(final_emu.order_in_X, mass_shift));
+            }
+        }
+
+        EmuAndMid result_emu;
+        result_emu.emu = final_emu.emu;
+        result_emu.mid = result_mid;
+        second_diff_result_out[final_emu.position_in_result] = result_emu;
+    }
+}
+
+
+Mid ConvolveSecondPartialDiff(const Convolution& convolution,
+                              const std::vector<std::vector<Mid>>& known_d_mids,
+                              const std::vector<std::vector<Mid>>& known_d2_mids,
+                              const std::vector<EmuAndMid>& input_mids,
+                              const std::vector<std::vector<Mid>>& saved_mids,
+                              size_t mid_size,
+                              size_t first_diff_position,
+                              size_t second_diff_position) {
+    Mid mid_part(1, 1.0);
+    for (size_t i = 0; i < convolution.elements.size(); ++i) {
+        const PositionOfSavedEmu& emu = convolution.elements[i];
+        const bool is_first = (i == first_diff_position);
+        const bool is_second = (i == second_diff_position);
+        if (is_first || is_second) {
+            if (emu.network == -1) {
+                // input mids don't depend on fluxes
+                return std::vector<double> (mid_size, 0.0);
+            }
+            if (is_first && is_second) {
+                mid_part = mid_part * known_d2_mids[emu.network][emu.position];
+            } else {
+                mid_part = mid_part * known_d_mids[emu.network][emu.position];
+            }
+        } else {
+            if (emu.network == -1) {
+                mid_part = mid_part * input_mids[emu.position].mid;
+            } else {
+                mid_part = mid_part * saved_mids[emu.network][emu.position];
+            }
+        }
+    }
+    return mid_part;
+}
+
+
+void FillSecondDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
+                           const std::vector<std::vector<Mid>>& known_d_mids,
+                           const std::vector<std::vector<Mid>>& known_d2_mids,
+                           const std::vector<Convolution>& convolutions,
+                           const std::vector<EmuAndMid>& input_mids,
+                           const std::vector<std::vector<Mid>>& saved_mids,
+                           Matrix& Y_out) {
+    for (size_t i = 0; i < Y_data.size(); ++i) {
+        const PositionOfSavedEmu known_emu = Y_data[i];
+        if (known_emu.network == -1) {
+            // Y_out(i, ...) is already zero
+            continue;
+        }
+        const Mid &mid = known_d2_mids[known_emu.network][known_emu.position];
+        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
+            Y_out(i, mass_shift) = mid[mass_shift];
+        }
+    }
+
+    // d2(m1 * ... * mk) = sum_i (... * d2mi * ...) + sum_{i != j} (... * dmi * ... * dmj * ...)
+    size_t position = Y_data.size();
+    for (const Convolution& convolution : convolutions) {
+        Mid mid = std::vector<double> (Y_out.cols(), 0.0);
+        for (size_t first = 0; first < convolution.elements.size(); ++first) {
+            for (size_t second = 0; second < convolution.elements.size(); ++second) {
+                Mid mid_part = ConvolveSecondPartialDiff(convolution, known_d_mids, known_d2_mids,
+                                                         input_mids, saved_mids, Y_out.cols(), first, second);
+                for (size_t j = 0; j < mid.size(); ++j) {
+                    mid[j] += mid_part[j];
+                }
+            }
+        }
+
+        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
+            Y_out(position, mass_shift) = mid[mass_shift];
+        }
+        ++position;
+    }
+}
 } // namespace simulator_utilities
 } // namespace khnum
\ No newline at end of file
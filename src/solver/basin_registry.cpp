@@ -0,0 +1,59 @@
+#include "solver/basin_registry.h"
+
+#include <mutex>
+#include <cmath>
+
+
+namespace khnum {
+BasinRegistry::BasinRegistry(const Eigen::VectorXd &lower_bounds, const Eigen::VectorXd &upper_bounds, double radius) :
+    bounds_width_{upper_bounds - lower_bounds},
+    radius_{radius} {
+    // fixed fluxes don't move, but would divide by zero
+    for (int i = 0; i < bounds_width_.size(); ++i) {
+        if (bounds_width_(i) <= 0.0) {
+            bounds_width_(i) = 1.0;
+        }
+    }
+}
+
+
+size_t BasinRegistry::Add(const Eigen::VectorXd &free_fluxes, double ssr) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < optima_.size(); ++i) {
+        if (IsInBasin(free_fluxes, i)) {
+            // the same basin, the best optimum is kept
+            if (ssr < ssrs_[i]) {
+                optima_[i] = free_fluxes;
+                ssrs_[i] = ssr;
+            }
+            return i;
+        }
+    }
+    optima_.push_back(free_fluxes);
+    ssrs_.push_back(ssr);
+    return optima_.size() - 1;
+}
+
+
+std::optional<size_t> BasinRegistry::FindKnownBasin(const Eigen::VectorXd &free_fluxes, double ssr) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < optima_.size(); ++i) {
+        if (ssr >= ssrs_[i] && IsInBasin(free_fluxes, i)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+
+bool BasinRegistry::IsInBasin(const Eigen::VectorXd &free_fluxes, size_t basin) const {
+    const Eigen::VectorXd scaled_distance = (free_fluxes - optima_[basin]).cwiseQuotient(bounds_width_);
+    return scaled_distance.norm() <= radius_ * std::sqrt(static_cast<double>(scaled_distance.size()));
+}
+
+
+size_t BasinRegistry::GetSize() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return optima_.size();
+}
+} // namespace khnum
@@ -0,0 +1,269 @@
+#include "solver/batch_fitter.h"
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include "parser/open_flux_parser/open_flux_utills.h"
+#include "modeller/check_model.h"
+#include "solver/multistart_scheduler.h"
+#include "utilities/free_flux_bounds.h"
+#include "utilities/workers.h"
+
+
+namespace khnum {
+BatchDataset ReadBatchDataset(const std::string &path, const Problem &problem) {
+    std::vector<Emu> measured_isotopes;
+    // the header goes first
+    size_t total_lines = 1;
+    for (const Measurement &measurement : problem.measurements) {
+        measured_isotopes.push_back(measurement.emu);
+        total_lines += measurement.mid.size();
+    }
+    const std::vector<std::string> raw_measurements = open_flux_parser::GetLines(path);
+    if (raw_measurements.size() != total_lines) {
+        throw std::runtime_error(path + " has " + std::to_string(raw_measurements.size()) + " lines, the model has " +
+                                 std::to_string(total_lines - 1) + " measured values and the header");
+    }
+    open_flux_parser::Delimiters delimiters;
+    delimiters.csv_delimiter = ',';
+
+    BatchDataset dataset;
+    dataset.name = std::filesystem::path(path).stem().string();
+    dataset.measurements = open_flux_parser::ParseMeasurements(raw_measurements, measured_isotopes, delimiters);
+    modelling_utills::CheckMeasurementsMID(dataset.measurements, true);
+    return dataset;
+}
+
+
+std::vector<BatchDataset> ReadBatchDatasets(const std::string &directory, const Problem &problem) {
+    if (!std::filesystem::is_directory(directory)) {
+        throw std::runtime_error("Can't open the batch directory " + directory);
+    }
+    std::vector<std::string> paths;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".csv") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    if (paths.empty()) {
+        throw std::runtime_error("There are no measurements in the batch directory " + directory);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<BatchDataset> datasets;
+    for (const std::string &path : paths) {
+        datasets.push_back(ReadBatchDataset(path, problem));
+    }
+    return datasets;
+}
+
+
+BatchFitter::BatchFitter(const Problem &problem,
+                         const SimulatorGenerator &generator,
+                         const SolverParameters &solver_parameters,
+                         const BatchParameters &parameters) :
+    problem_{problem},
+    generator_{generator},
+    solver_parameters_{solver_parameters},
+    parameters_{parameters},
+    flux_map_{GetFluxMap(problem)},
+    model_fluxes_{GetModelFluxes(flux_map_)} {
+    if (parameters_.starts_per_dataset == 0) {
+        throw std::runtime_error("The batch needs at least one start per dataset");
+    }
+    master_seed_ = parameters_.master_seed ? *parameters_.master_seed : std::random_device()();
+
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem_);
+    start_points_ = SampleStartPoints(lower_bounds, upper_bounds, problem_.constraints,
+                                      solver_parameters_.start_sampling, parameters_.starts_per_dataset, master_seed_);
+}
+
+
+std::vector<BatchResult> BatchFitter::Run(const std::vector<BatchDataset> &datasets) {
+    const auto start_time = std::chrono::steady_clock::now();
+    // the first dataset has no warm start
+    const size_t total_tasks = datasets.empty() ? 0 : datasets.size() * (parameters_.starts_per_dataset + 1) - 1;
+    const size_t total_workers = GetTotalWorkers(parameters_.total_workers, total_tasks);
+
+    next_cold_task_ = 0;
+    ready_warm_starts_.clear();
+    remaining_tasks_.assign(datasets.size(), parameters_.starts_per_dataset + 1);
+    if (!datasets.empty()) {
+        remaining_tasks_[0] = parameters_.starts_per_dataset;
+    }
+    finished_datasets_ = 0;
+    is_failed_ = false;
+    results_.assign(datasets.size(), BatchResult());
+
+    RunWorkers(total_workers, [&](size_t worker) {
+        try {
+            RunWorker(worker, datasets);
+        } catch (...) {
+            // the dataset of the failed task is never finished, so the waiting workers are woken up to stop
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                is_failed_ = true;
+            }
+            task_ready_.notify_all();
+            throw;
+        }
+    });
+
+    // the skipped warm starts aren't counted
+    size_t total_fitted = 0;
+    size_t total_warm_best = 0;
+    size_t total_starts = 0;
+    for (const BatchResult &result : results_) {
+        total_fitted += result.best_result.has_value();
+        total_warm_best += result.is_best_warm;
+        total_starts += result.total_starts;
+    }
+    std::cout << "Batch: " << total_fitted << " of " << datasets.size() << " datasets fitted with " << total_starts
+              << " starts on " << total_workers << " workers in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+              << " seconds, the warm start was the best of " << total_warm_best << std::endl;
+
+    if (!parameters_.output_path.empty()) {
+        WriteResults(datasets);
+    }
+    return results_;
+}
+
+
+void BatchFitter::RunWorker(size_t worker, const std::vector<BatchDataset> &datasets) {
+    if (parameters_.pin_workers) {
+        PinThreadToCore(worker);
+    }
+    Solver solver(problem_, generator_, solver_parameters_);
+    std::optional<size_t> solver_dataset;
+    for (std::optional<Task> task = GetNextTask(); task; task = GetNextTask()) {
+        if (solver_dataset != task->dataset) {
+            solver.SetMeasurements(datasets[task->dataset].measurements);
+            solver_dataset = task->dataset;
+        }
+        const uint64_t seed = GetStartSeed(master_seed_, task->start);
+        StartResult result;
+        if (task->is_warm) {
+            std::optional<Eigen::VectorXd> optimum;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const alglib::real_1d_array &free_fluxes = results_[task->dataset - 1].best_result->free_fluxes;
+                optimum = Eigen::Map<const Eigen::VectorXd>(free_fluxes.getcontent(), free_fluxes.length());
+            }
+            solver.SetStepTolerance(parameters_.warm_start_epsx);
+            result = solver.SolveFromStart(task->start, seed, optimum);
+        } else {
+            solver.SetStepTolerance(solver_parameters_.epsx);
+            if (start_points_.empty()) {
+                result = solver.SolveFromStart(task->start, seed);
+            } else {
+                result = solver.SolveFromStart(task->start, seed, start_points_[task->start]);
+            }
+        }
+        AddFinishedTask(*task, result, datasets);
+    }
+}
+
+
+std::optional<BatchFitter::Task> BatchFitter::GetNextTask() {
+    const size_t total_cold_tasks = remaining_tasks_.size() * parameters_.starts_per_dataset;
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ready_.wait(lock, [&] {
+        return is_failed_ || !ready_warm_starts_.empty() || next_cold_task_ < total_cold_tasks ||
+               finished_datasets_ == remaining_tasks_.size();
+    });
+    if (is_failed_) {
+        return std::nullopt;
+    }
+    // the warm starts hold up the next datasets' ones
+    if (!ready_warm_starts_.empty()) {
+        const size_t dataset = ready_warm_starts_.front();
+        ready_warm_starts_.pop_front();
+        return Task{dataset, parameters_.starts_per_dataset, true};
+    }
+    if (next_cold_task_ < total_cold_tasks) {
+        const size_t task = next_cold_task_++;
+        return Task{task / parameters_.starts_per_dataset, task % parameters_.starts_per_dataset, false};
+    }
+    return std::nullopt;
+}
+
+
+void BatchFitter::AddFinishedTask(const Task &task, const StartResult &result,
+                                  const std::vector<BatchDataset> &datasets) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    BatchResult &dataset_result = results_[task.dataset];
+    ++dataset_result.total_starts;
+    if (std::isfinite(result.ssr) &&
+        (!dataset_result.best_result || result.ssr < dataset_result.best_result->ssr)) {
+        dataset_result.best_result = result;
+        dataset_result.is_best_warm = task.is_warm;
+    }
+    if (--remaining_tasks_[task.dataset] == 0) {
+        FinishDataset(task.dataset, datasets);
+    }
+}
+
+
+void BatchFitter::FinishDataset(size_t dataset, const std::vector<BatchDataset> &datasets) {
+    for (;; ++dataset) {
+        ++finished_datasets_;
+        const BatchResult &result = results_[dataset];
+        std::cout << "Batch: dataset " << datasets[dataset].name << " SSR "
+                  << (result.best_result ? result.best_result->ssr : std::nan("")) << " of " << result.total_starts
+                  << " starts" << (result.is_best_warm ? ", the warm start is the best" : "") << std::endl;
+        if (dataset + 1 == results_.size()) {
+            break;
+        }
+        if (result.best_result) {
+            ready_warm_starts_.push_back(dataset + 1);
+            break;
+        }
+        // the next dataset has no optimum to start from
+        if (--remaining_tasks_[dataset + 1] > 0) {
+            break;
+        }
+    }
+    task_ready_.notify_all();
+}
+
+
+void BatchFitter::WriteResults(const std::vector<BatchDataset> &datasets) const {
+    std::ofstream output(parameters_.output_path);
+    output.precision(10);
+    output << "dataset,name,ssr,iterations,warm";
+    for (int reaction : model_fluxes_) {
+        output << "," << problem_.reactions.at(reaction).name;
+    }
+    output << "\n";
+    for (size_t dataset = 0; dataset < datasets.size(); ++dataset) {
+        const BatchResult &result = results_[dataset];
+        output << dataset << "," << datasets[dataset].name << ",";
+        if (!result.best_result) {
+            output << "nan,0,0";
+            for (size_t i = 0; i < model_fluxes_.size(); ++i) {
+                output << ",nan";
+            }
+            output << "\n";
+            continue;
+        }
+        const Eigen::VectorXd free_fluxes = Eigen::Map<const Eigen::VectorXd>(
+            result.best_result->free_fluxes.getcontent(), result.best_result->free_fluxes.length());
+        const Eigen::VectorXd fluxes = flux_map_.coefficients * free_fluxes + flux_map_.offsets;
+        output << result.best_result->ssr << "," << result.best_result->iterations << "," << result.is_best_warm;
+        for (int reaction : model_fluxes_) {
+            output << "," << fluxes(reaction);
+        }
+        output << "\n";
+    }
+    if (!output) {
+        throw std::runtime_error("Can't write the batch results to " + parameters_.output_path);
+    }
+}
+} // namespace khnum
@@ -0,0 +1,291 @@
+#include "solver/differential_evolution.h"
+
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
+#include "solver/polytope_sampler.h"
+#include "solver/multistart_scheduler.h"
+#include "utilities/free_flux_bounds.h"
+#include "utilities/random_source.h"
+#include "utilities/workers.h"
+
+
+namespace khnum {
+namespace {
+// the polished candidates are this far apart, in the bound widths
+const double kDistinctDistance = 1.e-3;
+const int kReportPeriod = 10;
+} // namespace
+
+
+DifferentialEvolution::DifferentialEvolution(const Problem &problem,
+                                             const SimulatorGenerator &generator,
+                                             const SolverParameters &solver_parameters,
+                                             const DifferentialEvolutionParameters &parameters) :
+    problem_{problem},
+    generator_{generator},
+    solver_parameters_{solver_parameters},
+    parameters_{parameters} {
+    // of the LM polishing, the evaluations only simulate the points
+    solver_parameters_.epsx = parameters_.epsx;
+    master_seed_ = parameters_.master_seed ? *parameters_.master_seed : std::random_device()();
+
+    std::tie(lower_bounds_, upper_bounds_) = GetFreeFluxBounds(problem_);
+    for (int i = 0; i < lower_bounds_.size(); ++i) {
+        if (lower_bounds_(i) < upper_bounds_(i)) {
+            variable_fluxes_.push_back(i);
+        }
+    }
+}
+
+
+void DifferentialEvolution::SetTelemetry(Telemetry *telemetry) {
+    telemetry_ = telemetry;
+}
+
+
+std::vector<StartResult> DifferentialEvolution::Run() {
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto get_elapsed_seconds = [&start_time]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    };
+    report_ = DifferentialEvolutionReport();
+    const int dimension = variable_fluxes_.size();
+    if (dimension == 0) {
+        throw std::runtime_error("All the free fluxes are fixed, there is nothing to optimize");
+    }
+    // current-to-best/1 needs the best and two more members
+    const size_t population_size =
+        std::max<size_t>(4, parameters_.population_size > 0 ? parameters_.population_size : 10 * dimension);
+    total_workers_ = GetTotalWorkers(parameters_.total_workers, population_size);
+    solvers_.clear();
+    for (size_t worker = 0; worker < total_workers_; ++worker) {
+        solvers_.push_back(std::make_unique<Solver>(problem_, generator_, solver_parameters_));
+    }
+
+    std::mt19937 random_source = CreateRandomSource(master_seed_);
+    PolytopeSampler sampler(lower_bounds_, upper_bounds_, problem_.constraints.matrix,
+                            problem_.constraints.right_part);
+    std::vector<Eigen::VectorXd> population =
+        solver_parameters_.start_sampling == StartSampling::halton ?
+            sampler.SampleLowDiscrepancy(population_size, random_source) :
+            sampler.Sample(population_size, random_source);
+    std::vector<double> ssr;
+    EvaluateBatch(population, ssr);
+    size_t total_simulations = population_size;
+
+    std::uniform_real_distribution<> get_uniform(0.0, 1.0);
+    std::uniform_int_distribution<size_t> get_member(0, population_size - 1);
+    std::uniform_int_distribution<int> get_position(0, dimension - 1);
+    std::vector<Eigen::VectorXd> trials(population_size);
+    std::vector<double> trial_ssr;
+    std::optional<double> target_seconds;
+    int generation = 0;
+    while (true) {
+        const size_t best = std::min_element(ssr.begin(), ssr.end()) - ssr.begin();
+        if (parameters_.target_ssr && ssr[best] <= *parameters_.target_ssr) {
+            target_seconds = get_elapsed_seconds();
+            break;
+        }
+        const double worst_ssr = *std::max_element(ssr.begin(), ssr.end());
+        if (worst_ssr - ssr[best] <= parameters_.tolerance * std::max(ssr[best], 1.0) ||
+            generation == parameters_.max_generations) {
+            break;
+        }
+
+        for (size_t member = 0; member < population_size; ++member) {
+            size_t first = get_member(random_source);
+            while (first == member) {
+                first = get_member(random_source);
+            }
+            size_t second = get_member(random_source);
+            while (second == member || second == first) {
+                second = get_member(random_source);
+            }
+            const double weight = parameters_.min_differential_weight +
+                (parameters_.max_differential_weight - parameters_.min_differential_weight) * get_uniform(random_source);
+            const Eigen::VectorXd &parent = population[member];
+            const Eigen::VectorXd mutant = parent + weight * (population[best] - parent) +
+                                           weight * (population[first] - population[second]);
+
+            // at least one coordinate is taken from the mutant
+            Eigen::VectorXd &trial = trials[member];
+            trial = parent;
+            const int forced_position = get_position(random_source);
+            for (int i = 0; i < dimension; ++i) {
+                if (i == forced_position || get_uniform(random_source) < parameters_.crossover_rate) {
+                    trial(variable_fluxes_[i]) = mutant(variable_fluxes_[i]);
+                }
+            }
+            // the infeasible trial is moved to a random point between the parent and the polytope boundary,
+            // the boundary itself would gather the population
+            const Eigen::VectorXd direction = trial - parent;
+            const double feasible_step = GetFeasibleStep(parent, direction);
+            if (feasible_step < 1.0) {
+                trial = parent + feasible_step * get_uniform(random_source) * direction;
+            }
+        }
+
+        EvaluateBatch(trials, trial_ssr);
+        total_simulations += population_size;
+        for (size_t member = 0; member < population_size; ++member) {
+            if (trial_ssr[member] <= ssr[member]) {
+                population[member] = trials[member];
+                ssr[member] = trial_ssr[member];
+            }
+        }
+        ++generation;
+        if (generation % kReportPeriod == 0) {
+            std::cout << "Differential evolution generation " << generation << ": best SSR "
+                      << *std::min_element(ssr.begin(), ssr.end()) << std::endl;
+        }
+    }
+    const double search_seconds = get_elapsed_seconds();
+    report_.generations = generation;
+    report_.is_target_reached = target_seconds.has_value();
+
+    // the best distinct members go to the polishing
+    std::vector<size_t> order(population_size);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&ssr](size_t lhs, size_t rhs) {
+        return ssr[lhs] < ssr[rhs];
+    });
+    Eigen::VectorXd scales = upper_bounds_ - lower_bounds_;
+    for (int i = 0; i < scales.size(); ++i) {
+        if (scales(i) <= 0.0) {
+            scales(i) = 1.0;
+        }
+    }
+    std::vector<Eigen::VectorXd> polished_points;
+    for (size_t member : order) {
+        if (polished_points.size() == parameters_.total_polished || !std::isfinite(ssr[member])) {
+            break;
+        }
+        const bool is_distinct = std::all_of(polished_points.begin(), polished_points.end(),
+                                             [&](const Eigen::VectorXd &point) {
+            return (population[member] - point).cwiseQuotient(scales).norm() > kDistinctDistance;
+        });
+        if (is_distinct) {
+            polished_points.push_back(population[member]);
+            report_.candidate_ssr.push_back(ssr[member]);
+        }
+    }
+
+    for (size_t worker = 0; worker < total_workers_; ++worker) {
+        solvers_[worker]->SetTelemetry(telemetry_, worker);
+    }
+    next_point_ = 0;
+    std::vector<StartResult> results(polished_points.size());
+    RunWorkers(std::min(total_workers_, polished_points.size()), [&](size_t worker) {
+        RunPolishingWorker(worker, polished_points, results);
+    });
+
+    const double elapsed_seconds = get_elapsed_seconds();
+    double best_polished_ssr = std::numeric_limits<double>::infinity();
+    for (const StartResult &result : results) {
+        best_polished_ssr = std::min(best_polished_ssr, result.ssr);
+    }
+    std::cout << "Differential evolution: " << generation << " generations of " << population_size
+              << " candidates on " << total_workers_ << " workers in " << search_seconds << " seconds, "
+              << total_simulations << " simulations, " << total_simulations / search_seconds
+              << " simulations per second" << std::endl;
+    std::cout << " best SSR " << ssr[order.front()] << " of the search";
+    if (target_seconds) {
+        std::cout << ", target SSR " << *parameters_.target_ssr << " reached in " << *target_seconds << " seconds";
+    }
+    std::cout << std::endl;
+    std::cout << " best SSR " << best_polished_ssr << " after polishing " << results.size() << " candidates, "
+              << elapsed_seconds << " seconds in total" << std::endl;
+    return results;
+}
+
+
+const DifferentialEvolutionReport &DifferentialEvolution::GetReport() const {
+    return report_;
+}
+
+
+void DifferentialEvolution::EvaluateBatch(const std::vector<Eigen::VectorXd> &points, std::vector<double> &ssr) {
+    ssr.assign(points.size(), std::numeric_limits<double>::infinity());
+    next_point_ = 0;
+    RunWorkers(total_workers_, [&](size_t worker) {
+        RunEvaluationWorker(worker, points, ssr);
+    });
+}
+
+
+void DifferentialEvolution::RunEvaluationWorker(size_t worker, const std::vector<Eigen::VectorXd> &points,
+                                                std::vector<double> &ssr) {
+    if (parameters_.pin_workers) {
+        PinThreadToCore(worker);
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+    // the evaluations aren't starts, only the seconds are counted
+    WorkerTelemetry worker_telemetry;
+    Eigen::VectorXd residuals;
+    for (size_t point = next_point_++; point < points.size(); point = next_point_++) {
+        {
+            ScopedTimer timer(telemetry_ ? &worker_telemetry.busy_seconds : nullptr);
+            solvers_[worker]->CalculateResiduals(points[point], residuals);
+        }
+        const double point_ssr = residuals.squaredNorm();
+        if (std::isfinite(point_ssr)) {
+            ssr[point] = point_ssr;
+        }
+    }
+
+    if (telemetry_) {
+        worker_telemetry.wall_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        telemetry_->AddWorker(worker, worker_telemetry);
+    }
+}
+
+
+void DifferentialEvolution::RunPolishingWorker(size_t worker, const std::vector<Eigen::VectorXd> &points,
+                                               std::vector<StartResult> &results) {
+    if (parameters_.pin_workers) {
+        PinThreadToCore(worker);
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+    WorkerTelemetry worker_telemetry;
+    for (size_t point = next_point_++; point < points.size(); point = next_point_++) {
+        results[point] = solvers_[worker]->SolveFromStart(point, GetStartSeed(master_seed_, point), points[point]);
+        ++worker_telemetry.starts;
+        worker_telemetry.busy_seconds += results[point].seconds;
+    }
+
+    if (telemetry_) {
+        worker_telemetry.wall_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        telemetry_->AddWorker(worker, worker_telemetry);
+    }
+}
+
+
+double DifferentialEvolution::GetFeasibleStep(const Eigen::VectorXd &parent, const Eigen::VectorXd &direction) const {
+    double step = 1.0;
+    for (int i = 0; i < direction.size(); ++i) {
+        if (direction(i) > 0.0) {
+            step = std::min(step, (upper_bounds_(i) - parent(i)) / direction(i));
+        } else if (direction(i) < 0.0) {
+            step = std::min(step, (lower_bounds_(i) - parent(i)) / direction(i));
+        }
+    }
+    const LinearConstraints &constraints = problem_.constraints;
+    for (int row = 0; row < constraints.matrix.rows(); ++row) {
+        const double slope = constraints.matrix.row(row).dot(direction);
+        if (slope > 0.0) {
+            step = std::min(step, (constraints.right_part(row) - constraints.matrix.row(row).dot(parent)) / slope);
+        }
+    }
+    return std::max(0.0, step);
+}
+} // namespace khnum
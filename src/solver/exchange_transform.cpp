@@ -0,0 +1,52 @@
+#include "solver/exchange_transform.h"
+
+
+namespace khnum {
+ExchangeTransform::ExchangeTransform(const std::vector<int> &positions, double scale) :
+    positions_{positions},
+    scale_{scale} {
+
+}
+
+
+void ExchangeTransform::ToVariables(Eigen::Ref<Eigen::VectorXd> free_fluxes) const {
+    for (int position : positions_) {
+        free_fluxes(position) /= free_fluxes(position) + scale_;
+    }
+}
+
+
+void ExchangeTransform::ToFluxes(Eigen::Ref<Eigen::VectorXd> variables) const {
+    for (int position : positions_) {
+        variables(position) *= scale_ / (1.0 - variables(position));
+    }
+}
+
+
+// x = scale * u / (1 - u), dx / du = scale / (1 - u)^2
+void ExchangeTransform::ScaleJacobian(const Eigen::Ref<const Eigen::VectorXd> &variables,
+                                      JacobianMap &jacobian) const {
+    for (int position : positions_) {
+        const double complement = 1.0 - variables(position);
+        jacobian.col(position) *= scale_ / (complement * complement);
+    }
+}
+
+
+bool ExchangeTransform::IsEmpty() const {
+    return positions_.empty();
+}
+
+
+std::vector<int> GetTransformedExchangeFluxes(const Problem &problem) {
+    std::vector<int> transformed_fluxes;
+    for (int position : problem.exchange_fluxes) {
+        const bool is_bounded = problem.lower_bounds[position] >= 0.0 &&
+                                problem.lower_bounds[position] < problem.upper_bounds[position];
+        if (is_bounded && problem.constraints.matrix.col(position).isZero()) {
+            transformed_fluxes.push_back(position);
+        }
+    }
+    return transformed_fluxes;
+}
+} // namespace khnum
@@ -0,0 +1,183 @@
+#include "solver/identifiability.h"
+
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "solver/solver.h"
+#include "solver/polytope_sampler.h"
+#include "utilities/free_flux_bounds.h"
+#include "utilities/random_source.h"
+
+
+namespace khnum {
+namespace {
+const std::string &GetFreeFluxName(const Problem &problem, int position) {
+    return problem.reactions.at(problem.reactions.size() - problem.nullspace.cols() + position).name;
+}
+
+
+void PrintNullDirection(const Problem &problem, const Eigen::VectorXd &direction) {
+    std::vector<int> positions;
+    for (int i = 0; i < direction.size(); ++i) {
+        if (std::abs(direction(i)) >= 0.1) {
+            positions.push_back(i);
+        }
+    }
+    std::sort(positions.begin(), positions.end(), [&direction](int lhs, int rhs) {
+        return std::abs(direction(lhs)) > std::abs(direction(rhs));
+    });
+    std::cout << " non-identifiable direction:";
+    for (int position : positions) {
+        std::cout << " " << direction(position) << " " << GetFreeFluxName(problem, position);
+    }
+    std::cout << std::endl;
+}
+} // namespace
+
+
+IdentifiabilityReport CheckIdentifiability(const Problem &problem, const SimulatorGenerator &generator,
+                                           uint64_t seed, size_t total_points, double tolerance) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const int nullity = problem.nullspace.cols();
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    std::vector<int> variable_fluxes;
+    for (int i = 0; i < nullity; ++i) {
+        if (lower_bounds(i) < upper_bounds(i)) {
+            variable_fluxes.push_back(i);
+        }
+    }
+
+    IdentifiabilityReport report;
+    report.sensitivities = Eigen::VectorXd::Zero(nullity);
+    report.null_directions.resize(nullity, 0);
+    report.rank = variable_fluxes.size();
+    if (variable_fluxes.empty()) {
+        return report;
+    }
+
+    // the degenerate polytopes are left to the starts, the box sampling doesn't need the interior
+    std::unique_ptr<PolytopeSampler> sampler;
+    try {
+        sampler = std::make_unique<PolytopeSampler>(lower_bounds, upper_bounds, problem.constraints.matrix,
+                                                    problem.constraints.right_part);
+    } catch (std::runtime_error &error) {
+        std::cout << "Identifiability check skipped: " << error.what() << std::endl;
+        return report;
+    }
+    report.fixing_point = sampler->GetCenter();
+    std::mt19937 random_source = CreateRandomSource(seed);
+    const std::vector<Eigen::VectorXd> points = sampler->Sample(total_points, random_source);
+
+    // the columns are scaled to the bounds, so the sensitivities of the fluxes are comparable
+    Solver solver(problem, generator);
+    const int measurements_count = problem.measurements_count;
+    Matrix stacked_jacobian(points.size() * measurements_count, variable_fluxes.size());
+    Eigen::VectorXd residuals;
+    Matrix jacobian;
+    for (const Eigen::VectorXd &point : points) {
+        solver.CalculateJacobian(point, residuals, jacobian);
+        if (!residuals.allFinite() || !jacobian.allFinite()) {
+            continue;
+        }
+        for (size_t i = 0; i < variable_fluxes.size(); ++i) {
+            const int flux = variable_fluxes[i];
+            stacked_jacobian.block(report.total_points * measurements_count, i, measurements_count, 1) =
+                jacobian.col(flux) * (upper_bounds(flux) - lower_bounds(flux));
+        }
+        ++report.total_points;
+    }
+    if (report.total_points == 0) {
+        std::cout << "Identifiability check: the jacobian isn't finite at the sampled points" << std::endl;
+        return report;
+    }
+    stacked_jacobian.conservativeResize(report.total_points * measurements_count, Eigen::NoChange);
+
+    for (size_t i = 0; i < variable_fluxes.size(); ++i) {
+        report.sensitivities(variable_fluxes[i]) =
+            stacked_jacobian.col(i).norm() / std::sqrt(static_cast<double>(report.total_points));
+    }
+
+    const Eigen::BDCSVD<Matrix> svd(stacked_jacobian, Eigen::ComputeFullV);
+    report.singular_values = svd.singularValues();
+    report.rank = 0;
+    while (report.rank < report.singular_values.size() &&
+           report.singular_values(report.rank) > tolerance * report.singular_values(0)) {
+        ++report.rank;
+    }
+
+    // the null directions are scaled back to the fluxes
+    report.null_directions.resize(nullity, variable_fluxes.size() - report.rank);
+    report.null_directions.setZero();
+    for (int direction = 0; direction < report.null_directions.cols(); ++direction) {
+        for (size_t i = 0; i < variable_fluxes.size(); ++i) {
+            const int flux = variable_fluxes[i];
+            report.null_directions(flux, direction) =
+                svd.matrixV()(i, report.rank + direction) * (upper_bounds(flux) - lower_bounds(flux));
+        }
+        report.null_directions.col(direction).normalize();
+    }
+
+    // the pivoted QR puts the most sensitive and the least dependent columns first,
+    // the rest are the fluxes to fix
+    const Eigen::ColPivHouseholderQR<Matrix> decomposition(stacked_jacobian);
+    for (size_t i = report.rank; i < variable_fluxes.size(); ++i) {
+        report.non_identifiable.push_back(variable_fluxes[decomposition.colsPermutation().indices()(i)]);
+    }
+    std::sort(report.non_identifiable.begin(), report.non_identifiable.end());
+
+    std::cout << "Identifiability check: rank " << report.rank << " of " << variable_fluxes.size()
+              << " free fluxes at " << report.total_points << " points, singular values "
+              << report.singular_values(0) << " -> "
+              << report.singular_values(report.singular_values.size() - 1) << " in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+              << " seconds" << std::endl;
+    for (int direction = 0; direction < report.null_directions.cols(); ++direction) {
+        PrintNullDirection(problem, report.null_directions.col(direction));
+    }
+    for (int position : report.non_identifiable) {
+        std::cout << " non-identifiable free flux " << GetFreeFluxName(problem, position)
+                  << ", sensitivity " << report.sensitivities(position) << std::endl;
+    }
+    return report;
+}
+
+
+void FixNonIdentifiableFluxes(const IdentifiabilityReport &report, Problem &problem) {
+    if (report.non_identifiable.empty()) {
+        return;
+    }
+    LinearConstraints &constraints = problem.constraints;
+    for (int position : report.non_identifiable) {
+        const double value = report.fixing_point(position);
+        problem.lower_bounds[position] = value;
+        problem.upper_bounds[position] = value;
+        if (constraints.matrix.rows() > 0) {
+            constraints.right_part -= constraints.matrix.col(position) * value;
+            constraints.matrix.col(position).setZero();
+        }
+    }
+
+    // the rows of only the fixed fluxes are satisfied at the fixing point
+    std::vector<int> kept_rows;
+    for (int row = 0; row < constraints.matrix.rows(); ++row) {
+        if (!constraints.matrix.row(row).isZero()) {
+            kept_rows.push_back(row);
+        }
+    }
+    LinearConstraints reduced;
+    reduced.matrix.resize(kept_rows.size(), constraints.matrix.cols());
+    reduced.right_part.resize(kept_rows.size());
+    for (size_t row = 0; row < kept_rows.size(); ++row) {
+        reduced.matrix.row(row) = constraints.matrix.row(kept_rows[row]);
+        reduced.right_part(row) = constraints.right_part(kept_rows[row]);
+    }
+    std::cout << "Fixed non-identifiable free fluxes: " << report.non_identifiable.size()
+              << ", constraints: " << constraints.matrix.rows() << " -> " << reduced.matrix.rows() << std::endl;
+    constraints = std::move(reduced);
+}
+} // namespace khnum
@@ -0,0 +1,256 @@
+#include "solver/levenberg_marquardt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "eigen/Dense"
+
+
+namespace khnum {
+LevenbergMarquardt::LevenbergMarquardt(const LeastSquaresFunctions &functions,
+                                       const Eigen::VectorXd &lower_bounds,
+                                       const Eigen::VectorXd &upper_bounds,
+                                       const LevenbergMarquardtParameters &parameters) :
+    functions_{functions},
+    lower_bounds_{lower_bounds},
+    upper_bounds_{upper_bounds},
+    constraints_(0, lower_bounds.size()),
+    constraints_right_part_(0),
+    scale_{Eigen::VectorXd::Ones(lower_bounds.size())},
+    parameters_{parameters} {
+
+}
+
+
+void LevenbergMarquardt::SetInequalityConstraints(const Matrix &matrix, const Eigen::VectorXd &right_part) {
+    constraints_ = matrix;
+    constraints_right_part_ = right_part;
+}
+
+
+void LevenbergMarquardt::SetScale(const Eigen::VectorXd &scale) {
+    scale_ = scale;
+}
+
+
+void LevenbergMarquardt::SetStepTolerance(double epsx) {
+    parameters_.epsx = epsx;
+}
+
+
+const LevenbergMarquardtReport &LevenbergMarquardt::GetReport() const {
+    return report_;
+}
+
+
+// Every iteration finds the velocity minimizing |J * v + r|^2 + damping * |sqrt(D) * v|^2
+// and with the geodesic acceleration also the acceleration minimizing |J * a + r_vv|^2 + damping * |sqrt(D) * a|^2,
+// where r_vv is the second derivative of the residuals along the velocity.
+// The step is velocity + acceleration / 2.
+// Both problems are solved with QR on the null space of the active constraints,
+// so the condition number of J isn't squared as in the normal equations
+Eigen::VectorXd LevenbergMarquardt::Optimize(const Eigen::VectorXd &initial_point) {
+    const double max_damping = 1.e16;
+    const double min_damping = 1.e-15;
+
+    report_ = LevenbergMarquardtReport();
+    Eigen::VectorXd x = ProjectOnFeasibleSet(initial_point);
+
+    functions_.jacobian(x, residuals_, jacobian_);
+    ++report_.jacobian_evaluations;
+    double ssr = residuals_.squaredNorm();
+
+    // Diagonal of the damping matrix, the largest diagonal of J^T * J seen so far (Moré scaling)
+    scaling_.setZero(x.size());
+    double damping = parameters_.initial_damping;
+
+    while (report_.iterations < parameters_.max_iterations) {
+        scaling_ = scaling_.cwiseMax(jacobian_.colwise().squaredNorm().transpose());
+        const double min_scaling = 1.e-12 * std::max(scaling_.maxCoeff(), 1.0);
+        damping_diagonal_ = scaling_.cwiseMax(min_scaling);
+
+        bool is_accepted = false;
+        while (!is_accepted && damping < max_damping) {
+            // Constraints blocking the step are added to the active set until the step stays feasible
+            Matrix active_constraints(0, x.size());
+            free_directions_.setIdentity(x.size(), x.size());
+            while (true) {
+                DecomposeDampedSystem(damping);
+                SolveDampedSystem(residuals_, velocity_);
+                const Matrix blocking_constraints = GetBlockingConstraints(x, velocity_);
+                if (blocking_constraints.rows() == 0) {
+                    break;
+                }
+                active_constraints.conservativeResize(active_constraints.rows() + blocking_constraints.rows(),
+                                                      Eigen::NoChange);
+                active_constraints.bottomRows(blocking_constraints.rows()) = blocking_constraints;
+                free_directions_ = GetNullSpace(active_constraints);
+                if (free_directions_.cols() == 0) {
+                    velocity_.setZero();
+                    break;
+                }
+            }
+            if (velocity_.isZero()) {
+                break;
+            }
+            step_ = velocity_;
+
+            if (parameters_.use_geodesic_acceleration && functions_.second_directional_derivative) {
+                functions_.second_directional_derivative(x, velocity_, second_derivative_);
+                ++report_.second_derivative_evaluations;
+                SolveDampedSystem(second_derivative_, acceleration_);
+
+                // The quadratic model along the geodesic isn't trustworthy, so a smaller step is required
+                if (2.0 * acceleration_.norm() > parameters_.max_acceleration_ratio * velocity_.norm()) {
+                    damping *= 2.0;
+                    continue;
+                }
+                step_ += 0.5 * acceleration_;
+            }
+
+            trial_point_ = ProjectOnFeasibleSet(x + step_);
+            functions_.residuals(trial_point_, trial_residuals_);
+            ++report_.residual_evaluations;
+            const double trial_ssr = trial_residuals_.squaredNorm();
+
+            if (trial_ssr < ssr) {
+                step_ = trial_point_ - x;
+                x.swap(trial_point_);
+                ssr = trial_ssr;
+                damping = std::max(damping * 0.3, min_damping);
+                is_accepted = true;
+            } else {
+                damping *= 2.0;
+            }
+        }
+
+        ++report_.iterations;
+        if (!is_accepted || step_.cwiseQuotient(scale_).norm() <= parameters_.epsx) {
+            break;
+        }
+        if (functions_.report && !functions_.report(x, ssr)) {
+            break;
+        }
+
+        functions_.jacobian(x, residuals_, jacobian_);
+        ++report_.jacobian_evaluations;
+    }
+
+    report_.ssr = ssr;
+    return x;
+}
+
+
+void LevenbergMarquardt::DecomposeDampedSystem(double damping) {
+    const int measurements = jacobian_.rows();
+    const int parameters = free_directions_.rows();
+    augmented_matrix_.resize(measurements + parameters, free_directions_.cols());
+    augmented_matrix_.topRows(measurements).noalias() = jacobian_ * free_directions_;
+    augmented_matrix_.bottomRows(parameters).noalias() =
+        (damping * damping_diagonal_).cwiseSqrt().asDiagonal() * free_directions_;
+    decomposition_.compute(augmented_matrix_);
+}
+
+
+void LevenbergMarquardt::SolveDampedSystem(const Eigen::VectorXd &residuals, Eigen::VectorXd &solution) {
+    const int parameters = free_directions_.rows();
+    augmented_right_part_.resize(augmented_matrix_.rows());
+    augmented_right_part_.head(residuals.size()) = -residuals;
+    augmented_right_part_.tail(parameters).setZero();
+    solution.noalias() = free_directions_ * decomposition_.solve(augmented_right_part_);
+}
+
+
+Eigen::VectorXd LevenbergMarquardt::ProjectOnBounds(const Eigen::VectorXd &x) const {
+    return x.cwiseMax(lower_bounds_).cwiseMin(upper_bounds_);
+}
+
+
+Matrix LevenbergMarquardt::GetBlockingConstraints(const Eigen::VectorXd &x, const Eigen::VectorXd &step) const {
+    const double epsilon = 1.e-10;
+
+    std::vector<Eigen::VectorXd> blocking_constraints;
+    for (int row = 0; row < constraints_.rows(); ++row) {
+        const double slack = constraints_right_part_(row) - constraints_.row(row).dot(x);
+        const double rate = constraints_.row(row).dot(step);
+        if (slack <= epsilon * (std::abs(constraints_right_part_(row)) + 1.0) &&
+            rate > epsilon * constraints_.row(row).norm() * step.norm()) {
+            blocking_constraints.push_back(constraints_.row(row).transpose());
+        }
+    }
+    for (int i = 0; i < x.size(); ++i) {
+        if ((x(i) <= lower_bounds_(i) + epsilon && step(i) < -epsilon * step.norm()) ||
+            (x(i) >= upper_bounds_(i) - epsilon && step(i) > epsilon * step.norm())) {
+            blocking_constraints.push_back(Eigen::VectorXd::Unit(x.size(), i));
+        }
+    }
+
+    Matrix result(blocking_constraints.size(), x.size());
+    for (size_t row = 0; row < blocking_constraints.size(); ++row) {
+        result.row(row) = blocking_constraints[row].transpose();
+    }
+    return result;
+}
+
+
+Matrix LevenbergMarquardt::GetNullSpace(const Matrix &matrix) const {
+    const Eigen::ColPivHouseholderQR<Matrix> decomposition(matrix.transpose());
+    const Matrix q = decomposition.householderQ();
+    return q.rightCols(matrix.cols() - decomposition.rank());
+}
+
+
+bool LevenbergMarquardt::IsFeasible(const Eigen::VectorXd &x) const {
+    const double epsilon = 1.e-10;
+    if ((x - ProjectOnBounds(x)).lpNorm<Eigen::Infinity>() > 0.0) {
+        return false;
+    }
+    for (int row = 0; row < constraints_.rows(); ++row) {
+        if (constraints_.row(row).dot(x) > constraints_right_part_(row) + epsilon) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Dykstra's alternating projections on the box and the half-spaces
+Eigen::VectorXd LevenbergMarquardt::ProjectOnFeasibleSet(const Eigen::VectorXd &point) const {
+    const int max_sweeps = 1000;
+    const double tolerance = 1.e-12;
+
+    Eigen::VectorXd x = ProjectOnBounds(point);
+    if (IsFeasible(x)) {
+        return x;
+    }
+
+    x = point;
+    Eigen::VectorXd box_increment = Eigen::VectorXd::Zero(x.size());
+    Matrix increments = Matrix::Zero(x.size(), constraints_.rows());
+    for (int sweep = 0; sweep < max_sweeps; ++sweep) {
+        const Eigen::VectorXd previous_x = x;
+
+        Eigen::VectorXd shifted = x + box_increment;
+        x = ProjectOnBounds(shifted);
+        box_increment = shifted - x;
+
+        for (int row = 0; row < constraints_.rows(); ++row) {
+            shifted = x + increments.col(row);
+            const double row_norm = constraints_.row(row).squaredNorm();
+            const double excess = constraints_.row(row).dot(shifted) - constraints_right_part_(row);
+            x = shifted;
+            if (row_norm > 0.0 && excess > 0.0) {
+                x -= (excess / row_norm) * constraints_.row(row).transpose();
+            }
+            increments.col(row) = shifted - x;
+        }
+
+        if ((x - previous_x).norm() <= tolerance * (1.0 + x.norm())) {
+            break;
+        }
+    }
+    // the last projection is on the half-spaces, so the box may be slightly violated
+    return ProjectOnBounds(x);
+}
+} // namespace khnum
@@ -0,0 +1,547 @@
+#include "solver/multistart_scheduler.h"
+
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+#include "utilities/get_eigen_vec_from_alglib_vec.h"
+#include "solver/warm_start_library.h"
+#include "utilities/free_flux_bounds.h"
+#include "utilities/random_source.h"
+#include "utilities/workers.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace khnum {
+namespace {
+// no start is handed out if the rest of the budget is shorter than this part of the average start
+const double kLastStartFraction = 0.5;
+// the warm starts go to the best optima of the library, a few perturbed starts each
+const size_t kWarmStartsPerOptimum = 2;
+} // namespace
+
+
+MultistartScheduler::MultistartScheduler(const Problem &problem,
+                                         const SimulatorGenerator &generator,
+                                         const SolverParameters &solver_parameters,
+                                         const MultistartParameters &parameters) :
+    problem_{problem},
+    generator_{generator},
+    solver_parameters_{solver_parameters},
+    parameters_{parameters} {
+    master_seed_ = parameters_.master_seed ? *parameters_.master_seed : std::random_device()();
+}
+
+
+std::vector<StartResult> MultistartScheduler::Run() {
+    total_workers_ = GetTotalWorkers(parameters_.total_workers, parameters_.total_starts);
+    stolen_starts_.assign(total_workers_, 0);
+    worker_starts_.assign(total_workers_, 0);
+
+    const int nullity = problem_.nullspace.cols();
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem_);
+    start_points_ = SampleStartPoints(lower_bounds, upper_bounds, problem_.constraints, solver_parameters_.start_sampling,
+                                      parameters_.total_starts, master_seed_);
+    continued_points_.assign(parameters_.total_starts, std::nullopt);
+    if (parameters_.use_basin_registry) {
+        basin_registry_ = std::make_unique<BasinRegistry>(lower_bounds, upper_bounds, parameters_.basin_radius);
+    }
+    is_prioritized_ = parameters_.prioritize_starts;
+    if (is_prioritized_ && start_points_.empty()) {
+        start_points_ = GetBoxStartPoints(lower_bounds, upper_bounds);
+    }
+
+    // the first starts are seeded from the optima of the previous runs
+    std::unique_ptr<WarmStartLibrary> warm_start_library;
+    std::vector<std::optional<size_t>> start_optima(parameters_.total_starts);
+    is_warm_start_.assign(parameters_.total_starts, false);
+    if (!parameters_.warm_start_library.empty()) {
+        warm_start_library = std::make_unique<WarmStartLibrary>(parameters_.warm_start_library, problem_);
+        const size_t total_warm_starts = warm_start_library->GetSize() == 0 ? 0 :
+            std::min<size_t>(parameters_.total_starts,
+                             std::lround(parameters_.warm_start_fraction * parameters_.total_starts));
+        if (total_warm_starts > 0 && start_points_.empty()) {
+            start_points_ = GetBoxStartPoints(lower_bounds, upper_bounds);
+        }
+        size_t total_seeded = 0;
+        for (size_t start = 0; start < total_warm_starts; ++start) {
+            std::mt19937 random_source = CreateRandomSource(GetStartSeed(master_seed_, start));
+            const size_t optimum = start / kWarmStartsPerOptimum % warm_start_library->GetSize();
+            const std::optional<Eigen::VectorXd> point =
+                warm_start_library->GetStartPoint(optimum, parameters_.warm_start_perturbation, random_source);
+            if (point) {
+                start_points_[start] = *point;
+                start_optima[start] = optimum;
+                is_warm_start_[start] = true;
+                ++total_seeded;
+            }
+        }
+        std::cout << "Warm start library " << warm_start_library->GetPath() << ": " << total_seeded << " of "
+                  << parameters_.total_starts << " starts seeded from " << warm_start_library->GetSize()
+                  << " optima" << std::endl;
+    }
+
+    start_time_ = std::chrono::steady_clock::now();
+    deadline_.reset();
+    if (parameters_.time_budget) {
+        deadline_ = start_time_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(*parameters_.time_budget));
+    }
+    best_result_.reset();
+
+    std::vector<StartResult> completed_results;
+    if (!parameters_.log_path.empty()) {
+        if (parameters_.resume && parameters_.screening_iterations > 0) {
+            throw std::runtime_error("The successive halving can't be resumed from the start log");
+        }
+        start_log_ = std::make_unique<StartLog>(parameters_.log_path, nullity, parameters_.total_starts,
+                                                master_seed_, parameters_.resume);
+        completed_results = start_log_->GetCompletedResults();
+        if (parameters_.resume) {
+            std::cout << "Start log: " << completed_results.size() << " of " << parameters_.total_starts
+                      << " starts completed in " << parameters_.log_path << std::endl;
+        }
+    }
+    // the log has no basins, the resumed starts are registered again,
+    // the terminated ones get the basin they were heading to once all the optima are known
+    if (basin_registry_) {
+        for (StartResult &result : completed_results) {
+            if (!result.is_terminated_early) {
+                result.basin = basin_registry_->Add(GetEigenVectorFromAlgLibVector(result.free_fluxes), result.ssr);
+            }
+        }
+        for (StartResult &result : completed_results) {
+            if (result.is_terminated_early) {
+                result.basin =
+                    basin_registry_->FindKnownBasin(GetEigenVectorFromAlgLibVector(result.free_fluxes), result.ssr);
+            }
+        }
+    }
+    std::vector<bool> is_completed(parameters_.total_starts, false);
+    for (const StartResult &result : completed_results) {
+        is_completed[result.start] = true;
+        AddFinishedStart(result);
+    }
+
+    std::vector<size_t> starts(parameters_.total_starts);
+    std::iota(starts.begin(), starts.end(), 0);
+    if (is_prioritized_) {
+        starts = GetPrioritizedStarts();
+    }
+    starts.erase(std::remove_if(starts.begin(), starts.end(), [&is_completed](size_t start) {
+        return is_completed[start];
+    }), starts.end());
+    std::vector<StartResult> results;
+    if (starts.empty()) {
+        results = std::move(completed_results);
+    } else if (parameters_.screening_iterations > 0) {
+        results = RunSuccessiveHalving(starts);
+    } else {
+        results = RunStarts(starts, solver_parameters_, parameters_.use_basin_registry, true);
+        results.insert(results.end(), completed_results.begin(), completed_results.end());
+        std::sort(results.begin(), results.end(), [](const StartResult &lhs, const StartResult &rhs) {
+            return lhs.start < rhs.start;
+        });
+    }
+    const double elapsed_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+
+    double total_start_seconds = 0.0;
+    double best_ssr = std::numeric_limits<double>::infinity();
+    for (const StartResult &result : results) {
+        total_start_seconds += result.seconds;
+        if (!result.is_screened_out && !result.is_cancelled && result.ssr < best_ssr) {
+            best_ssr = result.ssr;
+        }
+    }
+
+    std::cout << "Multistart: " << results.size() << " starts on " << total_workers_ << " workers in "
+              << elapsed_seconds << " seconds, " << results.size() / elapsed_seconds << " starts per second, "
+              << total_start_seconds / std::max<size_t>(1, results.size()) << " seconds per start" << std::endl;
+    std::cout << " best SSR " << best_ssr << " in " << total_start_seconds << " CPU seconds of the starts"
+              << std::endl;
+    if (best_result_) {
+        std::cout << " best SSR so far " << best_result_->ssr << " reached at " << best_seconds_ << " seconds"
+                  << std::endl;
+    }
+    if (deadline_) {
+        const size_t total_cancelled = std::count_if(results.begin(), results.end(), [](const StartResult &result) {
+            return result.is_cancelled;
+        });
+        std::cout << " " << results.size() << " of " << parameters_.total_starts << " starts run in the budget of "
+                  << *parameters_.time_budget << " seconds, " << total_cancelled << " cancelled at the deadline"
+                  << std::endl;
+    }
+    for (size_t worker = 0; worker < total_workers_; ++worker) {
+        std::cout << " worker " << worker << ": " << worker_starts_[worker] << " starts, "
+                  << stolen_starts_[worker] << " stolen" << std::endl;
+    }
+    if (basin_registry_) {
+        PrintBasinRegistryReport(results);
+    }
+    if (warm_start_library) {
+        const WarmStartStatistics run_statistics = warm_start_library->Update(results, start_optima);
+        warm_start_library->Save();
+        PrintWarmStartStatistics(run_statistics, warm_start_library->GetStatistics());
+    }
+
+    return results;
+}
+
+
+std::vector<Eigen::VectorXd> MultistartScheduler::GetBoxStartPoints(const Eigen::VectorXd &lower_bounds,
+                                                                    const Eigen::VectorXd &upper_bounds) const {
+    std::vector<Eigen::VectorXd> points;
+    for (size_t start = 0; start < parameters_.total_starts; ++start) {
+        points.push_back(GetBoxStartPoint(lower_bounds, upper_bounds, GetStartSeed(master_seed_, start)));
+    }
+    return points;
+}
+
+
+void MultistartScheduler::SetTelemetry(Telemetry *telemetry) {
+    telemetry_ = telemetry;
+}
+
+
+std::optional<StartResult> MultistartScheduler::GetBestResult() const {
+    std::lock_guard<std::mutex> lock(best_mutex_);
+    return best_result_;
+}
+
+
+std::vector<StartResult> MultistartScheduler::RunStarts(const std::vector<size_t> &starts,
+                                                        const SolverParameters &solver_parameters,
+                                                        bool use_basin_registry,
+                                                        bool is_final) {
+    // every worker gets a contiguous block of the starts,
+    // the prioritized starts are dealt one by one so every worker begins with the best of them
+    const size_t total_workers = std::max<size_t>(1, std::min(total_workers_, starts.size()));
+    queues_.clear();
+    for (size_t worker = 0; worker < total_workers; ++worker) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < starts.size(); ++i) {
+        const size_t worker = is_prioritized_ ? i % total_workers : i * total_workers / starts.size();
+        queues_[worker]->starts.push_back(starts[i]);
+    }
+    {
+        std::lock_guard<std::mutex> lock(best_mutex_);
+        finished_starts_ = 0;
+        finished_seconds_ = 0.0;
+    }
+
+    is_worker_failed_ = false;
+    std::vector<std::vector<StartResult>> worker_results(total_workers);
+    RunWorkers(total_workers, [&](size_t worker) {
+        RunWorker(worker, solver_parameters, use_basin_registry, is_final, worker_results[worker]);
+    }, &is_worker_failed_);
+
+    std::vector<StartResult> results;
+    for (size_t worker = 0; worker < total_workers; ++worker) {
+        worker_starts_[worker] += worker_results[worker].size();
+        for (StartResult &result : worker_results[worker]) {
+            results.push_back(std::move(result));
+        }
+    }
+    std::sort(results.begin(), results.end(), [](const StartResult &lhs, const StartResult &rhs) {
+        return lhs.start < rhs.start;
+    });
+    return results;
+}
+
+
+// The rungs continue the starts, so a start's iterations, evaluations and seconds are summed over them.
+// The starts converged before the iterations limit don't compete with the running ones, their SSR won't decrease,
+// they wait for the refinement. The basin registry is used only by the refinement, the screening points aren't optima.
+// Once the time budget is spent, the starts keep the results of their last rung
+std::vector<StartResult> MultistartScheduler::RunSuccessiveHalving(std::vector<size_t> starts) {
+    std::vector<StartResult> results(parameters_.total_starts);
+    std::vector<bool> is_run(parameters_.total_starts, false);
+    std::vector<size_t> converged_starts;
+    const size_t halving_factor = std::max(2, parameters_.halving_factor);
+
+    int iterations = parameters_.screening_iterations;
+    for (size_t rung = 0;; ++rung) {
+        const bool is_refinement = starts.size() <= 1 || iterations >= solver_parameters_.max_iterations;
+        SolverParameters solver_parameters = solver_parameters_;
+        if (is_refinement) {
+            starts.insert(starts.end(), converged_starts.begin(), converged_starts.end());
+            if (is_prioritized_) {
+                std::stable_sort(starts.begin(), starts.end(), [&results](size_t lhs, size_t rhs) {
+                    return std::isnan(results[rhs].ssr) ? !std::isnan(results[lhs].ssr) :
+                                                          results[lhs].ssr < results[rhs].ssr;
+                });
+            } else {
+                std::sort(starts.begin(), starts.end());
+            }
+        } else {
+            solver_parameters.max_iterations = iterations;
+            solver_parameters.use_adaptive_tolerance = false;
+            solver_parameters.tight_tolerance = solver_parameters.loose_tolerance;
+        }
+
+        std::vector<size_t> running_starts;
+        const size_t converged_before = converged_starts.size();
+        double best_ssr = std::numeric_limits<double>::infinity();
+        for (StartResult &rung_result : RunStarts(starts, solver_parameters,
+                                                  is_refinement && parameters_.use_basin_registry, is_refinement)) {
+            const size_t start = rung_result.start;
+            if (rung_result.iterations < iterations || rung_result.is_terminated_early) {
+                converged_starts.push_back(start);
+            } else {
+                running_starts.push_back(start);
+            }
+            StartResult &result = results[start];
+            if (rung > 0) {
+                rung_result.iterations += result.iterations;
+                rung_result.evaluations += result.evaluations;
+                rung_result.seconds += result.seconds;
+            }
+            continued_points_[start] = Eigen::Map<const Eigen::VectorXd>(rung_result.free_fluxes.getcontent(),
+                                                                        rung_result.free_fluxes.length());
+            best_ssr = std::min(best_ssr, rung_result.ssr);
+            result = std::move(rung_result);
+            is_run[start] = true;
+        }
+        if (is_refinement) {
+            std::cout << "Successive halving refinement: " << starts.size() << " starts, best SSR " << best_ssr
+                      << std::endl;
+            break;
+        }
+        std::cout << "Successive halving rung " << rung << ": " << starts.size() << " starts, " << iterations
+                  << " iterations, " << converged_starts.size() - converged_before << " converged, best SSR "
+                  << best_ssr << std::endl;
+        if (IsBudgetSpent()) {
+            std::cout << "Successive halving: the time budget is spent after rung " << rung << std::endl;
+            if (start_log_) {
+                for (size_t start = 0; start < results.size(); ++start) {
+                    if (is_run[start] && !results[start].is_screened_out) {
+                        start_log_->Append(results[start]);
+                    }
+                }
+            }
+            break;
+        }
+
+        // NaN SSRs go last
+        std::sort(running_starts.begin(), running_starts.end(), [&results](size_t lhs, size_t rhs) {
+            return std::isnan(results[rhs].ssr) ? !std::isnan(results[lhs].ssr) : results[lhs].ssr < results[rhs].ssr;
+        });
+        const size_t promoted = (running_starts.size() + halving_factor - 1) / halving_factor;
+        for (size_t i = promoted; i < running_starts.size(); ++i) {
+            results[running_starts[i]].is_screened_out = true;
+            if (start_log_) {
+                start_log_->Append(results[running_starts[i]]);
+            }
+        }
+        running_starts.resize(promoted);
+        starts = running_starts;
+        iterations *= halving_factor;
+    }
+
+    std::vector<StartResult> run_results;
+    for (size_t start = 0; start < results.size(); ++start) {
+        if (is_run[start]) {
+            run_results.push_back(std::move(results[start]));
+        }
+    }
+    return run_results;
+}
+
+
+std::vector<size_t> MultistartScheduler::GetPrioritizedStarts() {
+    std::vector<double> ssr(parameters_.total_starts, std::numeric_limits<double>::infinity());
+    next_start_ = 0;
+    RunWorkers(total_workers_, [this, &ssr](size_t worker) {
+        RunRankingWorker(worker, ssr);
+    });
+
+    std::vector<size_t> starts(parameters_.total_starts);
+    std::iota(starts.begin(), starts.end(), 0);
+    std::stable_sort(starts.begin(), starts.end(), [&ssr](size_t lhs, size_t rhs) {
+        return ssr[lhs] < ssr[rhs];
+    });
+    std::cout << "Multistart: the starts are prioritized by the SSR of their start points, from "
+              << ssr[starts.front()] << " to " << ssr[starts.back()] << ", in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count()
+              << " seconds" << std::endl;
+    return starts;
+}
+
+
+void MultistartScheduler::RunRankingWorker(size_t worker, std::vector<double> &ssr) {
+    if (parameters_.pin_workers) {
+        PinThreadToCore(worker);
+    }
+    Solver solver(problem_, generator_, solver_parameters_);
+    Eigen::VectorXd residuals;
+    for (size_t start = next_start_++; start < ssr.size(); start = next_start_++) {
+        solver.CalculateResiduals(start_points_[start], residuals);
+        const double start_ssr = residuals.squaredNorm();
+        if (std::isfinite(start_ssr)) {
+            ssr[start] = start_ssr;
+        }
+    }
+}
+
+
+void MultistartScheduler::RunWorker(size_t worker, const SolverParameters &solver_parameters, bool use_basin_registry,
+                                    bool is_final, std::vector<StartResult> &results) {
+    if (parameters_.pin_workers) {
+        PinThreadToCore(worker);
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+
+    Solver solver(problem_, generator_, solver_parameters);
+    if (use_basin_registry) {
+        solver.SetBasinRegistry(basin_registry_.get());
+    }
+    solver.SetDeadline(deadline_);
+    solver.SetTelemetry(telemetry_, worker);
+    for (std::optional<size_t> start = GetNextStart(worker); start; start = GetNextStart(worker)) {
+        const uint64_t seed = GetStartSeed(master_seed_, *start);
+        solver.SetStepTolerance(is_warm_start_[*start] ? parameters_.warm_start_epsx : solver_parameters.epsx);
+        if (continued_points_[*start]) {
+            results.push_back(solver.SolveFromStart(*start, seed, continued_points_[*start]));
+        } else if (start_points_.empty()) {
+            results.push_back(solver.SolveFromStart(*start, seed));
+        } else {
+            results.push_back(solver.SolveFromStart(*start, seed, start_points_[*start]));
+        }
+        AddFinishedStart(results.back());
+        if (start_log_ && is_final) {
+            start_log_->Append(results.back());
+        }
+    }
+
+    if (telemetry_) {
+        WorkerTelemetry worker_telemetry;
+        worker_telemetry.starts = results.size();
+        for (const StartResult &result : results) {
+            worker_telemetry.busy_seconds += result.seconds;
+        }
+        worker_telemetry.wall_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        telemetry_->AddWorker(worker, worker_telemetry);
+    }
+}
+
+
+std::optional<size_t> MultistartScheduler::GetNextStart(size_t worker) {
+    if (is_worker_failed_ || IsBudgetSpent()) {
+        return std::nullopt;
+    }
+    {
+        WorkQueue &own_queue = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own_queue.mutex);
+        if (!own_queue.starts.empty()) {
+            const size_t start = own_queue.starts.front();
+            own_queue.starts.pop_front();
+            return start;
+        }
+    }
+
+    for (size_t shift = 1; shift < queues_.size(); ++shift) {
+        WorkQueue &victim_queue = *queues_[(worker + shift) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim_queue.mutex);
+        if (!victim_queue.starts.empty()) {
+            const size_t start = victim_queue.starts.back();
+            victim_queue.starts.pop_back();
+            ++stolen_starts_[worker];
+            return start;
+        }
+    }
+
+    return std::nullopt;
+}
+
+
+void MultistartScheduler::AddFinishedStart(const StartResult &result) {
+    const double elapsed_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+    std::lock_guard<std::mutex> lock(best_mutex_);
+    if (!result.is_cancelled) {
+        ++finished_starts_;
+        finished_seconds_ += result.seconds;
+    }
+    // the cancelled starts stopped short of their optima
+    if (!result.is_cancelled && std::isfinite(result.ssr) && (!best_result_ || result.ssr < best_result_->ssr)) {
+        best_result_ = result;
+        best_seconds_ = elapsed_seconds;
+        std::cout << "Multistart: best SSR so far " << result.ssr << " of start " << result.start << " at "
+                  << elapsed_seconds << " seconds" << std::endl;
+    }
+}
+
+
+bool MultistartScheduler::IsBudgetSpent() const {
+    if (!deadline_) {
+        return false;
+    }
+    const double remaining_seconds =
+        std::chrono::duration<double>(*deadline_ - std::chrono::steady_clock::now()).count();
+    std::lock_guard<std::mutex> lock(best_mutex_);
+    const double average_seconds = finished_starts_ > 0 ? finished_seconds_ / finished_starts_ : 0.0;
+    return remaining_seconds <= kLastStartFraction * average_seconds;
+}
+
+
+// The terminated start is assumed to need as many evaluations as the average start converged to the same basin,
+// nothing is saved by the resumed terminated start whose basin isn't found again
+void MultistartScheduler::PrintBasinRegistryReport(const std::vector<StartResult> &results) const {
+    std::vector<size_t> basin_starts(basin_registry_->GetSize());
+    std::vector<size_t> basin_evaluations(basin_registry_->GetSize());
+    size_t total_evaluations = 0;
+    for (const StartResult &result : results) {
+        total_evaluations += result.evaluations;
+        if (!result.is_terminated_early && result.basin) {
+            ++basin_starts[*result.basin];
+            basin_evaluations[*result.basin] += result.evaluations;
+        }
+    }
+
+    size_t total_terminated = 0;
+    double saved_evaluations = 0.0;
+    for (const StartResult &result : results) {
+        if (result.is_terminated_early) {
+            ++total_terminated;
+            if (!result.basin.has_value()) {
+                continue;
+            }
+            const size_t basin = *result.basin;
+            const double average_evaluations =
+                static_cast<double>(basin_evaluations[basin]) / std::max<size_t>(1, basin_starts[basin]);
+            saved_evaluations += std::max(0.0, average_evaluations - result.evaluations);
+        }
+    }
+
+    std::cout << "Basin registry: " << basin_registry_->GetSize() << " optima, " << total_terminated << " of "
+              << results.size() << " starts terminated early, about " << std::lround(saved_evaluations) << " of "
+              << std::lround(saved_evaluations) + total_evaluations << " evaluations saved" << std::endl;
+}
+
+
+void PinThreadToCore(size_t core) {
+#ifdef __linux__
+    const unsigned int total_cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core % total_cores, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+#else
+    static_cast<void>(core);
+#endif
+}
+} // namespace khnum
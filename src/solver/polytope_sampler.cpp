@@ -0,0 +1,271 @@
+#include "solver/polytope_sampler.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <glpk/glpk.h>
+
+
+namespace khnum {
+PolytopeSampler::PolytopeSampler(const Eigen::VectorXd &lower_bounds, const Eigen::VectorXd &upper_bounds,
+                                 const Matrix &constraints, const Eigen::VectorXd &right_part) :
+    fixed_point_{lower_bounds} {
+    for (int i = 0; i < lower_bounds.size(); ++i) {
+        if (upper_bounds(i) > lower_bounds(i)) {
+            free_coordinates_.push_back(i);
+        }
+    }
+    const int dimension = free_coordinates_.size();
+
+    // fixed coordinates are moved to the right part
+    std::vector<Eigen::VectorXd> rows;
+    std::vector<double> rows_right_part;
+    for (int row = 0; row < constraints.rows(); ++row) {
+        Eigen::VectorXd free_part(dimension);
+        double fixed_part = constraints.row(row).dot(fixed_point_);
+        for (int i = 0; i < dimension; ++i) {
+            free_part(i) = constraints(row, free_coordinates_[i]);
+            fixed_part -= free_part(i) * fixed_point_(free_coordinates_[i]);
+        }
+        if (free_part.isZero()) {
+            if (fixed_part > right_part(row)) {
+                throw std::runtime_error("Fixed fluxes violate the constraints");
+            }
+            continue;
+        }
+        rows.push_back(free_part);
+        rows_right_part.push_back(right_part(row) - fixed_part);
+    }
+    for (int i = 0; i < dimension; ++i) {
+        rows.push_back(Eigen::VectorXd::Unit(dimension, i));
+        rows_right_part.push_back(upper_bounds(free_coordinates_[i]));
+        rows.push_back(-Eigen::VectorXd::Unit(dimension, i));
+        rows_right_part.push_back(-lower_bounds(free_coordinates_[i]));
+    }
+
+    inequalities_.resize(rows.size(), dimension);
+    inequalities_right_part_.resize(rows.size());
+    for (size_t row = 0; row < rows.size(); ++row) {
+        inequalities_.row(row) = rows[row].transpose();
+        inequalities_right_part_(row) = rows_right_part[row];
+    }
+
+    SolveLinearProblems();
+    full_center_ = GetFullPoint(center_);
+    current_point_ = center_;
+    rounding_ = Matrix::Identity(dimension, dimension);
+    thinning_ = std::max(1, 10 * dimension);
+    Round();
+}
+
+
+std::vector<Eigen::VectorXd> PolytopeSampler::Sample(size_t count, std::mt19937 &random_source) {
+    std::vector<Eigen::VectorXd> points;
+    points.reserve(count);
+    for (size_t point = 0; point < count; ++point) {
+        for (size_t step = 0; step < thinning_; ++step) {
+            MakeHitAndRunStep(random_source);
+        }
+        points.push_back(GetFullPoint(current_point_));
+    }
+    return points;
+}
+
+
+std::vector<Eigen::VectorXd> PolytopeSampler::SampleLowDiscrepancy(size_t count, std::mt19937 &random_source) {
+    const size_t max_tries_per_point = 1000;
+    const int dimension = free_coordinates_.size();
+
+    std::vector<int> primes;
+    for (int candidate = 2; static_cast<int>(primes.size()) < dimension; ++candidate) {
+        if (std::none_of(primes.begin(), primes.end(), [candidate](int prime) { return candidate % prime == 0; })) {
+            primes.push_back(candidate);
+        }
+    }
+
+    std::vector<Eigen::VectorXd> points;
+    points.reserve(count);
+    Eigen::VectorXd candidate(dimension);
+    // the first point of the sequence is the corner of the box
+    for (size_t index = 1; points.size() < count && index <= max_tries_per_point * count; ++index) {
+        for (int i = 0; i < dimension; ++i) {
+            candidate(i) = bounding_box_lower_(i) +
+                GetRadicalInverse(index, primes[i]) * (bounding_box_upper_(i) - bounding_box_lower_(i));
+        }
+        if ((inequalities_ * candidate - inequalities_right_part_).maxCoeff() <= 0.0) {
+            points.push_back(GetFullPoint(candidate));
+        }
+    }
+
+    for (Eigen::VectorXd &point : Sample(count - points.size(), random_source)) {
+        points.push_back(std::move(point));
+    }
+    return points;
+}
+
+
+const Eigen::VectorXd &PolytopeSampler::GetCenter() const {
+    return full_center_;
+}
+
+
+// maximize r
+// subject to a_i * y + |a_i| * r <= b_i for every inequality
+// The bounding box is found with r = 0 by minimizing and maximizing every coordinate
+void PolytopeSampler::SolveLinearProblems() {
+    const int dimension = free_coordinates_.size();
+    const int radius_column = dimension + 1;
+
+    glp_term_out(GLP_OFF);
+    glp_prob *linear_problem = glp_create_prob();
+    glp_add_cols(linear_problem, dimension + 1);
+    for (int i = 0; i < dimension; ++i) {
+        glp_set_col_bnds(linear_problem, i + 1, GLP_FR, 0.0, 0.0);
+    }
+    glp_set_col_bnds(linear_problem, radius_column, GLP_LO, 0.0, 0.0);
+
+    glp_add_rows(linear_problem, inequalities_.rows());
+    std::vector<int> row_index = {0};
+    std::vector<int> col_index = {0};
+    std::vector<double> coefficients = {0.0};
+    for (int row = 0; row < inequalities_.rows(); ++row) {
+        glp_set_row_bnds(linear_problem, row + 1, GLP_UP, 0.0, inequalities_right_part_(row));
+        for (int col = 0; col < dimension; ++col) {
+            if (inequalities_(row, col) != 0.0) {
+                row_index.push_back(row + 1);
+                col_index.push_back(col + 1);
+                coefficients.push_back(inequalities_(row, col));
+            }
+        }
+        row_index.push_back(row + 1);
+        col_index.push_back(radius_column);
+        coefficients.push_back(inequalities_.row(row).norm());
+    }
+    glp_load_matrix(linear_problem, coefficients.size() - 1, row_index.data(), col_index.data(),
+                    coefficients.data());
+
+    glp_set_obj_coef(linear_problem, radius_column, 1.0);
+    glp_set_obj_dir(linear_problem, GLP_MAX);
+    if (glp_simplex(linear_problem, NULL) != 0 || glp_get_status(linear_problem) != GLP_OPT) {
+        glp_delete_prob(linear_problem);
+        throw std::runtime_error("Can't find a feasible point of the free fluxes");
+    }
+    const double radius = glp_get_col_prim(linear_problem, radius_column);
+    center_.resize(dimension);
+    for (int i = 0; i < dimension; ++i) {
+        center_(i) = glp_get_col_prim(linear_problem, i + 1);
+    }
+    if (radius <= 1.e-9 * (1.0 + center_.norm())) {
+        glp_delete_prob(linear_problem);
+        throw std::runtime_error("The feasible set of the free fluxes has no interior");
+    }
+
+    glp_set_obj_coef(linear_problem, radius_column, 0.0);
+    glp_set_col_bnds(linear_problem, radius_column, GLP_FX, 0.0, 0.0);
+    bounding_box_lower_.resize(dimension);
+    bounding_box_upper_.resize(dimension);
+    for (int i = 0; i < dimension; ++i) {
+        glp_set_obj_coef(linear_problem, i + 1, 1.0);
+        for (int direction : {GLP_MIN, GLP_MAX}) {
+            glp_set_obj_dir(linear_problem, direction);
+            if (glp_simplex(linear_problem, NULL) != 0 || glp_get_status(linear_problem) != GLP_OPT) {
+                glp_delete_prob(linear_problem);
+                throw std::runtime_error("Can't find the bounding box of the free fluxes, the free flux " +
+                                         std::to_string(i) + " is unbounded or the LP failed");
+            }
+            (direction == GLP_MIN ? bounding_box_lower_ : bounding_box_upper_)(i) = glp_get_obj_val(linear_problem);
+        }
+        glp_set_obj_coef(linear_problem, i + 1, 0.0);
+    }
+
+    glp_delete_prob(linear_problem);
+}
+
+
+void PolytopeSampler::Round() {
+    const int total_rounds = 3;
+    const int dimension = free_coordinates_.size();
+    const size_t total_steps = std::max(1000, 50 * dimension);
+
+    // the rounding doesn't depend on the starts' seeds
+    std::mt19937 random_source(0);
+    for (int round = 0; round < total_rounds; ++round) {
+        Matrix samples(dimension, total_steps);
+        for (size_t step = 0; step < total_steps; ++step) {
+            MakeHitAndRunStep(random_source);
+            samples.col(step) = current_point_;
+        }
+
+        const Eigen::VectorXd mean = samples.rowwise().mean();
+        samples.colwise() -= mean;
+        Matrix covariance = samples * samples.transpose() / static_cast<double>(total_steps - 1);
+        const double regularization = 1.e-10 * covariance.trace() / dimension;
+        covariance.diagonal().array() += regularization;
+
+        const Eigen::LLT<Matrix> decomposition(covariance);
+        if (decomposition.info() != Eigen::Success) {
+            break;
+        }
+        rounding_ = decomposition.matrixL();
+    }
+}
+
+
+void PolytopeSampler::MakeHitAndRunStep(std::mt19937 &random_source) {
+    std::normal_distribution<> get_normal(0.0, 1.0);
+    const int dimension = current_point_.size();
+    if (dimension == 0) {
+        return;
+    }
+
+    Eigen::VectorXd direction(dimension);
+    for (int i = 0; i < dimension; ++i) {
+        direction(i) = get_normal(random_source);
+    }
+    direction = rounding_ * direction.normalized();
+
+    const Eigen::VectorXd rates = inequalities_ * direction;
+    const Eigen::VectorXd slacks =
+        (inequalities_right_part_ - inequalities_ * current_point_).cwiseMax(0.0);
+
+    // the chord is current_point + t * direction with t in [min_step, max_step]
+    double min_step = -std::numeric_limits<double>::infinity();
+    double max_step = std::numeric_limits<double>::infinity();
+    const double epsilon = 1.e-14 * direction.norm();
+    for (int row = 0; row < rates.size(); ++row) {
+        if (rates(row) > epsilon) {
+            max_step = std::min(max_step, slacks(row) / rates(row));
+        } else if (rates(row) < -epsilon) {
+            min_step = std::max(min_step, slacks(row) / rates(row));
+        }
+    }
+    if (!(min_step < max_step) || std::isinf(min_step) || std::isinf(max_step)) {
+        return;
+    }
+
+    std::uniform_real_distribution<> get_step(min_step, max_step);
+    current_point_ += get_step(random_source) * direction;
+}
+
+
+Eigen::VectorXd PolytopeSampler::GetFullPoint(const Eigen::VectorXd &free_point) const {
+    Eigen::VectorXd point = fixed_point_;
+    for (size_t i = 0; i < free_coordinates_.size(); ++i) {
+        point(free_coordinates_[i]) = free_point(i);
+    }
+    return point;
+}
+
+
+double GetRadicalInverse(size_t index, int base) {
+    double result = 0.0;
+    double digit_weight = 1.0 / base;
+    while (index > 0) {
+        result += digit_weight * (index % base);
+        index /= base;
+        digit_weight /= base;
+    }
+    return result;
+}
+} // namespace khnum
@@ -3,23 +3,74 @@
 #include <random>
 #include <chrono>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
 #include "alglib/optimization.h"
 
 #include "simulator/simulator.h"
 #include "utilities/debug_utills/debug_prints.h"
 #include "utilities/get_eigen_vec_from_alglib_vec.h"
 #include "simulator/generator.h"
+#include "solver/polytope_sampler.h"
+#include "utilities/random_source.h"
 
 
 
 namespace khnum {
+uint64_t GetStartSeed(uint64_t master_seed, size_t start) {
+    uint64_t seed = master_seed + (start + 1) * 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+    return seed ^ (seed >> 31);
+}
+
+
+Eigen::VectorXd GetBoxStartPoint(const Eigen::VectorXd &lower_bounds, const Eigen::VectorXd &upper_bounds,
+                                 uint64_t seed) {
+    std::mt19937 random_source = CreateRandomSource(seed);
+    std::uniform_real_distribution<> get_random_point(0.0, 1.0);
+    Eigen::VectorXd point(lower_bounds.size());
+    for (int i = 0; i < point.size(); ++i) {
+        point(i) = lower_bounds(i) + get_random_point(random_source) * (upper_bounds(i) - lower_bounds(i));
+    }
+    return point;
+}
+
+
+std::vector<Eigen::VectorXd> SampleStartPoints(const Eigen::VectorXd &lower_bounds,
+                                               const Eigen::VectorXd &upper_bounds,
+                                               const LinearConstraints &constraints,
+                                               StartSampling sampling,
+                                               size_t total_starts,
+                                               uint64_t master_seed) {
+    if (sampling == StartSampling::box) {
+        return {};
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    PolytopeSampler sampler(lower_bounds, upper_bounds, constraints.matrix, constraints.right_part);
+    std::mt19937 random_source = CreateRandomSource(master_seed);
+    std::vector<Eigen::VectorXd> points = sampling == StartSampling::halton ?
+        sampler.SampleLowDiscrepancy(total_starts, random_source) :
+        sampler.Sample(total_starts, random_source);
+
+    std::cout << "Sampled " << points.size() << " start points inside the constraints in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+              << " seconds" << std::endl;
+    return points;
+}
 
 
-Solver::Solver(const Problem &problem, const SimulatorGenerator &generator) {
+Solver::Solver(const Problem &problem, const SimulatorGenerator &generator,
+               const SolverParameters &parameters) : parameters_{parameters} {
     new_simulator_.emplace(generator.Generate());
     reactions_num_ = problem.reactions_total;
     nullspace_ = problem.nullspace;
+    constraints_ = problem.constraints;
+    equalities_.matrix.resize(0, problem.nullspace.cols());
     measured_mids_ = problem.measurements;
+    new_simulator_->SetMeasurements(measured_mids_);
     measurements_count_ = problem.measurements_count;
     use_analytic_gradient_ = problem.use_analytic_jacobian;
     reactions_ = problem.reactions;
@@ -30,6 +81,9 @@ Solver::Solver(const Problem &problem, const SimulatorGenerator &generator) {
     iteration_ = 0;
     iteration_total_ = 30;
 
+    SetSimulationTolerance(parameters_.tight_tolerance);
+    previous_ssr_ = -1.0;
+
     lower_bounds_.setlength(nullity_);
     upper_bounds_.setlength(nullity_);
     for (int i = 0; i < nullity_; ++i) {
@@ -37,6 +91,18 @@ Solver::Solver(const Problem &problem, const SimulatorGenerator &generator) {
         upper_bounds_[i] = problem.upper_bounds[i];
     }
 
+    std::vector<int> transformed_fluxes;
+    if (parameters_.use_exchange_transform) {
+        if (parameters_.optimizer == Optimizer::geodesic_lm) {
+            throw std::runtime_error("The exchange transform can't be used with the geodesic acceleration");
+        }
+        transformed_fluxes = GetTransformedExchangeFluxes(problem);
+    }
+    exchange_transform_ = ExchangeTransform(transformed_fluxes, parameters_.exchange_scale);
+    variable_lower_bounds_ = GetEigenVectorFromAlgLibVector(lower_bounds_);
+    variable_upper_bounds_ = GetEigenVectorFromAlgLibVector(upper_bounds_);
+    exchange_transform_.ToVariables(variable_lower_bounds_);
+    exchange_transform_.ToVariables(variable_upper_bounds_);
 }
 
 
@@ -45,23 +111,74 @@ std::vector<alglib::real_1d_array> Solver::GetResult() {
 }
 
 
+void Solver::SetBasinRegistry(BasinRegistry *registry) {
+    basin_registry_ = registry;
+    if (is_state_created_) {
+        alglib::minlmsetxrep(state_, IsReportNeeded());
+    }
+}
+
+
+void Solver::SetDeadline(std::optional<std::chrono::steady_clock::time_point> deadline) {
+    deadline_ = deadline;
+    if (is_state_created_) {
+        alglib::minlmsetxrep(state_, IsReportNeeded());
+    }
+}
+
+
+void Solver::SetTelemetry(Telemetry *telemetry, size_t worker) {
+    telemetry_ = telemetry;
+    telemetry_worker_ = worker;
+    if (is_state_created_) {
+        alglib::minlmsetxrep(state_, IsReportNeeded());
+    }
+}
+
+
+void Solver::SetStepTolerance(double epsx) {
+    parameters_.epsx = epsx;
+    if (is_state_created_) {
+        alglib::minlmsetcond(state_, parameters_.epsx, parameters_.max_iterations);
+    }
+    if (native_optimizer_) {
+        native_optimizer_->SetStepTolerance(parameters_.epsx);
+    }
+}
+
+
+void Solver::CalculateResiduals(const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals) {
+    Eigen::VectorXd variables = free_fluxes;
+    exchange_transform_.ToVariables(variables);
+    residuals.resize(measurements_count_);
+    new_simulator_->CalculateResiduals(CalculateAllFluxesFromFree(variables), residuals, nullptr);
+}
+
+
+void Solver::CalculateJacobian(const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals, Matrix &jacobian) {
+    Eigen::VectorXd variables = free_fluxes;
+    exchange_transform_.ToVariables(variables);
+    residuals.resize(measurements_count_);
+    jacobian.resize(measurements_count_, nullity_);
+    JacobianMap jacobian_map(jacobian.data(), measurements_count_, nullity_,
+                             Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(measurements_count_, 1));
+    new_simulator_->CalculateResiduals(CalculateAllFluxesFromFree(variables), residuals, &jacobian_map);
+}
+
+
 void Solver::Solve() {
-    std::random_device randomizer;
-    std::mt19937 random_source(randomizer());
+    const uint64_t master_seed = parameters_.seed ? *parameters_.seed : std::random_device()();
 
     std::chrono::time_point<std::chrono::system_clock> start, end;
     start = std::chrono::system_clock::now();
+    const std::vector<Eigen::VectorXd> start_points =
+        SampleStartPoints(GetEigenVectorFromAlgLibVector(lower_bounds_), GetEigenVectorFromAlgLibVector(upper_bounds_),
+                          constraints_, parameters_.start_sampling, iteration_total_, master_seed);
     for (iteration_ = 0; iteration_ < iteration_total_; ++iteration_) {
-        GenerateInitialPoints(random_source);
-        if (iteration_ == 0) {
-            SetOptimizationParameters();
-        } else {
-            alglib::minlmrestartfrom(state_, free_fluxes_);
-        }
-
-        alglib::real_1d_array new_solution = RunOptimization();
-
-        all_solutions_.emplace_back(new_solution);
+        StartResult result = start_points.empty() ?
+            SolveFromStart(iteration_, GetStartSeed(master_seed, iteration_)) :
+            SolveFromStart(iteration_, GetStartSeed(master_seed, iteration_), start_points[iteration_]);
+        all_solutions_.emplace_back(result.free_fluxes);
     }
     end = std::chrono::system_clock::now();
     double elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -71,23 +188,72 @@ void Solver::Solve() {
 
     std::cout << "Average time: " << static_cast<double>(elapsed_milliseconds) / iteration_total_
        << " seconds per iteration" << std::endl;
+    std::cout << "Average linear solver iterations: "
+              << static_cast<double>(total_linear_solver_iterations_) / iteration_total_
+              << " per fit" << std::endl;
 }
 
 
-void Solver::GenerateInitialPoints(std::mt19937 &random_source) {
-    std::uniform_real_distribution<> get_random_point(0.0, 1.0);
+StartResult Solver::SolveFromStart(size_t start, uint64_t seed, const std::optional<Eigen::VectorXd> &initial_point) {
+    const auto start_time = std::chrono::steady_clock::now();
 
+    const Eigen::VectorXd point = initial_point ? *initial_point :
+        GetBoxStartPoint(GetEigenVectorFromAlgLibVector(lower_bounds_), GetEigenVectorFromAlgLibVector(upper_bounds_),
+                         seed);
     for (int i = 0; i < nullity_; ++i) {
-        free_fluxes_[i] = lower_bounds_[i] + get_random_point(random_source) * (upper_bounds_[i] - lower_bounds_[i]);
+        free_fluxes_[i] = point(i);
     }
-
     PrintStartMessage();
+    exchange_transform_.ToVariables(Eigen::Map<Eigen::VectorXd>(free_fluxes_.getcontent(), nullity_));
+    if (parameters_.optimizer == Optimizer::alglib_lm) {
+        if (!is_state_created_) {
+            SetOptimizationParameters();
+            is_state_created_ = true;
+        } else {
+            alglib::minlmrestartfrom(state_, free_fluxes_);
+        }
+    }
+
+    reports_since_basin_check_ = 0;
+    basin_hits_ = 0;
+    is_terminated_early_ = false;
+    is_cancelled_ = false;
+    basin_.reset();
+    simulation_seconds_ = 0.0;
+    ssr_trajectory_.clear();
+    const size_t linear_solver_iterations_before = new_simulator_->GetLinearSolverIterations();
+    const size_t linear_solver_failures_before = new_simulator_->GetLinearSolverFailures();
+
+    StartResult result;
+    result.start = start;
+    result.seed = seed;
+    result.free_fluxes = RunOptimization();
+    exchange_transform_.ToFluxes(Eigen::Map<Eigen::VectorXd>(result.free_fluxes.getcontent(), nullity_));
+    result.ssr = final_ssr_;
+    result.iterations = final_steps_;
+    result.evaluations = final_evaluations_;
+    result.is_terminated_early = is_terminated_early_;
+    result.is_cancelled = is_cancelled_;
+    if (basin_registry_ && !is_terminated_early_ && !is_cancelled_) {
+        basin_ = basin_registry_->Add(GetEigenVectorFromAlgLibVector(result.free_fluxes), result.ssr);
+    }
+    result.basin = basin_;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (telemetry_) {
+        telemetry_->AddStart({start, telemetry_worker_, result.iterations, final_residual_evaluations_,
+                              final_jacobian_evaluations_,
+                              new_simulator_->GetLinearSolverIterations() - linear_solver_iterations_before,
+                              new_simulator_->GetLinearSolverFailures() - linear_solver_failures_before,
+                              simulation_seconds_, result.seconds, result.ssr, std::move(ssr_trajectory_)});
+        ssr_trajectory_.clear();
+    }
+    return result;
 }
 
 
 void Solver::SetOptimizationParameters() {
-    alglib::ae_int_t maxits = 500;
-    const double epsx = 0.0001;
+    alglib::ae_int_t maxits = parameters_.max_iterations;
+    const double epsx = parameters_.epsx;
 
     if (use_analytic_gradient_) {
         alglib::minlmcreatevj(nullity_, measurements_count_, free_fluxes_, state_);
@@ -98,31 +264,98 @@ void Solver::SetOptimizationParameters() {
 
     alglib::minlmsetacctype(state_, 1);
     alglib::minlmsetcond(state_, epsx, maxits);
-    alglib::minlmsetbc(state_, lower_bounds_, upper_bounds_);
+    alglib::real_1d_array variable_lower_bounds;
+    alglib::real_1d_array variable_upper_bounds;
+    variable_lower_bounds.setcontent(nullity_, variable_lower_bounds_.data());
+    variable_upper_bounds.setcontent(nullity_, variable_upper_bounds_.data());
+    alglib::minlmsetbc(state_, variable_lower_bounds, variable_upper_bounds);
+    if (parameters_.use_variable_scaling) {
+        const Eigen::VectorXd scales = GetVariableScales();
+        alglib::real_1d_array variable_scales;
+        variable_scales.setcontent(nullity_, scales.data());
+        alglib::minlmsetscale(state_, variable_scales);
+    }
+    alglib::minlmsetxrep(state_, IsReportNeeded());
 
     SetConstraints();
 }
 
 
 // Set constraints that Vdep = -nullspace * Vfree > 0
-// This is the same as nullspace * VFree < 0
+// This is the same as nullspace * VFree < 0, the presolved equivalent rows are used
 void Solver::SetConstraints() {
+    const Matrix &matrix = constraints_.matrix;
+    const int total_rows = matrix.rows() + equalities_.matrix.rows();
     alglib::real_2d_array constraint;
-    constraint.setlength(nullspace_.rows(), nullspace_.cols() + 1);
-    for (int row = 0; row < nullspace_.rows(); ++row) {
-        for (int col = 0; col < nullspace_.cols(); ++col) {
-            constraint(row, col) = nullspace_(row, col);
+    constraint.setlength(total_rows, nullity_ + 1);
+    alglib::integer_1d_array types;
+    types.setlength(total_rows);
+    for (int row = 0; row < total_rows; ++row) {
+        const bool is_equality = row >= matrix.rows();
+        const int source_row = is_equality ? row - matrix.rows() : row;
+        const Matrix &source = is_equality ? equalities_.matrix : matrix;
+        for (int col = 0; col < nullity_; ++col) {
+            constraint(row, col) = source(source_row, col);
         }
-        constraint(row, nullspace_.cols()) = 0;
+        constraint(row, nullity_) = is_equality ? equalities_.right_part(source_row)
+                                                : constraints_.right_part(source_row);
+        types[row] = is_equality ? 0 : -1;
     }
 
-    alglib::integer_1d_array types;
-    types.setlength(nullspace_.rows());
-    for (int i = 0; i < nullspace_.rows(); ++i) {
-        types[i] = -1;
+    alglib::minlmsetlc(state_, constraint, types);
+}
+
+
+void Solver::SetNativeConstraints() {
+    const int total_inequalities = constraints_.matrix.rows();
+    const int total_equalities = equalities_.matrix.rows();
+    Matrix matrix(total_inequalities + 2 * total_equalities, nullity_);
+    Eigen::VectorXd right_part(matrix.rows());
+    matrix.topRows(total_inequalities) = constraints_.matrix;
+    matrix.middleRows(total_inequalities, total_equalities) = equalities_.matrix;
+    matrix.bottomRows(total_equalities) = -equalities_.matrix;
+    right_part.head(total_inequalities) = constraints_.right_part;
+    right_part.segment(total_inequalities, total_equalities) = equalities_.right_part;
+    right_part.tail(total_equalities) = -equalities_.right_part;
+    native_optimizer_->SetInequalityConstraints(matrix, right_part);
+}
+
+
+void Solver::PinFlux(const Eigen::VectorXd &coefficients, double value) {
+    if (!exchange_transform_.IsEmpty()) {
+        throw std::runtime_error("A flux can't be pinned with the exchange transform");
     }
+    equalities_.matrix = coefficients.transpose();
+    equalities_.right_part = Eigen::VectorXd::Constant(1, value);
+    if (is_state_created_) {
+        SetConstraints();
+    }
+    if (native_optimizer_) {
+        SetNativeConstraints();
+    }
+}
 
-    alglib::minlmsetlc(state_, constraint, types);
+
+void Solver::UnpinFlux() {
+    equalities_.matrix.resize(0, nullity_);
+    equalities_.right_part.resize(0);
+    if (is_state_created_) {
+        SetConstraints();
+    }
+    if (native_optimizer_) {
+        SetNativeConstraints();
+    }
+}
+
+
+void Solver::SetMeasuredValues(const Eigen::VectorXd &measured_values) {
+    new_simulator_->SetMeasuredValues(measured_values);
+}
+
+
+void Solver::SetMeasurements(const std::vector<Measurement> &measurements) {
+    measured_mids_ = measurements;
+    new_simulator_->SetMeasurements(measured_mids_);
 }
 
 
@@ -137,8 +370,52 @@ void Solver::PrintStartMessage() {
 
 
 alglib::real_1d_array Solver::RunOptimization() {
+    if (parameters_.optimizer != Optimizer::alglib_lm) {
+        return RunNativeOptimization();
+    }
+
+    const size_t linear_solver_iterations_before = new_simulator_->GetLinearSolverIterations();
+    if (parameters_.use_adaptive_tolerance) {
+        SetSimulationTolerance(parameters_.loose_tolerance);
+        previous_ssr_ = -1.0;
+    }
+
+    Optimize();
+
+    alglib::real_1d_array final_free_fluxes;
+    alglib::minlmresults(state_, final_free_fluxes, report_);
+    int total_steps = report_.iterationscount;
+    final_evaluations_ = report_.nfunc + report_.njac;
+    final_residual_evaluations_ = report_.nfunc;
+    final_jacobian_evaluations_ = report_.njac;
+
+    // The steps were accepted comparing SSRs simulated with the loose tolerance,
+    // so the solution is polished at full accuracy
+    if (parameters_.use_adaptive_tolerance && simulation_tolerance_ > parameters_.tight_tolerance &&
+        !is_terminated_early_ && !is_cancelled_) {
+        SetSimulationTolerance(parameters_.tight_tolerance);
+        alglib::minlmrestartfrom(state_, final_free_fluxes);
+        Optimize();
+        alglib::minlmresults(state_, final_free_fluxes, report_);
+        total_steps += report_.iterationscount;
+        final_evaluations_ += report_.nfunc + report_.njac;
+        final_residual_evaluations_ += report_.nfunc;
+        final_jacobian_evaluations_ += report_.njac;
+    }
+
+    const size_t linear_solver_iterations =
+        new_simulator_->GetLinearSolverIterations() - linear_solver_iterations_before;
+    total_linear_solver_iterations_ += linear_solver_iterations;
+
+    PrintFinalMessage(final_free_fluxes, total_steps, linear_solver_iterations);
+
+    return final_free_fluxes;
+}
+
+
+void Solver::Optimize() {
     if (use_analytic_gradient_) {
-        alglib::minlmoptimize(state_, AlglibCallback, JacobianCallback, nullptr, this, alglib::xdefault);
+        alglib::minlmoptimize(state_, AlglibCallback, JacobianCallback, ReportCallback, this, alglib::xdefault);
 
         alglib::optguardreport ogrep;
         alglib::minlmoptguardresults(state_, ogrep);
@@ -166,117 +443,270 @@ alglib::real_1d_array Solver::RunOptimization() {
             std::cout << std::endl;
         }
     } else {
-        alglib::minlmoptimize(state_, AlglibCallback, nullptr, this, alglib::xdefault);
+        alglib::minlmoptimize(state_, AlglibCallback, ReportCallback, this, alglib::xdefault);
+    }
+}
+
+
+alglib::real_1d_array Solver::RunNativeOptimization() {
+    const size_t linear_solver_iterations_before = new_simulator_->GetLinearSolverIterations();
+
+    if (!native_optimizer_) {
+        CreateNativeOptimizer();
     }
+    LevenbergMarquardt &optimizer = *native_optimizer_;
+    const Eigen::VectorXd solution = optimizer.Optimize(GetEigenVectorFromAlgLibVector(free_fluxes_));
 
     alglib::real_1d_array final_free_fluxes;
-    alglib::minlmresults(state_, final_free_fluxes, report_);
+    final_free_fluxes.setlength(nullity_);
+    for (int i = 0; i < nullity_; ++i) {
+        final_free_fluxes[i] = solution(i);
+    }
+
+    const size_t linear_solver_iterations =
+        new_simulator_->GetLinearSolverIterations() - linear_solver_iterations_before;
+    total_linear_solver_iterations_ += linear_solver_iterations;
 
-    PrintFinalMessage(final_free_fluxes);
+    const LevenbergMarquardtReport &report = optimizer.GetReport();
+    final_evaluations_ = report.residual_evaluations + report.jacobian_evaluations;
+    final_residual_evaluations_ = report.residual_evaluations;
+    final_jacobian_evaluations_ = report.jacobian_evaluations;
+    PrintFinalMessage(final_free_fluxes, report.iterations, linear_solver_iterations);
 
     return final_free_fluxes;
 }
 
+
+void Solver::CreateNativeOptimizer() {
+    LeastSquaresFunctions functions;
+    functions.residuals = [this](const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals) {
+        ScopedTimer timer(GetSimulationTimer());
+        residuals.resize(measurements_count_);
+        new_simulator_->CalculateResiduals(CalculateAllFluxesFromFree(free_fluxes), residuals, nullptr);
+    };
+    functions.jacobian = [this](const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals, Matrix &jacobian) {
+        ScopedTimer timer(GetSimulationTimer());
+        residuals.resize(measurements_count_);
+        jacobian.resize(measurements_count_, nullity_);
+        JacobianMap jacobian_map(jacobian.data(), measurements_count_, nullity_,
+                                 Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(measurements_count_, 1));
+        new_simulator_->CalculateResiduals(CalculateAllFluxesFromFree(free_fluxes), residuals, &jacobian_map);
+        exchange_transform_.ScaleJacobian(free_fluxes, jacobian_map);
+    };
+    functions.second_directional_derivative = [this](const Eigen::VectorXd &free_fluxes,
+                                                     const Eigen::VectorXd &direction,
+                                                     Eigen::VectorXd &second_derivative) {
+        ScopedTimer timer(GetSimulationTimer());
+        const std::vector<double> free_fluxes_direction(direction.data(), direction.data() + direction.size());
+        DirectionalDerivatives derivatives = new_simulator_->CalculateDirectionalDerivatives(
+            CalculateAllFluxesFromFree(free_fluxes), free_fluxes_direction);
+        FillWeightedMids(second_derivative, derivatives.second_derivative);
+    };
+
+    functions.report = [this](const Eigen::VectorXd &free_fluxes, double ssr) {
+        if (telemetry_) {
+            ssr_trajectory_.push_back(ssr);
+        }
+        if (IsPastDeadline()) {
+            return false;
+        }
+        return !basin_registry_ || !IsHeadingIntoKnownBasin(free_fluxes, ssr);
+    };
+
+    LevenbergMarquardtParameters lm_parameters;
+    lm_parameters.max_iterations = parameters_.max_iterations;
+    lm_parameters.epsx = parameters_.epsx;
+    lm_parameters.use_geodesic_acceleration = parameters_.optimizer == Optimizer::geodesic_lm;
+
+    native_optimizer_.emplace(functions, variable_lower_bounds_, variable_upper_bounds_, lm_parameters);
+    if (parameters_.use_variable_scaling) {
+        native_optimizer_->SetScale(GetVariableScales());
+    }
+    // nullspace * Vfree < 0, see SetConstraints
+    SetNativeConstraints();
+}
+
+
+void Solver::SetSimulationTolerance(double tolerance) {
+    simulation_tolerance_ = tolerance;
+    new_simulator_->SetTolerance(tolerance);
+}
+
+
+void Solver::UpdateSimulationTolerance(const alglib::real_1d_array &free_fluxes, double ssr) {
+    if (previous_ssr_ > 0.0) {
+        const double ssr_decrease = std::max(0.0, previous_ssr_ - ssr) / previous_ssr_;
+
+        double step = 0.0;
+        double norm = 0.0;
+        for (int i = 0; i < nullity_; ++i) {
+            step += (free_fluxes[i] - previous_point_[i]) * (free_fluxes[i] - previous_point_[i]);
+            norm += previous_point_[i] * previous_point_[i];
+        }
+        const double relative_step = std::sqrt(step) / (std::sqrt(norm) + 1.0);
+
+        // The tolerance is never loosened during the run,
+        // so the SSRs compared by the optimizer become only more accurate
+        double tolerance = parameters_.tolerance_factor * std::max(ssr_decrease, relative_step);
+        tolerance = std::max(parameters_.tight_tolerance, tolerance);
+        if (tolerance < simulation_tolerance_) {
+            SetSimulationTolerance(tolerance);
+        }
+    }
+
+    previous_ssr_ = ssr;
+    previous_point_ = free_fluxes;
+}
+
+bool Solver::IsHeadingIntoKnownBasin(const Eigen::VectorXd &free_fluxes, double ssr) {
+    if (++reports_since_basin_check_ < parameters_.basin_check_period) {
+        return false;
+    }
+    reports_since_basin_check_ = 0;
+
+    Eigen::VectorXd point = free_fluxes;
+    exchange_transform_.ToFluxes(point);
+    const std::optional<size_t> basin = basin_registry_->FindKnownBasin(point, ssr);
+    if (basin && basin == basin_) {
+        ++basin_hits_;
+    } else {
+        basin_hits_ = basin ? 1 : 0;
+    }
+    basin_ = basin;
+    is_terminated_early_ = basin_hits_ >= parameters_.basin_confirmations;
+    return is_terminated_early_;
+}
+
+
+bool Solver::IsPastDeadline() {
+    if (deadline_ && std::chrono::steady_clock::now() >= *deadline_) {
+        is_cancelled_ = true;
+    }
+    return is_cancelled_;
+}
+
+
+bool Solver::IsReportNeeded() const {
+    return parameters_.use_adaptive_tolerance || basin_registry_ != nullptr || deadline_.has_value() ||
+           telemetry_ != nullptr;
+}
+
+
+double *Solver::GetSimulationTimer() {
+    return telemetry_ ? &simulation_seconds_ : nullptr;
+}
+
+
+// alglib arrays are written in place, the jacobian is row-major
 void JacobianCallback(const alglib::real_1d_array &free_fluxes,
                       alglib::real_1d_array &fi,
                       alglib::real_2d_array &jac, void *ptr) {
     Solver* solver = static_cast<Solver*>(ptr);
-    solver->in_jacobian = true;
-    AlglibCallback(free_fluxes, fi, ptr);
-    solver->in_jacobian = false;
-    solver->FillJacobian(jac);
+    ScopedTimer timer(solver->GetSimulationTimer());
+    JacobianMap jacobian(jac[0], jac.rows(), jac.cols(), Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(1, jac.getstride()));
+    solver->new_simulator_->CalculateResiduals(solver->CalculateAllFluxesFromFree(free_fluxes),
+                                               Eigen::Map<Eigen::VectorXd>(fi.getcontent(), fi.length()), &jacobian);
+    solver->exchange_transform_.ScaleJacobian(
+        Eigen::Map<const Eigen::VectorXd>(free_fluxes.getcontent(), free_fluxes.length()), jacobian);
 }
 
 
 void AlglibCallback(const alglib::real_1d_array &free_fluxes,
                     alglib::real_1d_array &residuals, void *ptr) {
     Solver* solver = static_cast<Solver*>(ptr);
-    solver->CalculateResidual(free_fluxes, residuals);
+    ScopedTimer timer(solver->GetSimulationTimer());
+    solver->new_simulator_->CalculateResiduals(solver->CalculateAllFluxesFromFree(free_fluxes),
+                                               Eigen::Map<Eigen::VectorXd>(residuals.getcontent(), residuals.length()),
+                                               nullptr);
 }
 
 
-
-void Solver::FillJacobian(alglib::real_2d_array &jac) {
-    int total_residuals = 0;
-    for (size_t isotope = 0; isotope < measured_mids_.size(); ++isotope) {
-        for (size_t mass_shift = 0; mass_shift < measured_mids_[isotope].errors.size(); ++mass_shift) {
-            for (size_t flux = 0; flux < diff_results_.size(); ++flux) {
-                float temp = diff_results_[flux][isotope].mid[mass_shift] / measured_mids_[isotope].errors[mass_shift];
-                jac(total_residuals, flux) = temp;
-            }
-            ++total_residuals;
-        }
+void ReportCallback(const alglib::real_1d_array &free_fluxes, double func, void *ptr) {
+    Solver* solver = static_cast<Solver*>(ptr);
+    if (solver->telemetry_) {
+        solver->ssr_trajectory_.push_back(func);
+    }
+    if (solver->parameters_.use_adaptive_tolerance) {
+        solver->UpdateSimulationTolerance(free_fluxes, func);
+    }
+    if (solver->IsPastDeadline()) {
+        alglib::minlmrequesttermination(solver->state_);
+        return;
+    }
+    if (solver->basin_registry_ &&
+        solver->IsHeadingIntoKnownBasin(GetEigenVectorFromAlgLibVector(free_fluxes), func)) {
+        alglib::minlmrequesttermination(solver->state_);
     }
 }
 
 
-void Solver::CalculateResidual(const alglib::real_1d_array &free_fluxes,
-                               alglib::real_1d_array &residuals) {
-    std::vector<Flux> calculated_fluxes = CalculateAllFluxesFromFree(free_fluxes);
 
-
-    SimulatorResult result = new_simulator_->CalculateMids(calculated_fluxes, in_jacobian);
-
-    diff_results_ = result.diff_results;
-
-    Fillf0Array(residuals, result.simulated_mids);
+const std::vector<Flux> &Solver::CalculateAllFluxesFromFree(const alglib::real_1d_array &variables_alglib) {
+    return CalculateAllFluxesFromFree(Eigen::Map<const Eigen::VectorXd>(variables_alglib.getcontent(),
+                                                                        variables_alglib.length()));
 }
 
 
-std::vector<Flux> Solver::CalculateAllFluxesFromFree(const alglib::real_1d_array &free_fluxes_alglib) {
-    Eigen::VectorXd free_fluxes = GetEigenVectorFromAlgLibVector(free_fluxes_alglib);
-    Matrix depended_fluxes_matrix = -nullspace_ * free_fluxes;
-    std::vector<Flux> all_fluxes(reactions_num_, -1);
+const std::vector<Flux> &Solver::CalculateAllFluxesFromFree(const Eigen::Ref<const Eigen::VectorXd> &variables) {
+    free_fluxes_buffer_ = variables;
+    exchange_transform_.ToFluxes(free_fluxes_buffer_);
+    const Eigen::VectorXd &free_fluxes = free_fluxes_buffer_;
+    depended_fluxes_.noalias() = -nullspace_ * free_fluxes;
+    all_fluxes_.resize(reactions_num_);
     // non metabolite balance reactions
-    const int depended_reactions_total = depended_fluxes_matrix.rows();
+    const int depended_reactions_total = depended_fluxes_.size();
     const int
-        isotopomer_balance_reactions_total = reactions_num_ - depended_reactions_total - free_fluxes_alglib.length();
+        isotopomer_balance_reactions_total = reactions_num_ - depended_reactions_total - free_fluxes.size();
 
     for (int i = 0; i < isotopomer_balance_reactions_total; ++i) {
-        all_fluxes[reactions_.at(i).id] = 1;
+        all_fluxes_[reactions_.at(i).id] = 1;
     }
 
     for (int i = 0; i < depended_reactions_total; ++i) {
-        all_fluxes[reactions_.at(i + isotopomer_balance_reactions_total).id] = depended_fluxes_matrix(i, 0);
+        all_fluxes_[reactions_.at(i + isotopomer_balance_reactions_total).id] = depended_fluxes_(i);
     }
 
-    for (int i = 0; i < free_fluxes_alglib.length(); ++i) {
-        all_fluxes[reactions_.at(reactions_num_ - free_fluxes_alglib.length() + i).id] = free_fluxes[i];
+    for (int i = 0; i < free_fluxes.size(); ++i) {
+        all_fluxes_[reactions_.at(reactions_num_ - free_fluxes.size() + i).id] = free_fluxes[i];
     }
 
-    return all_fluxes;
+    return all_fluxes_;
 }
 
 
-void Solver::Fillf0Array(alglib::real_1d_array &residuals, const std::vector<EmuAndMid> &simulated_mids) {
-    int total_residuals = 0;
-    for (size_t isotope = 0; isotope < simulated_mids.size(); ++isotope) {
-        for (size_t mass_shift = 0; mass_shift < simulated_mids[isotope].mid.size(); ++mass_shift) {
-            residuals[total_residuals] = simulated_mids[isotope].mid[mass_shift];
-            residuals[total_residuals] -= (measured_mids_[isotope].mid[mass_shift]);
-            residuals[total_residuals] /= measured_mids_[isotope].errors[mass_shift];
-            ++total_residuals;
+Eigen::VectorXd Solver::GetVariableScales() const {
+    Eigen::VectorXd scales = variable_upper_bounds_ - variable_lower_bounds_;
+    for (int i = 0; i < scales.size(); ++i) {
+        if (scales(i) <= 0.0) {
+            scales(i) = 1.0;
         }
     }
+    return scales;
 }
 
 
-double Solver::GetSSR(const alglib::real_1d_array &residuals) {
-    double answer = 0.0;
-    for (int measurement = 0; measurement < measurements_count_; ++measurement) {
-        answer += residuals(measurement) * residuals(measurement);
+void Solver::FillWeightedMids(Eigen::VectorXd &weighted_mids, const std::vector<EmuAndMid> &mids) {
+    weighted_mids.resize(measurements_count_);
+    int total_residuals = 0;
+    for (size_t isotope = 0; isotope < mids.size(); ++isotope) {
+        for (size_t mass_shift = 0; mass_shift < mids[isotope].mid.size(); ++mass_shift) {
+            weighted_mids(total_residuals) = mids[isotope].mid[mass_shift] / measured_mids_[isotope].errors[mass_shift];
+            ++total_residuals;
+        }
     }
-    return answer;
 }
 
 
-void Solver::PrintFinalMessage(const alglib::real_1d_array &free_fluxes) {
-    std::vector<Flux> final_all_fluxes = CalculateAllFluxesFromFree(free_fluxes);
-    SimulatorResult result = new_simulator_->CalculateMids(final_all_fluxes, false);
-    alglib::real_1d_array residuals;
-    residuals.setlength(measurements_count_);
-    Fillf0Array(residuals, result.simulated_mids);
-    double ssr = GetSSR(residuals);
+void Solver::PrintFinalMessage(const alglib::real_1d_array &free_fluxes, int total_steps,
+                               size_t linear_solver_iterations) {
+    Eigen::VectorXd residuals(measurements_count_);
+    {
+        ScopedTimer timer(GetSimulationTimer());
+        new_simulator_->CalculateResiduals(CalculateAllFluxesFromFree(free_fluxes), residuals, nullptr);
+    }
+    double ssr = residuals.squaredNorm();
+    final_ssr_ = ssr;
+    final_steps_ = total_steps;
 /*
     std::cout << "Finish at: " << std::endl;
 
@@ -284,6 +714,9 @@ void Solver::PrintFinalMessage(const alglib::real_1d_array &free_fluxes) {
         std::cout << reactions_[reactions_num_ - free_fluxes.length() + i].id + 1 <<
                   " = " << free_fluxes[i] << std::endl;
     } */
-    std::cout << " Finish with SSR: " << ssr << " in " << report_.iterationscount << " steps." << std::endl;
+    std::cout << " Finish with SSR: " << ssr << " in " << total_steps << " steps, "
+              << linear_solver_iterations << " linear solver iterations"
+              << (is_terminated_early_ ? ", terminated in a known basin." :
+                  is_cancelled_ ? ", cancelled at the deadline." : ".") << std::endl;
 }
 } // namespace khnum
@@ -0,0 +1,135 @@
+#include "solver/start_log.h"
+
+#include <cstring>
+#include <vector>
+#include <filesystem>
+#include <stdexcept>
+
+
+namespace khnum {
+namespace {
+const char kMagic[8] = {'K', 'H', 'N', 'U', 'M', 'L', 'O', 'G'};
+const uint32_t kVersion = 1;
+} // namespace
+
+
+StartLogContents ReadStartLog(const std::string &path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Can't open the start log " + path);
+    }
+    StartLogContents contents;
+    StartLogHeader &header = contents.header;
+    if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error(path + " is not a start log");
+    }
+    if (header.version != kVersion) {
+        throw std::runtime_error("The start log " + path + " is of the unknown version " +
+                                 std::to_string(header.version));
+    }
+
+    StartLogRecord record;
+    std::vector<double> free_fluxes(header.nullity);
+    while (input.read(reinterpret_cast<char *>(&record), sizeof(record)) &&
+           input.read(reinterpret_cast<char *>(free_fluxes.data()), free_fluxes.size() * sizeof(double))) {
+        StartResult result;
+        result.start = record.start;
+        result.seed = record.seed;
+        result.free_fluxes.setcontent(header.nullity, free_fluxes.data());
+        result.ssr = record.ssr;
+        result.iterations = record.iterations;
+        result.evaluations = record.evaluations;
+        result.is_terminated_early = record.flags & kTerminatedEarly;
+        result.seconds = record.seconds;
+        result.is_screened_out = record.flags & kScreenedOut;
+        result.is_cancelled = record.flags & kCancelled;
+        contents.results.push_back(std::move(result));
+    }
+    return contents;
+}
+
+
+StartLog::StartLog(const std::string &path, int nullity, size_t total_starts, uint64_t master_seed, bool resume) :
+    path_{path},
+    nullity_{nullity} {
+    if (std::filesystem::exists(path_)) {
+        if (!resume) {
+            throw std::runtime_error("The start log " + path_ + " already exists, it can only be resumed");
+        }
+        StartLogContents contents = ReadStartLog(path_);
+        const StartLogHeader &header = contents.header;
+        if (static_cast<int>(header.nullity) != nullity_ || header.total_starts != total_starts ||
+            header.master_seed != master_seed) {
+            throw std::runtime_error("The start log " + path_ + " is of " + std::to_string(header.nullity) +
+                                     " free fluxes, " + std::to_string(header.total_starts) + " starts and seed " +
+                                     std::to_string(header.master_seed) + ", can't resume it with " +
+                                     std::to_string(nullity_) + " free fluxes, " + std::to_string(total_starts) +
+                                     " starts and seed " + std::to_string(master_seed));
+        }
+        logged_results_ = std::move(contents.results);
+        // drops the cut record
+        std::filesystem::resize_file(path_, sizeof(StartLogHeader) + logged_results_.size() *
+                                                (sizeof(StartLogRecord) + nullity_ * sizeof(double)));
+        output_.open(path_, std::ios::binary | std::ios::app);
+    } else {
+        StartLogHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.nullity = nullity_;
+        header.total_starts = total_starts;
+        header.master_seed = master_seed;
+        output_.open(path_, std::ios::binary | std::ios::trunc);
+        output_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output_.flush();
+    }
+    if (!output_) {
+        throw std::runtime_error("Can't write the start log " + path_);
+    }
+}
+
+
+std::vector<StartResult> StartLog::GetCompletedResults() const {
+    std::vector<const StartResult *> last_results;
+    for (const StartResult &result : logged_results_) {
+        if (result.start >= last_results.size()) {
+            last_results.resize(result.start + 1, nullptr);
+        }
+        last_results[result.start] = &result;
+    }
+    std::vector<StartResult> completed_results;
+    for (const StartResult *result : last_results) {
+        if (result && !result->is_cancelled) {
+            completed_results.push_back(*result);
+        }
+    }
+    return completed_results;
+}
+
+
+void StartLog::Append(const StartResult &result) {
+    if (result.free_fluxes.length() != nullity_) {
+        throw std::runtime_error("The start " + std::to_string(result.start) + " has " +
+                                 std::to_string(result.free_fluxes.length()) + " free fluxes, the start log is of " +
+                                 std::to_string(nullity_));
+    }
+    StartLogRecord record{};
+    record.start = result.start;
+    record.seed = result.seed;
+    record.ssr = result.ssr;
+    record.seconds = result.seconds;
+    record.iterations = result.iterations;
+    record.evaluations = result.evaluations;
+    record.flags = (result.is_terminated_early ? kTerminatedEarly : 0u) |
+                   (result.is_screened_out ? kScreenedOut : 0u) |
+                   (result.is_cancelled ? kCancelled : 0u);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    output_.write(reinterpret_cast<const char *>(result.free_fluxes.getcontent()), nullity_ * sizeof(double));
+    output_.flush();
+    if (!output_) {
+        throw std::runtime_error("Can't write the start log " + path_);
+    }
+}
+} // namespace khnum
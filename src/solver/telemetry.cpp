@@ -0,0 +1,184 @@
+#include "solver/telemetry.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace khnum {
+namespace {
+// JSON has no infinity and NaN
+void WriteJsonNumber(std::ostream &output, double value) {
+    if (std::isfinite(value)) {
+        output << value;
+    } else {
+        output << "null";
+    }
+}
+} // namespace
+
+
+Telemetry::Telemetry(TelemetryFormat format, const std::string &path) :
+    format_{format},
+    path_{path} {
+}
+
+
+void Telemetry::AddStart(StartTelemetry &&start) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    starts_.push_back(std::move(start));
+}
+
+
+void Telemetry::AddWorker(size_t worker, const WorkerTelemetry &telemetry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (worker >= workers_.size()) {
+        workers_.resize(worker + 1);
+    }
+    workers_[worker].starts += telemetry.starts;
+    workers_[worker].busy_seconds += telemetry.busy_seconds;
+    workers_[worker].wall_seconds += telemetry.wall_seconds;
+}
+
+
+void Telemetry::PrintSummary() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t residual_evaluations = 0;
+    size_t jacobian_evaluations = 0;
+    size_t linear_solver_iterations = 0;
+    size_t linear_solver_failures = 0;
+    double simulation_seconds = 0.0;
+    double seconds = 0.0;
+    for (const StartTelemetry &start : starts_) {
+        residual_evaluations += start.residual_evaluations;
+        jacobian_evaluations += start.jacobian_evaluations;
+        linear_solver_iterations += start.linear_solver_iterations;
+        linear_solver_failures += start.linear_solver_failures;
+        simulation_seconds += start.simulation_seconds;
+        seconds += start.seconds;
+    }
+    double busy_seconds = 0.0;
+    double wall_seconds = 0.0;
+    for (const WorkerTelemetry &worker : workers_) {
+        busy_seconds += worker.busy_seconds;
+        wall_seconds += worker.wall_seconds;
+    }
+
+    std::cout << "Telemetry: " << starts_.size() << " starts, " << residual_evaluations << " residual and "
+              << jacobian_evaluations << " jacobian evaluations, " << simulation_seconds << " of " << seconds
+              << " seconds in the simulator, " << linear_solver_iterations << " linear solver iterations, "
+              << linear_solver_failures << " failed" << std::endl;
+    if (wall_seconds > 0.0) {
+        std::cout << " " << workers_.size() << " workers busy " << 100.0 * busy_seconds / wall_seconds
+                  << "% of their time" << std::endl;
+    }
+}
+
+
+void Telemetry::Write() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (format_ == TelemetryFormat::csv) {
+        WriteCsv();
+    } else {
+        WriteJson();
+    }
+}
+
+
+void Telemetry::WriteCsv() const {
+    std::vector<const StartTelemetry *> starts;
+    for (const StartTelemetry &start : starts_) {
+        starts.push_back(&start);
+    }
+    std::stable_sort(starts.begin(), starts.end(), [](const StartTelemetry *lhs, const StartTelemetry *rhs) {
+        return lhs->start < rhs->start;
+    });
+
+    const std::string starts_path = path_ + "_starts.csv";
+    std::ofstream starts_output(starts_path);
+    starts_output.precision(10);
+    starts_output << "start,worker,iterations,residual_evaluations,jacobian_evaluations,linear_solver_iterations,"
+                     "linear_solver_failures,simulation_seconds,optimizer_seconds,seconds,ssr,ssr_trajectory\n";
+    for (const StartTelemetry *start : starts) {
+        starts_output << start->start << "," << start->worker << "," << start->iterations << ","
+                      << start->residual_evaluations << "," << start->jacobian_evaluations << ","
+                      << start->linear_solver_iterations << "," << start->linear_solver_failures << ","
+                      << start->simulation_seconds << "," << start->seconds - start->simulation_seconds << ","
+                      << start->seconds << "," << start->ssr << ",";
+        for (size_t i = 0; i < start->ssr_trajectory.size(); ++i) {
+            starts_output << (i > 0 ? ";" : "") << start->ssr_trajectory[i];
+        }
+        starts_output << "\n";
+    }
+
+    const std::string workers_path = path_ + "_workers.csv";
+    std::ofstream workers_output(workers_path);
+    workers_output.precision(10);
+    workers_output << "worker,starts,busy_seconds,wall_seconds,utilization\n";
+    for (size_t worker = 0; worker < workers_.size(); ++worker) {
+        const WorkerTelemetry &telemetry = workers_[worker];
+        workers_output << worker << "," << telemetry.starts << "," << telemetry.busy_seconds << ","
+                       << telemetry.wall_seconds << ","
+                       << (telemetry.wall_seconds > 0.0 ? telemetry.busy_seconds / telemetry.wall_seconds : 0.0)
+                       << "\n";
+    }
+    if (!starts_output || !workers_output) {
+        throw std::runtime_error("Can't write the telemetry to " + starts_path + " and " + workers_path);
+    }
+}
+
+
+void Telemetry::WriteJson() const {
+    const std::string path = path_ + ".json";
+    std::ofstream output(path);
+    output.precision(10);
+    output << "{\n  \"starts\": [";
+    for (size_t i = 0; i < starts_.size(); ++i) {
+        const StartTelemetry &start = starts_[i];
+        output << (i > 0 ? ",\n" : "\n") << "    {\"start\": " << start.start << ", \"worker\": " << start.worker
+               << ", \"iterations\": " << start.iterations
+               << ", \"residual_evaluations\": " << start.residual_evaluations
+               << ", \"jacobian_evaluations\": " << start.jacobian_evaluations
+               << ", \"linear_solver_iterations\": " << start.linear_solver_iterations
+               << ", \"linear_solver_failures\": " << start.linear_solver_failures
+               << ", \"simulation_seconds\": " << start.simulation_seconds
+               << ", \"optimizer_seconds\": " << start.seconds - start.simulation_seconds
+               << ", \"seconds\": " << start.seconds << ", \"ssr\": ";
+        WriteJsonNumber(output, start.ssr);
+        output << ", \"ssr_trajectory\": [";
+        for (size_t step = 0; step < start.ssr_trajectory.size(); ++step) {
+            output << (step > 0 ? ", " : "");
+            WriteJsonNumber(output, start.ssr_trajectory[step]);
+        }
+        output << "]}";
+    }
+    output << "\n  ],\n  \"workers\": [";
+    for (size_t worker = 0; worker < workers_.size(); ++worker) {
+        const WorkerTelemetry &telemetry = workers_[worker];
+        output << (worker > 0 ? ",\n" : "\n") << "    {\"worker\": " << worker << ", \"starts\": " << telemetry.starts
+               << ", \"busy_seconds\": " << telemetry.busy_seconds
+               << ", \"wall_seconds\": " << telemetry.wall_seconds << "}";
+    }
+    output << "\n  ]\n}\n";
+    if (!output) {
+        throw std::runtime_error("Can't write the telemetry to " + path);
+    }
+}
+
+
+ScopedTimer::ScopedTimer(double *seconds) :
+    seconds_{seconds} {
+    if (seconds_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+
+ScopedTimer::~ScopedTimer() {
+    if (seconds_) {
+        *seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+}
+} // namespace khnum
@@ -0,0 +1,350 @@
+#include "solver/warm_start_library.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <tuple>
+
+#include "utilities/get_eigen_vec_from_alglib_vec.h"
+#include "utilities/free_flux_bounds.h"
+
+
+namespace khnum {
+namespace {
+const uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+const uint64_t kFnvPrime = 0x100000001b3ull;
+const int kFormatVersion = 1;
+// the start hits if its SSR is within max(absolute, relative * best SSR) of the best SSR of the run,
+// the SSR differences far below 1 don't matter for the chi-square statistics
+const double kHitAbsoluteTolerance = 1.e-2;
+const double kHitRelativeTolerance = 1.e-3;
+const int kMaxPerturbationHalvings = 10;
+
+void HashBytes(uint64_t &hash, const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= kFnvPrime;
+    }
+}
+
+template<typename T>
+void HashValue(uint64_t &hash, const T &value) {
+    HashBytes(hash, &value, sizeof(value));
+}
+
+void HashString(uint64_t &hash, const std::string &value) {
+    HashValue(hash, value.size());
+    HashBytes(hash, value.data(), value.size());
+}
+
+void HashEmu(uint64_t &hash, const Emu &emu) {
+    HashString(hash, emu.name);
+    HashValue(hash, emu.atom_states.size());
+    HashBytes(hash, emu.atom_states.data(), emu.atom_states.size());
+}
+} // namespace
+
+
+uint64_t GetModelHash(const Problem &problem) {
+    uint64_t hash = kFnvOffset;
+    HashValue(hash, problem.reactions.size());
+    for (const ReactionsName &reaction : problem.reactions) {
+        HashValue(hash, reaction.id);
+        HashString(hash, reaction.name);
+    }
+    HashValue(hash, problem.nullspace.rows());
+    HashValue(hash, problem.nullspace.cols());
+    for (int column = 0; column < problem.nullspace.cols(); ++column) {
+        for (int row = 0; row < problem.nullspace.rows(); ++row) {
+            HashValue(hash, problem.nullspace(row, column));
+        }
+    }
+    const GeneratorParameters &parameters = problem.simulator_parameters_;
+    HashValue(hash, parameters.networks.size());
+    for (const EmuNetwork &network : parameters.networks) {
+        HashValue(hash, network.size());
+        for (const EmuReaction &reaction : network) {
+            HashValue(hash, reaction.id);
+            HashValue(hash, reaction.rate);
+            HashValue(hash, reaction.left.size());
+            for (const EmuSubstrate &substrate : reaction.left) {
+                HashEmu(hash, substrate.emu);
+                HashValue(hash, substrate.coefficient);
+            }
+            HashEmu(hash, reaction.right.emu);
+            HashValue(hash, reaction.right.coefficient);
+        }
+    }
+    HashValue(hash, problem.measured_isotopes.size());
+    for (const Emu &emu : problem.measured_isotopes) {
+        HashEmu(hash, emu);
+    }
+    return hash;
+}
+
+
+WarmStartLibrary::WarmStartLibrary(const std::string &directory, const Problem &problem, size_t capacity,
+                                   double radius) :
+    directory_{directory},
+    problem_{problem},
+    model_hash_{GetModelHash(problem)},
+    capacity_{capacity},
+    radius_{radius} {
+    const int nullity = problem_.nullspace.cols();
+    std::tie(lower_bounds_, upper_bounds_) = GetFreeFluxBounds(problem_);
+    // fixed fluxes don't move, but would divide by zero
+    bounds_width_ = upper_bounds_ - lower_bounds_;
+    for (int i = 0; i < nullity; ++i) {
+        if (bounds_width_(i) <= 0.0) {
+            bounds_width_(i) = 1.0;
+        }
+    }
+    if (std::filesystem::exists(GetPath())) {
+        Load();
+    }
+}
+
+
+size_t WarmStartLibrary::GetSize() const {
+    return optima_.size();
+}
+
+
+std::optional<Eigen::VectorXd> WarmStartLibrary::GetStartPoint(size_t optimum, double perturbation,
+                                                               std::mt19937 &random_source) const {
+    // the bounds may have changed since the optimum was found
+    const Eigen::VectorXd center =
+        optima_.at(optimum).free_fluxes.cwiseMax(lower_bounds_).cwiseMin(upper_bounds_);
+    std::normal_distribution<> get_normal(0.0, 1.0);
+    Eigen::VectorXd shift(center.size());
+    for (int i = 0; i < shift.size(); ++i) {
+        shift(i) = perturbation * bounds_width_(i) * get_normal(random_source);
+    }
+    for (int halving = 0; halving <= kMaxPerturbationHalvings; ++halving) {
+        const Eigen::VectorXd point = (center + shift).cwiseMax(lower_bounds_).cwiseMin(upper_bounds_);
+        if (IsFeasible(point)) {
+            return point;
+        }
+        shift /= 2.0;
+    }
+    if (IsFeasible(center)) {
+        return center;
+    }
+    return std::nullopt;
+}
+
+
+WarmStartStatistics WarmStartLibrary::Update(const std::vector<StartResult> &results,
+                                             const std::vector<std::optional<size_t>> &start_optima) {
+    std::vector<const StartResult *> optima_results;
+    double best_ssr = std::numeric_limits<double>::infinity();
+    for (const StartResult &result : results) {
+        if (!result.is_screened_out && !result.is_cancelled && std::isfinite(result.ssr)) {
+            optima_results.push_back(&result);
+            best_ssr = std::min(best_ssr, result.ssr);
+        }
+    }
+    const double hit_ssr = best_ssr + std::max(kHitAbsoluteTolerance, kHitRelativeTolerance * best_ssr);
+
+    WarmStartStatistics run_statistics;
+    run_statistics.total_runs = 1;
+    for (const StartResult &result : results) {
+        if (result.is_cancelled) {
+            continue;
+        }
+        const bool is_hit = !result.is_screened_out && result.ssr <= hit_ssr;
+        const std::optional<size_t> optimum = result.start < start_optima.size() ? start_optima[result.start]
+                                                                                 : std::nullopt;
+        if (optimum) {
+            ++run_statistics.warm_starts;
+            run_statistics.warm_hits += is_hit;
+            run_statistics.warm_seconds += result.seconds;
+            ++optima_[*optimum].uses;
+            optima_[*optimum].hits += is_hit;
+        } else {
+            ++run_statistics.cold_starts;
+            run_statistics.cold_hits += is_hit;
+            run_statistics.cold_seconds += result.seconds;
+        }
+    }
+    statistics_.total_runs += run_statistics.total_runs;
+    statistics_.warm_starts += run_statistics.warm_starts;
+    statistics_.warm_hits += run_statistics.warm_hits;
+    statistics_.warm_seconds += run_statistics.warm_seconds;
+    statistics_.cold_starts += run_statistics.cold_starts;
+    statistics_.cold_hits += run_statistics.cold_hits;
+    statistics_.cold_seconds += run_statistics.cold_seconds;
+
+    // the distinct optima of the run from the best, an old optimum close to one of them passes its counters
+    std::sort(optima_results.begin(), optima_results.end(), [](const StartResult *lhs, const StartResult *rhs) {
+        return lhs->ssr < rhs->ssr;
+    });
+    std::vector<Optimum> optima;
+    std::vector<bool> is_matched(optima_.size(), false);
+    for (const StartResult *result : optima_results) {
+        if (optima.size() == capacity_) {
+            break;
+        }
+        const Eigen::VectorXd free_fluxes = GetEigenVectorFromAlgLibVector(result->free_fluxes);
+        const bool is_distinct = std::all_of(optima.begin(), optima.end(), [&](const Optimum &optimum) {
+            return GetDistance(free_fluxes, optimum.free_fluxes) > radius_;
+        });
+        if (!is_distinct) {
+            continue;
+        }
+        Optimum optimum{free_fluxes, result->ssr, 0, 0};
+        for (size_t old = 0; old < optima_.size(); ++old) {
+            if (!is_matched[old] && GetDistance(free_fluxes, optima_[old].free_fluxes) <= radius_) {
+                is_matched[old] = true;
+                optimum.uses = optima_[old].uses;
+                optimum.hits = optima_[old].hits;
+                break;
+            }
+        }
+        optima.push_back(std::move(optimum));
+    }
+
+    // the rest is of the old optima not found by the run, the most hit first
+    std::vector<size_t> old_optima;
+    for (size_t old = 0; old < optima_.size(); ++old) {
+        if (!is_matched[old]) {
+            old_optima.push_back(old);
+        }
+    }
+    std::stable_sort(old_optima.begin(), old_optima.end(), [this](size_t lhs, size_t rhs) {
+        return optima_[lhs].hits > optima_[rhs].hits;
+    });
+    for (size_t old : old_optima) {
+        if (optima.size() == capacity_) {
+            break;
+        }
+        optima.push_back(std::move(optima_[old]));
+    }
+    optima_ = std::move(optima);
+    return run_statistics;
+}
+
+
+void WarmStartLibrary::Save() const {
+    std::filesystem::create_directories(directory_);
+    // the library is replaced at once, a crash leaves the old one
+    const std::string path = GetPath();
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream output(temporary_path);
+        output << std::setprecision(17);
+        output << "khnum warm start library " << kFormatVersion << "\n";
+        output << "model " << std::hex << std::setw(16) << std::setfill('0') << model_hash_ << std::dec << "\n";
+        output << "nullity " << lower_bounds_.size() << "\n";
+        output << "statistics " << statistics_.total_runs << " " << statistics_.warm_starts << " "
+               << statistics_.warm_hits << " " << statistics_.warm_seconds << " " << statistics_.cold_starts << " "
+               << statistics_.cold_hits << " " << statistics_.cold_seconds << "\n";
+        for (const Optimum &optimum : optima_) {
+            output << "optimum " << optimum.ssr << " " << optimum.uses << " " << optimum.hits;
+            for (int i = 0; i < optimum.free_fluxes.size(); ++i) {
+                output << " " << optimum.free_fluxes(i);
+            }
+            output << "\n";
+        }
+        if (!output) {
+            throw std::runtime_error("Can't write the warm start library " + temporary_path);
+        }
+    }
+    std::filesystem::rename(temporary_path, path);
+}
+
+
+const WarmStartStatistics &WarmStartLibrary::GetStatistics() const {
+    return statistics_;
+}
+
+
+std::string WarmStartLibrary::GetPath() const {
+    std::stringstream file_name;
+    file_name << std::hex << std::setw(16) << std::setfill('0') << model_hash_ << ".txt";
+    return (std::filesystem::path(directory_) / file_name.str()).string();
+}
+
+
+void WarmStartLibrary::Load() {
+    const std::string path = GetPath();
+    std::ifstream input(path);
+    std::string line;
+    const int nullity = lower_bounds_.size();
+    while (std::getline(input, line)) {
+        std::stringstream line_stream(line);
+        std::string key;
+        line_stream >> key;
+        if (key == "khnum") {
+            std::string warm, start, library;
+            int version;
+            line_stream >> warm >> start >> library >> version;
+            if (version != kFormatVersion) {
+                throw std::runtime_error("The warm start library " + path + " is of the unknown version " +
+                                         std::to_string(version));
+            }
+        } else if (key == "nullity") {
+            int library_nullity;
+            line_stream >> library_nullity;
+            if (library_nullity != nullity) {
+                throw std::runtime_error("The warm start library " + path + " is of " +
+                                         std::to_string(library_nullity) + " free fluxes, the model has " +
+                                         std::to_string(nullity));
+            }
+        } else if (key == "statistics") {
+            line_stream >> statistics_.total_runs >> statistics_.warm_starts >> statistics_.warm_hits
+                        >> statistics_.warm_seconds >> statistics_.cold_starts >> statistics_.cold_hits
+                        >> statistics_.cold_seconds;
+        } else if (key == "optimum") {
+            Optimum optimum{Eigen::VectorXd(nullity), 0.0, 0, 0};
+            line_stream >> optimum.ssr >> optimum.uses >> optimum.hits;
+            for (int i = 0; i < nullity; ++i) {
+                line_stream >> optimum.free_fluxes(i);
+            }
+            if (!line_stream) {
+                throw std::runtime_error("Can't read an optimum of the warm start library " + path);
+            }
+            optima_.push_back(std::move(optimum));
+        }
+    }
+}
+
+
+double WarmStartLibrary::GetDistance(const Eigen::VectorXd &lhs, const Eigen::VectorXd &rhs) const {
+    const Eigen::VectorXd scaled_distance = (lhs - rhs).cwiseQuotient(bounds_width_);
+    return scaled_distance.norm() / std::sqrt(static_cast<double>(std::max<Eigen::Index>(1, scaled_distance.size())));
+}
+
+
+bool WarmStartLibrary::IsFeasible(const Eigen::VectorXd &free_fluxes) const {
+    const LinearConstraints &constraints = problem_.constraints;
+    return constraints.matrix.rows() == 0 ||
+           ((constraints.matrix * free_fluxes - constraints.right_part).array() <= 0.0).all();
+}
+
+
+void PrintWarmStartStatistics(const WarmStartStatistics &run_statistics, const WarmStartStatistics &total_statistics) {
+    const auto print = [](const std::string &name, size_t starts, size_t hits, double seconds) {
+        std::cout << " " << name << ": " << hits << " of " << starts << " starts hit the best SSR, "
+                  << seconds / std::max<size_t>(1, starts) << " seconds per start";
+        if (hits > 0) {
+            std::cout << ", " << seconds / hits << " seconds per hit";
+        }
+        std::cout << std::endl;
+    };
+    std::cout << "Warm starts of this run:" << std::endl;
+    print("warm", run_statistics.warm_starts, run_statistics.warm_hits, run_statistics.warm_seconds);
+    print("cold", run_statistics.cold_starts, run_statistics.cold_hits, run_statistics.cold_seconds);
+    std::cout << "Warm starts of " << total_statistics.total_runs << " runs of the model:" << std::endl;
+    print("warm", total_statistics.warm_starts, total_statistics.warm_hits, total_statistics.warm_seconds);
+    print("cold", total_statistics.cold_starts, total_statistics.cold_hits, total_statistics.cold_seconds);
+}
+} // namespace khnum
@@ -0,0 +1,35 @@
+#include "statistics/flux_map.h"
+
+
+namespace khnum {
+FluxMap GetFluxMap(const Problem &problem) {
+    const int nullity = problem.nullspace.cols();
+    const int depended_reactions_total = problem.nullspace.rows();
+    const int isotopomer_balance_reactions_total = problem.reactions_total - depended_reactions_total - nullity;
+
+    FluxMap flux_map;
+    flux_map.coefficients = Matrix::Zero(problem.reactions_total, nullity);
+    flux_map.offsets = Eigen::VectorXd::Zero(problem.reactions_total);
+    flux_map.offsets.head(isotopomer_balance_reactions_total).setOnes();
+    flux_map.coefficients.middleRows(isotopomer_balance_reactions_total, depended_reactions_total) =
+        -problem.nullspace;
+    flux_map.coefficients.bottomRows(nullity).setIdentity();
+    return flux_map;
+}
+
+
+bool IsModelFlux(const FluxMap &flux_map, int reaction) {
+    return flux_map.offsets(reaction) == 0.0;
+}
+
+
+std::vector<int> GetModelFluxes(const FluxMap &flux_map) {
+    std::vector<int> model_fluxes;
+    for (int reaction = 0; reaction < flux_map.offsets.size(); ++reaction) {
+        if (IsModelFlux(flux_map, reaction)) {
+            model_fluxes.push_back(reaction);
+        }
+    }
+    return model_fluxes;
+}
+} // namespace khnum
@@ -0,0 +1,212 @@
+#include "statistics/linearized_statistics.h"
+
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <stdexcept>
+
+#include "alglib/specialfunctions.h"
+
+#include "solver/solver.h"
+#include "statistics/flux_map.h"
+
+
+namespace khnum {
+namespace {
+// relative distance of the optimum to the bounds and to the constraints right parts to count them active
+const double kActiveTolerance = 1.e-6;
+const double kStrongCorrelation = 0.9;
+
+
+const std::string &GetFreeFluxName(const Problem &problem, int position) {
+    return problem.reactions.at(problem.reactions.size() - problem.nullspace.cols() + position).name;
+}
+} // namespace
+
+
+ParameterCovariance GetParameterCovariance(const Matrix &jacobian, const Matrix &active_rows,
+                                           const Eigen::VectorXd &scales, double tolerance) {
+    const int total_parameters = jacobian.cols();
+    Eigen::VectorXd safe_scales = scales;
+    for (int i = 0; i < safe_scales.size(); ++i) {
+        if (!(safe_scales(i) > 0.0)) {
+            safe_scales(i) = 1.0;
+        }
+    }
+
+    // the basis of the scaled parameters which keep the active rows
+    Matrix free_space = Matrix::Identity(total_parameters, total_parameters);
+    if (active_rows.rows() > 0) {
+        Matrix scaled_rows = active_rows * safe_scales.asDiagonal();
+        for (int row = 0; row < scaled_rows.rows(); ++row) {
+            scaled_rows.row(row).normalize();
+        }
+        const Eigen::BDCSVD<Matrix> svd(scaled_rows, Eigen::ComputeFullV);
+        int active_rank = 0;
+        while (active_rank < svd.singularValues().size() &&
+               svd.singularValues()(active_rank) > 1.e-10 * svd.singularValues()(0)) {
+            ++active_rank;
+        }
+        free_space = svd.matrixV().rightCols(total_parameters - active_rank);
+    }
+
+    ParameterCovariance result;
+    result.covariance = Matrix::Zero(total_parameters, total_parameters);
+    result.null_directions.resize(total_parameters, 0);
+    result.rank = 0;
+    if (free_space.cols() == 0) {
+        return result;
+    }
+
+    const Matrix reduced_jacobian = jacobian * safe_scales.asDiagonal() * free_space;
+    const Eigen::BDCSVD<Matrix> svd(reduced_jacobian, Eigen::ComputeFullV);
+    const Eigen::VectorXd &singular_values = svd.singularValues();
+    while (result.rank < singular_values.size() && singular_values(0) > 0.0 &&
+           singular_values(result.rank) > tolerance * singular_values(0)) {
+        ++result.rank;
+    }
+
+    // V_r S_r^-2 V_r^T in the free space, scaled back to the parameters
+    const Matrix range = safe_scales.asDiagonal() * free_space * svd.matrixV().leftCols(result.rank);
+    const Eigen::VectorXd inverse_squares = singular_values.head(result.rank).array().square().inverse();
+    result.covariance = range * inverse_squares.asDiagonal() * range.transpose();
+
+    result.null_directions =
+        safe_scales.asDiagonal() * free_space * svd.matrixV().rightCols(free_space.cols() - result.rank);
+    for (int direction = 0; direction < result.null_directions.cols(); ++direction) {
+        result.null_directions.col(direction).normalize();
+    }
+    return result;
+}
+
+
+LinearizedStatistics GetLinearizedStatistics(const Problem &problem, const SimulatorGenerator &generator,
+                                             const SolverParameters &solver_parameters,
+                                             const Eigen::VectorXd &optimum, double tolerance) {
+    // the jacobian has to be of the free fluxes, not of the transformed variables
+    SolverParameters parameters = solver_parameters;
+    parameters.use_exchange_transform = false;
+    Solver solver(problem, generator, parameters);
+    Eigen::VectorXd residuals;
+    Matrix jacobian;
+    solver.CalculateJacobian(optimum, residuals, jacobian);
+    if (!residuals.allFinite() || !jacobian.allFinite()) {
+        throw std::runtime_error("The jacobian isn't finite at the optimum");
+    }
+
+    LinearizedStatistics statistics;
+    const int nullity = problem.nullspace.cols();
+    Eigen::VectorXd scales(nullity);
+    for (int i = 0; i < nullity; ++i) {
+        const double lower_bound = problem.lower_bounds[i];
+        const double upper_bound = problem.upper_bounds[i];
+        scales(i) = upper_bound - lower_bound;
+        const double margin = kActiveTolerance * std::max(1.0, scales(i));
+        if (optimum(i) - lower_bound <= margin || upper_bound - optimum(i) <= margin) {
+            statistics.active_bounds.push_back(i);
+        }
+    }
+    const LinearConstraints &constraints = problem.constraints;
+    for (int row = 0; row < constraints.matrix.rows(); ++row) {
+        const double slack = constraints.right_part(row) - constraints.matrix.row(row).dot(optimum);
+        if (slack <= kActiveTolerance * std::max(1.0, std::abs(constraints.right_part(row)))) {
+            statistics.active_constraints.push_back(row);
+        }
+    }
+
+    Matrix active_rows = Matrix::Zero(statistics.active_bounds.size() + statistics.active_constraints.size(),
+                                      nullity);
+    for (size_t i = 0; i < statistics.active_bounds.size(); ++i) {
+        active_rows(i, statistics.active_bounds[i]) = 1.0;
+    }
+    for (size_t i = 0; i < statistics.active_constraints.size(); ++i) {
+        active_rows.row(statistics.active_bounds.size() + i) =
+            constraints.matrix.row(statistics.active_constraints[i]);
+    }
+    statistics.free_flux_covariance = GetParameterCovariance(jacobian, active_rows, scales, tolerance);
+
+    // through the nullspace to all the fluxes
+    const FluxMap flux_map = GetFluxMap(problem);
+    statistics.fluxes = flux_map.coefficients * optimum + flux_map.offsets;
+    statistics.covariance =
+        flux_map.coefficients * statistics.free_flux_covariance.covariance * flux_map.coefficients.transpose();
+    const Matrix null_components = flux_map.coefficients * statistics.free_flux_covariance.null_directions;
+    const int reactions_total = statistics.fluxes.size();
+    statistics.standard_errors.resize(reactions_total);
+    for (int reaction = 0; reaction < reactions_total; ++reaction) {
+        const bool is_identifiable = null_components.row(reaction).lpNorm<Eigen::Infinity>() <=
+                                     1.e-6 * flux_map.coefficients.row(reaction).norm();
+        statistics.standard_errors(reaction) = is_identifiable ?
+            std::sqrt(std::max(0.0, statistics.covariance(reaction, reaction))) :
+            std::numeric_limits<double>::infinity();
+    }
+    statistics.correlations.resize(reactions_total, reactions_total);
+    for (int row = 0; row < reactions_total; ++row) {
+        for (int column = 0; column < reactions_total; ++column) {
+            const double scale = statistics.standard_errors(row) * statistics.standard_errors(column);
+            statistics.correlations(row, column) = scale > 0.0 && std::isfinite(scale) ?
+                statistics.covariance(row, column) / scale : std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    // the SSR of the weighted residuals is chi-square distributed at the true fluxes
+    statistics.ssr = residuals.squaredNorm();
+    statistics.degrees_of_freedom = residuals.size() - statistics.free_flux_covariance.rank;
+    statistics.ssr_lower = std::numeric_limits<double>::quiet_NaN();
+    statistics.ssr_upper = std::numeric_limits<double>::quiet_NaN();
+    statistics.is_fit_accepted = false;
+    if (statistics.degrees_of_freedom > 0) {
+        statistics.ssr_lower = alglib::invchisquaredistribution(statistics.degrees_of_freedom, 0.975);
+        statistics.ssr_upper = alglib::invchisquaredistribution(statistics.degrees_of_freedom, 0.025);
+        statistics.is_fit_accepted = statistics.ssr >= statistics.ssr_lower && statistics.ssr <= statistics.ssr_upper;
+    }
+    return statistics;
+}
+
+
+void PrintLinearizedStatistics(const Problem &problem, const LinearizedStatistics &statistics) {
+    const int nullity = problem.nullspace.cols();
+    std::cout << "Linearized statistics: rank " << statistics.free_flux_covariance.rank << " of " << nullity
+              << " free fluxes, " << statistics.active_bounds.size() << " at the bounds, "
+              << statistics.active_constraints.size() << " active constraints" << std::endl;
+    if (!statistics.active_bounds.empty()) {
+        std::cout << " at the bounds:";
+        for (int position : statistics.active_bounds) {
+            std::cout << " " << GetFreeFluxName(problem, position);
+        }
+        std::cout << std::endl;
+    }
+
+    const FluxMap flux_map = GetFluxMap(problem);
+    for (int reaction = 0; reaction < statistics.fluxes.size(); ++reaction) {
+        if (IsModelFlux(flux_map, reaction)) {
+            std::cout << " " << problem.reactions.at(reaction).name << ": " << statistics.fluxes(reaction)
+                      << " +- " << statistics.standard_errors(reaction) << std::endl;
+        }
+    }
+
+    const int first_free_flux = statistics.fluxes.size() - nullity;
+    bool is_header_printed = false;
+    for (int row = first_free_flux; row < statistics.fluxes.size(); ++row) {
+        for (int column = row + 1; column < statistics.fluxes.size(); ++column) {
+            const double correlation = statistics.correlations(row, column);
+            if (std::abs(correlation) >= kStrongCorrelation) {
+                if (!is_header_printed) {
+                    std::cout << "Strong correlations of the free fluxes:" << std::endl;
+                    is_header_printed = true;
+                }
+                std::cout << " " << problem.reactions.at(row).name << " " << problem.reactions.at(column).name
+                          << ": " << correlation << std::endl;
+            }
+        }
+    }
+
+    if (statistics.degrees_of_freedom <= 0) {
+        std::cout << "Chi-square test: no degrees of freedom left" << std::endl;
+        return;
+    }
+    std::cout << "Chi-square test: SSR " << statistics.ssr << " with " << statistics.degrees_of_freedom
+              << " degrees of freedom, 95% range [" << statistics.ssr_lower << ", " << statistics.ssr_upper
+              << "], the fit is " << (statistics.is_fit_accepted ? "accepted" : "rejected") << std::endl;
+}
+} // namespace khnum
@@ -0,0 +1,176 @@
+#include "statistics/monte_carlo.h"
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "solver/solver.h"
+#include "statistics/quantile.h"
+#include "utilities/random_source.h"
+#include "utilities/workers.h"
+
+
+namespace khnum {
+MonteCarlo::MonteCarlo(const Problem &problem,
+                       const SimulatorGenerator &generator,
+                       const SolverParameters &solver_parameters,
+                       const MonteCarloParameters &parameters) :
+    problem_{problem},
+    generator_{generator},
+    solver_parameters_{solver_parameters},
+    parameters_{parameters},
+    flux_map_{GetFluxMap(problem)},
+    model_fluxes_{GetModelFluxes(flux_map_)} {
+    solver_parameters_.max_iterations = parameters_.max_iterations;
+    solver_parameters_.epsx = parameters_.epsx;
+
+    // the same order as the residuals of the simulator
+    std::vector<double> measured_values;
+    std::vector<double> errors;
+    for (const Measurement &measurement : problem_.measurements) {
+        for (size_t mass_shift = 0; mass_shift < measurement.errors.size(); ++mass_shift) {
+            measured_values.push_back(measurement.mid[mass_shift]);
+            errors.push_back(measurement.errors[mass_shift]);
+        }
+    }
+    measured_values_ = Eigen::Map<Eigen::VectorXd>(measured_values.data(), measured_values.size());
+    errors_ = Eigen::Map<Eigen::VectorXd>(errors.data(), errors.size());
+}
+
+
+std::vector<FluxDistribution> MonteCarlo::Run(const Eigen::VectorXd &optimum) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const size_t total_workers = GetTotalWorkers(parameters_.total_workers, parameters_.total_replicates);
+
+    Eigen::VectorXd best_fit_residuals;
+    if (parameters_.resampling == Resampling::residuals) {
+        Matrix jacobian;
+        Solver(problem_, generator_, solver_parameters_).CalculateJacobian(optimum, best_fit_residuals, jacobian);
+        if (!best_fit_residuals.allFinite()) {
+            throw std::runtime_error("The residuals aren't finite at the optimum");
+        }
+    }
+
+    if (!parameters_.output_path.empty()) {
+        output_.open(parameters_.output_path);
+        if (!output_) {
+            throw std::runtime_error("Can't open " + parameters_.output_path);
+        }
+        output_ << "replicate,ssr,iterations";
+        for (int reaction : model_fluxes_) {
+            output_ << "," << problem_.reactions.at(reaction).name;
+        }
+        output_ << std::endl;
+    }
+
+    next_replicate_ = 0;
+    std::vector<Eigen::VectorXd> replicate_fluxes(parameters_.total_replicates);
+    RunWorkers(total_workers, [&](size_t) {
+        RunWorker(optimum, best_fit_residuals, replicate_fluxes);
+    });
+    if (output_.is_open()) {
+        output_.close();
+    }
+
+    // the replicates with the failed simulations have no fluxes
+    const size_t total_finished =
+        std::count_if(replicate_fluxes.begin(), replicate_fluxes.end(), [](const Eigen::VectorXd &fluxes) {
+            return fluxes.size() > 0;
+        });
+    std::vector<FluxDistribution> distributions;
+    std::vector<double> values;
+    for (size_t i = 0; i < model_fluxes_.size() && total_finished > 0; ++i) {
+        const int reaction = model_fluxes_[i];
+        values.clear();
+        for (const Eigen::VectorXd &fluxes : replicate_fluxes) {
+            if (fluxes.size() > 0) {
+                values.push_back(fluxes(reaction));
+            }
+        }
+        std::sort(values.begin(), values.end());
+        double mean = 0.0;
+        for (double value : values) {
+            mean += value;
+        }
+        mean /= values.size();
+        double variance = 0.0;
+        for (double value : values) {
+            variance += (value - mean) * (value - mean);
+        }
+        variance /= std::max<size_t>(1, values.size() - 1);
+        distributions.push_back({reaction, problem_.reactions.at(reaction).name, mean, std::sqrt(variance),
+                                 GetQuantile(values, 0.025), GetQuantile(values, 0.975)});
+    }
+
+    std::cout << "Monte Carlo: " << total_finished << " of " << parameters_.total_replicates << " replicates of the "
+              << (parameters_.resampling == Resampling::measurements ? "resampled measurements"
+                                                                     : "bootstrapped residuals")
+              << " on " << total_workers << " workers in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+              << " seconds" << std::endl;
+    for (const FluxDistribution &distribution : distributions) {
+        std::cout << " " << distribution.name << ": " << distribution.mean << " +- "
+                  << distribution.standard_deviation << " [" << distribution.lower << ", " << distribution.upper
+                  << "]" << std::endl;
+    }
+    return distributions;
+}
+
+
+void MonteCarlo::RunWorker(const Eigen::VectorXd &optimum, const Eigen::VectorXd &best_fit_residuals,
+                           std::vector<Eigen::VectorXd> &replicate_fluxes) {
+    Solver solver(problem_, generator_, solver_parameters_);
+    Eigen::VectorXd measured_values;
+    for (size_t replicate = next_replicate_++; replicate < parameters_.total_replicates;
+         replicate = next_replicate_++) {
+        const uint64_t seed = GetStartSeed(parameters_.seed, replicate);
+        Resample(best_fit_residuals, seed, measured_values);
+        solver.SetMeasuredValues(measured_values);
+        const StartResult result = solver.SolveFromStart(replicate, seed, optimum);
+        if (!std::isfinite(result.ssr)) {
+            continue;
+        }
+        const Eigen::VectorXd free_fluxes =
+            Eigen::Map<const Eigen::VectorXd>(result.free_fluxes.getcontent(), result.free_fluxes.length());
+        replicate_fluxes[replicate] = flux_map_.coefficients * free_fluxes + flux_map_.offsets;
+        WriteReplicate(replicate, result, replicate_fluxes[replicate]);
+    }
+}
+
+
+void MonteCarlo::Resample(const Eigen::VectorXd &best_fit_residuals, uint64_t seed,
+                          Eigen::VectorXd &measured_values) const {
+    std::mt19937 random_source = CreateRandomSource(seed);
+    measured_values.resize(measured_values_.size());
+    if (parameters_.resampling == Resampling::measurements) {
+        std::normal_distribution<> get_noise(0.0, 1.0);
+        for (int i = 0; i < measured_values.size(); ++i) {
+            measured_values(i) = measured_values_(i) + errors_(i) * get_noise(random_source);
+        }
+        return;
+    }
+
+    // residual = (simulated - measured) / error
+    std::uniform_int_distribution<int> get_residual(0, best_fit_residuals.size() - 1);
+    for (int i = 0; i < measured_values.size(); ++i) {
+        const double simulated = measured_values_(i) + errors_(i) * best_fit_residuals(i);
+        measured_values(i) = simulated - errors_(i) * best_fit_residuals(get_residual(random_source));
+    }
+}
+
+
+void MonteCarlo::WriteReplicate(size_t replicate, const StartResult &result, const Eigen::VectorXd &fluxes) {
+    if (!output_.is_open()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    output_ << replicate << "," << result.ssr << "," << result.iterations;
+    for (int reaction : model_fluxes_) {
+        output_ << "," << fluxes(reaction);
+    }
+    output_ << "\n";
+}
+} // namespace khnum
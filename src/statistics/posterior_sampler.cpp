@@ -0,0 +1,474 @@
+#include "statistics/posterior_sampler.h"
+
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
+#include "solver/solver.h"
+#include "statistics/quantile.h"
+#include "statistics/linearized_statistics.h"
+#include "utilities/free_flux_bounds.h"
+#include "utilities/random_source.h"
+#include "utilities/workers.h"
+
+
+namespace khnum {
+namespace {
+// the null directions of the linearized covariance get (kNullDirectionScale * bound widths)^2 of variance,
+// so they are still explored
+const double kNullDirectionScale = 1.e-2;
+// (kJitter * bound width)^2 on the diagonal keeps the proposal covariance positive definite
+const double kJitter = 1.e-6;
+// the Robbins-Monro gain of the burn-in step adaptation is 1 / (iteration + 1)^kAdaptationExponent
+const double kAdaptationExponent = 0.6;
+const int kStartAttempts = 100;
+// steps in the first covariance adaptation window
+const size_t kFirstWindow = 25;
+
+
+double GetMean(const std::vector<double> &values) {
+    double mean = 0.0;
+    for (double value : values) {
+        mean += value;
+    }
+    return mean / values.size();
+}
+
+
+double GetVariance(const std::vector<double> &values, double mean) {
+    double variance = 0.0;
+    for (double value : values) {
+        variance += (value - mean) * (value - mean);
+    }
+    return variance / std::max<size_t>(1, values.size() - 1);
+}
+
+
+// Divided by the chain length, not by the number of the products
+double GetAutocovariance(const std::vector<double> &chain, double mean, size_t lag) {
+    double autocovariance = 0.0;
+    for (size_t i = 0; i + lag < chain.size(); ++i) {
+        autocovariance += (chain[i] - mean) * (chain[i + lag] - mean);
+    }
+    return autocovariance / chain.size();
+}
+} // namespace
+
+
+ChainDiagnostics GetChainDiagnostics(const std::vector<std::vector<double>> &chains) {
+    // the chains are split in halves, so a trend inside a chain raises R-hat too
+    std::vector<std::vector<double>> halves;
+    for (const std::vector<double> &chain : chains) {
+        const size_t half = chain.size() / 2;
+        halves.emplace_back(chain.begin(), chain.begin() + half);
+        halves.emplace_back(chain.end() - half, chain.end());
+    }
+    const size_t total_halves = halves.size();
+    const size_t length = halves.empty() ? 0 : halves.front().size();
+    if (length < 2) {
+        return {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN()};
+    }
+
+    std::vector<double> means;
+    std::vector<double> variances;
+    for (const std::vector<double> &half : halves) {
+        means.push_back(GetMean(half));
+        variances.push_back(GetVariance(half, means.back()));
+    }
+    const double within_variance = GetMean(variances);
+    const double between_variance = GetVariance(means, GetMean(means));
+    const double total_variance = (length - 1.0) / length * within_variance + between_variance;
+    if (within_variance <= 0.0) {
+        return {1.0, static_cast<double>(total_halves * length)};
+    }
+
+    ChainDiagnostics diagnostics;
+    diagnostics.r_hat = std::sqrt(total_variance / within_variance);
+
+    const auto get_autocorrelation = [&](size_t lag) {
+        double autocovariance = 0.0;
+        for (size_t i = 0; i < total_halves; ++i) {
+            autocovariance += GetAutocovariance(halves[i], means[i], lag);
+        }
+        return 1.0 - (within_variance - autocovariance / total_halves) / total_variance;
+    };
+    // the sums of the pairs of the autocorrelations are positive and decreasing until the noise
+    double sum = 0.0;
+    double previous_pair = std::numeric_limits<double>::infinity();
+    for (size_t lag = 0; lag + 1 < length; lag += 2) {
+        const double pair = std::min(get_autocorrelation(lag) + get_autocorrelation(lag + 1), previous_pair);
+        if (pair <= 0.0) {
+            break;
+        }
+        sum += pair;
+        previous_pair = pair;
+    }
+    // ESS of the antithetic chains is capped at total samples * log10(total samples), as in Stan
+    const double autocorrelation_time = std::max(-1.0 + 2.0 * sum, 1.0 / std::log10(total_halves * length));
+    diagnostics.effective_sample_size = total_halves * length / autocorrelation_time;
+    return diagnostics;
+}
+
+
+PosteriorSampler::PosteriorSampler(const Problem &problem,
+                                   const SimulatorGenerator &generator,
+                                   const SolverParameters &solver_parameters,
+                                   const SamplerParameters &parameters) :
+    problem_{problem},
+    generator_{generator},
+    solver_parameters_{solver_parameters},
+    parameters_{parameters},
+    flux_map_{GetFluxMap(problem)},
+    model_fluxes_{GetModelFluxes(flux_map_)} {
+    // the posterior and its gradient are of the free fluxes
+    solver_parameters_.use_exchange_transform = false;
+    if (parameters_.total_chains == 0 || parameters_.total_samples == 0) {
+        throw std::runtime_error("The posterior sampler needs at least one chain and one sample");
+    }
+    parameters_.thinning = std::max<size_t>(1, parameters_.thinning);
+
+    std::tie(lower_bounds_, upper_bounds_) = GetFreeFluxBounds(problem_);
+    for (int i = 0; i < lower_bounds_.size(); ++i) {
+        if (lower_bounds_(i) < upper_bounds_(i)) {
+            sampled_fluxes_.push_back(i);
+        }
+    }
+}
+
+
+std::vector<FluxPosterior> PosteriorSampler::Run(const Eigen::VectorXd &optimum) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const int dimension = sampled_fluxes_.size();
+    if (dimension == 0) {
+        throw std::runtime_error("All the free fluxes are fixed, there is nothing to sample");
+    }
+    const size_t total_workers = GetTotalWorkers(parameters_.total_workers, parameters_.total_chains);
+
+    Eigen::VectorXd scales(dimension);
+    for (int i = 0; i < dimension; ++i) {
+        scales(i) = upper_bounds_(sampled_fluxes_[i]) - lower_bounds_(sampled_fluxes_[i]);
+    }
+    Matrix initial_covariance = Matrix::Zero(dimension, dimension);
+    {
+        Solver solver(problem_, generator_, solver_parameters_);
+        Eigen::VectorXd residuals;
+        Matrix jacobian;
+        solver.CalculateJacobian(optimum, residuals, jacobian);
+        if (jacobian.allFinite()) {
+            Matrix sampled_jacobian(jacobian.rows(), dimension);
+            for (int i = 0; i < dimension; ++i) {
+                sampled_jacobian.col(i) = jacobian.col(sampled_fluxes_[i]);
+            }
+            const ParameterCovariance linearized =
+                GetParameterCovariance(sampled_jacobian, Matrix(0, dimension), scales);
+            initial_covariance = linearized.covariance;
+            for (int i = 0; i < linearized.null_directions.cols(); ++i) {
+                const Eigen::VectorXd &direction = linearized.null_directions.col(i);
+                const double variance = std::pow(kNullDirectionScale * scales.cwiseProduct(direction).norm(), 2);
+                initial_covariance += variance * direction * direction.transpose();
+            }
+        } else {
+            initial_covariance.diagonal() = (kNullDirectionScale * scales).array().square().matrix();
+        }
+    }
+    // the posterior on the bounds isn't wider than the uniform one, the standard deviation of which is width / sqrt(12)
+    Eigen::VectorXd shrinkage(dimension);
+    for (int i = 0; i < dimension; ++i) {
+        shrinkage(i) = std::min(1.0, scales(i) / std::sqrt(12.0 * initial_covariance(i, i)));
+    }
+    initial_covariance = shrinkage.asDiagonal() * initial_covariance * shrinkage.asDiagonal();
+    initial_covariance.diagonal() += (kJitter * scales).array().square().matrix();
+
+    if (!parameters_.output_path.empty()) {
+        output_.open(parameters_.output_path);
+        if (!output_) {
+            throw std::runtime_error("Can't open " + parameters_.output_path);
+        }
+        output_ << "chain,sample,log_posterior";
+        for (int reaction : model_fluxes_) {
+            output_ << "," << problem_.reactions.at(reaction).name;
+        }
+        output_ << std::endl;
+    }
+
+    next_chain_ = 0;
+    std::vector<Chain> chains(parameters_.total_chains);
+    RunWorkers(total_workers, [&](size_t) {
+        RunWorker(optimum, initial_covariance, chains);
+    });
+    if (output_.is_open()) {
+        output_.close();
+    }
+
+    std::vector<FluxPosterior> posteriors;
+    std::vector<std::vector<double>> chain_values(chains.size());
+    std::vector<double> values;
+    double max_r_hat = 1.0;
+    for (int reaction : model_fluxes_) {
+        values.clear();
+        for (size_t chain = 0; chain < chains.size(); ++chain) {
+            chain_values[chain].clear();
+            for (const Eigen::VectorXd &sample : chains[chain].samples) {
+                chain_values[chain].push_back(flux_map_.coefficients.row(reaction).dot(sample) +
+                                              flux_map_.offsets(reaction));
+            }
+            values.insert(values.end(), chain_values[chain].begin(), chain_values[chain].end());
+        }
+        std::sort(values.begin(), values.end());
+        const double mean = GetMean(values);
+        const ChainDiagnostics diagnostics = GetChainDiagnostics(chain_values);
+        if (std::isfinite(diagnostics.r_hat)) {
+            max_r_hat = std::max(max_r_hat, diagnostics.r_hat);
+        }
+        posteriors.push_back({reaction, problem_.reactions.at(reaction).name, mean,
+                              std::sqrt(GetVariance(values, mean)), GetQuantile(values, 0.025),
+                              GetQuantile(values, 0.975), diagnostics});
+    }
+
+    // every step is one posterior evaluation, the chain seconds are the CPU seconds of the workers
+    const size_t steps_per_chain = parameters_.burn_in + parameters_.total_samples * parameters_.thinning;
+    size_t accepted = 0;
+    size_t evaluations = 0;
+    double chain_seconds = 0.0;
+    for (const Chain &chain : chains) {
+        accepted += chain.accepted;
+        evaluations += chain.evaluations;
+        chain_seconds += chain.seconds;
+    }
+    acceptance_rate_ =
+        static_cast<double>(accepted) / (chains.size() * parameters_.total_samples * parameters_.thinning);
+    std::cout << "Posterior sampler: " << chains.size() << " chains of " << parameters_.total_samples
+              << " samples after " << parameters_.burn_in << " burn-in steps, "
+              << (parameters_.proposal == Proposal::mala ? "MALA" : "adaptive Metropolis") << ", acceptance "
+              << acceptance_rate_ << ", " << evaluations << " evaluations, "
+              << chains.size() * steps_per_chain / chain_seconds << " steps per second per core, "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+              << " seconds on " << total_workers << " workers" << std::endl;
+    for (const FluxPosterior &posterior : posteriors) {
+        std::cout << " " << posterior.name << ": " << posterior.mean << " +- " << posterior.standard_deviation
+                  << " [" << posterior.lower << ", " << posterior.upper << "] R-hat "
+                  << posterior.diagnostics.r_hat << " ESS " << posterior.diagnostics.effective_sample_size
+                  << std::endl;
+    }
+    if (max_r_hat > 1.01) {
+        std::cout << "Posterior sampler: R-hat is up to " << max_r_hat
+                  << ", the chains haven't converged, run them longer" << std::endl;
+    }
+    return posteriors;
+}
+
+
+double PosteriorSampler::GetAcceptanceRate() const {
+    return acceptance_rate_;
+}
+
+
+void PosteriorSampler::RunWorker(const Eigen::VectorXd &optimum, const Matrix &initial_covariance,
+                                 std::vector<Chain> &chains) {
+    Solver solver(problem_, generator_, solver_parameters_);
+    for (size_t chain = next_chain_++; chain < chains.size(); chain = next_chain_++) {
+        RunChain(solver, chain, optimum, initial_covariance, chains[chain]);
+    }
+}
+
+
+void PosteriorSampler::RunChain(Solver &solver, size_t chain_number, const Eigen::VectorXd &optimum,
+                                const Matrix &initial_covariance, Chain &chain) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const uint64_t seed = GetStartSeed(parameters_.seed, chain_number);
+    std::mt19937 random_source = CreateRandomSource(seed);
+    std::normal_distribution<> get_normal(0.0, 1.0);
+    std::uniform_real_distribution<> get_uniform(0.0, 1.0);
+
+    const int dimension = sampled_fluxes_.size();
+    const bool use_gradient = parameters_.proposal == Proposal::mala;
+    const double target_acceptance = use_gradient ? 0.574 : 0.234;
+    // optimal for the gaussian posterior and the proposal covariance equal to its covariance
+    const double initial_log_step =
+        std::log(use_gradient ? 1.65 * std::pow(dimension, -1.0 / 6.0) : 2.38 / std::sqrt(dimension));
+    double log_step = initial_log_step;
+    size_t adaptation_start = 0;
+
+    Matrix covariance = initial_covariance;
+    Matrix factor = Eigen::LLT<Matrix>(covariance).matrixL();
+    const auto get_noise = [&]() {
+        Eigen::VectorXd noise(dimension);
+        for (int i = 0; i < dimension; ++i) {
+            noise(i) = get_normal(random_source);
+        }
+        return noise;
+    };
+    const auto move = [this](const Eigen::VectorXd &free_fluxes, const Eigen::VectorXd &step) {
+        Eigen::VectorXd moved = free_fluxes;
+        for (size_t i = 0; i < sampled_fluxes_.size(); ++i) {
+            moved(sampled_fluxes_[i]) += step(i);
+        }
+        return moved;
+    };
+
+    chain.samples.clear();
+    chain.accepted = 0;
+    chain.evaluations = 0;
+
+    // the overdispersed start around the optimum, so R-hat sees the chains come together
+    Eigen::VectorXd point = optimum;
+    Eigen::VectorXd gradient(dimension);
+    double log_posterior = -std::numeric_limits<double>::infinity();
+    for (int attempt = 0; attempt < kStartAttempts && !std::isfinite(log_posterior); ++attempt) {
+        const Eigen::VectorXd candidate = move(optimum, 2.0 * factor * get_noise());
+        if (IsFeasible(candidate)) {
+            log_posterior = GetLogPosterior(solver, candidate, use_gradient ? &gradient : nullptr);
+            ++chain.evaluations;
+            point = candidate;
+        }
+    }
+    if (!std::isfinite(log_posterior)) {
+        point = optimum;
+        log_posterior = GetLogPosterior(solver, point, use_gradient ? &gradient : nullptr);
+        ++chain.evaluations;
+    }
+
+    // the covariance is adapted at the ends of the doubling windows between the initial and the final
+    // buffers of the step adaptation, as in Stan. The proposals of every window use the previous window covariance
+    const size_t slow_begin = parameters_.burn_in * 15 / 100;
+    const size_t slow_end = parameters_.burn_in - parameters_.burn_in / 10;
+    std::vector<size_t> window_ends;
+    for (size_t window = kFirstWindow, window_end = slow_begin + window; window_end <= slow_end;
+         window *= 2, window_end += window) {
+        // the last window takes the rest of the slow phase
+        window_ends.push_back(window_end + 2 * window > slow_end ? slow_end : window_end);
+        if (window_ends.back() == slow_end) {
+            break;
+        }
+    }
+    size_t window_begin = slow_begin;
+    size_t next_window = 0;
+    Eigen::VectorXd window_mean = Eigen::VectorXd::Zero(dimension);
+    Matrix window_scatter = Matrix::Zero(dimension, dimension);
+    Eigen::VectorXd sampled_point(dimension);
+
+    const size_t total_steps = parameters_.burn_in + parameters_.total_samples * parameters_.thinning;
+    Eigen::VectorXd candidate_gradient(dimension);
+    for (size_t step_number = 0; step_number < total_steps; ++step_number) {
+        const double step = std::exp(log_step);
+        const Eigen::VectorXd noise = get_noise();
+        Eigen::VectorXd proposal_step = step * factor * noise;
+        if (use_gradient) {
+            proposal_step += 0.5 * step * step * covariance * gradient;
+        }
+        const Eigen::VectorXd candidate = move(point, proposal_step);
+
+        double acceptance = 0.0;
+        if (IsFeasible(candidate)) {
+            const double candidate_log_posterior =
+                GetLogPosterior(solver, candidate, use_gradient ? &candidate_gradient : nullptr);
+            ++chain.evaluations;
+            double log_ratio = candidate_log_posterior - log_posterior;
+            if (use_gradient && std::isfinite(candidate_log_posterior)) {
+                // log q(point | candidate) - log q(candidate | point) of q(y | x) = N(x + drift(x), step^2 covariance)
+                const Eigen::VectorXd backward_step =
+                    -proposal_step - 0.5 * step * step * covariance * candidate_gradient;
+                const Eigen::VectorXd backward_noise =
+                    factor.triangularView<Eigen::Lower>().solve(backward_step) / step;
+                log_ratio += 0.5 * (noise.squaredNorm() - backward_noise.squaredNorm());
+            }
+            acceptance = std::isfinite(log_ratio) ? std::min(1.0, std::exp(log_ratio)) : 0.0;
+            if (get_uniform(random_source) < acceptance) {
+                point = candidate;
+                log_posterior = candidate_log_posterior;
+                gradient = candidate_gradient;
+                if (step_number >= parameters_.burn_in) {
+                    ++chain.accepted;
+                }
+            }
+        }
+
+        if (step_number < parameters_.burn_in) {
+            log_step += (acceptance - target_acceptance) /
+                        std::pow(step_number - adaptation_start + 1.0, kAdaptationExponent);
+            if (next_window < window_ends.size() && step_number >= window_begin) {
+                // Welford's update of the mean and the scatter matrix
+                for (int i = 0; i < dimension; ++i) {
+                    sampled_point(i) = point(sampled_fluxes_[i]);
+                }
+                const double total = step_number - window_begin + 1.0;
+                const Eigen::VectorXd deviation = sampled_point - window_mean;
+                window_mean += deviation / total;
+                window_scatter += deviation * (sampled_point - window_mean).transpose();
+            }
+            if (next_window < window_ends.size() && step_number + 1 == window_ends[next_window]) {
+                Matrix adapted = window_scatter / (window_ends[next_window] - window_begin - 1.0);
+                for (int i = 0; i < dimension; ++i) {
+                    const double width = upper_bounds_(sampled_fluxes_[i]) - lower_bounds_(sampled_fluxes_[i]);
+                    adapted(i, i) += (kJitter * width) * (kJitter * width);
+                }
+                const Eigen::LLT<Matrix> cholesky(adapted);
+                if (cholesky.info() == Eigen::Success) {
+                    covariance = adapted;
+                    factor = cholesky.matrixL();
+                    log_step = initial_log_step;
+                    adaptation_start = step_number + 1;
+                }
+                window_begin = step_number + 1;
+                ++next_window;
+                window_mean.setZero();
+                window_scatter.setZero();
+            }
+        } else if ((step_number - parameters_.burn_in + 1) % parameters_.thinning == 0) {
+            chain.samples.push_back(point);
+            WriteSample(chain_number, chain.samples.size() - 1, log_posterior, point);
+        }
+    }
+    chain.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+
+double PosteriorSampler::GetLogPosterior(Solver &solver, const Eigen::VectorXd &free_fluxes,
+                                         Eigen::VectorXd *gradient) const {
+    Eigen::VectorXd residuals;
+    if (gradient) {
+        Matrix jacobian;
+        solver.CalculateJacobian(free_fluxes, residuals, jacobian);
+        if (!jacobian.allFinite()) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        // the gradient of -SSR / 2
+        for (size_t i = 0; i < sampled_fluxes_.size(); ++i) {
+            (*gradient)(i) = -jacobian.col(sampled_fluxes_[i]).dot(residuals);
+        }
+    } else {
+        solver.CalculateResiduals(free_fluxes, residuals);
+    }
+    const double log_posterior = -0.5 * residuals.squaredNorm();
+    return std::isfinite(log_posterior) ? log_posterior : -std::numeric_limits<double>::infinity();
+}
+
+
+bool PosteriorSampler::IsFeasible(const Eigen::VectorXd &free_fluxes) const {
+    if ((free_fluxes.array() < lower_bounds_.array()).any() || (free_fluxes.array() > upper_bounds_.array()).any()) {
+        return false;
+    }
+    const LinearConstraints &constraints = problem_.constraints;
+    return constraints.matrix.rows() == 0 ||
+           (constraints.matrix * free_fluxes - constraints.right_part).maxCoeff() <= 0.0;
+}
+
+
+void PosteriorSampler::WriteSample(size_t chain_number, size_t sample, double log_posterior,
+                                   const Eigen::VectorXd &free_fluxes) {
+    if (!output_.is_open()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    output_ << chain_number << "," << sample << "," << log_posterior;
+    for (int reaction : model_fluxes_) {
+        output_ << "," << flux_map_.coefficients.row(reaction).dot(free_fluxes) + flux_map_.offsets(reaction);
+    }
+    output_ << "\n";
+}
+} // namespace khnum
@@ -0,0 +1,221 @@
+#include "statistics/profile_likelihood.h"
+
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "solver/solver.h"
+#include "modeller/presolve_constraints.h"
+#include "utilities/workers.h"
+
+
+namespace khnum {
+namespace {
+struct ProfileEnd {
+    double value;
+    bool is_found;
+    int refits;
+    double lowest_ssr;
+};
+
+
+// Steps from the optimum towards the limit of the feasible range. The step is doubled while the SSR
+// increase per step is small and halved when it is large, so about threshold / 4 is added per step.
+// Once the threshold is crossed, the end is refined inside the bracket: sqrt(SSR increase) is interpolated
+// between the bracket ends and refitted until the increase is close to the threshold
+ProfileEnd FindProfileEnd(Solver &solver, const Eigen::VectorXd &coefficients, const Eigen::VectorXd &optimum,
+                          double optimum_ssr, double limit, double initial_step, const ProfileParameters &parameters) {
+    const double value = coefficients.dot(optimum);
+    const double direction = limit >= value ? 1.0 : -1.0;
+    ProfileEnd end{value, false, 0, optimum_ssr};
+
+    // refits at the pinned value warm-started from the point, the increase is NaN if the simulation failed
+    Eigen::VectorXd refit_point;
+    const auto refit = [&](const Eigen::VectorXd &point, double pinned_value) {
+        const Eigen::VectorXd initial_point =
+            point + coefficients * ((pinned_value - coefficients.dot(point)) / coefficients.squaredNorm());
+        solver.PinFlux(coefficients, pinned_value);
+        const StartResult result = solver.SolveFromStart(end.refits, 0, initial_point);
+        ++end.refits;
+        if (!std::isfinite(result.ssr)) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        end.lowest_ssr = std::min(end.lowest_ssr, result.ssr);
+        refit_point = Eigen::Map<const Eigen::VectorXd>(result.free_fluxes.getcontent(), result.free_fluxes.length());
+        return std::max(0.0, result.ssr - optimum_ssr);
+    };
+
+    Eigen::VectorXd point = optimum;
+    double previous_value = value;
+    double previous_increase = 0.0;
+    double step = initial_step;
+    for (int i = 0; i < parameters.max_steps && previous_value != limit; ++i) {
+        const double pinned_value = direction > 0.0 ? std::min(previous_value + step, limit)
+                                                    : std::max(previous_value - step, limit);
+        const double increase = refit(point, pinned_value);
+        if (std::isnan(increase)) {
+            break;
+        }
+        if (increase < parameters.threshold) {
+            const double step_increase = increase - previous_increase;
+            if (step_increase < parameters.threshold / 8.0) {
+                step *= 2.0;
+            } else if (step_increase > parameters.threshold / 2.0) {
+                step /= 2.0;
+            }
+            previous_value = pinned_value;
+            previous_increase = increase;
+            point = refit_point;
+            continue;
+        }
+
+        // the threshold is between the previous value and the pinned one. It's the regula falsi in sqrt(SSR
+        // increase), the outer end is moved halfway to the threshold when the inner one is replaced twice in a row,
+        // so the steep profiles don't keep the refits next to the inner end
+        const double root = std::sqrt(parameters.threshold);
+        double outer_value = pinned_value;
+        double outer_root = std::sqrt(increase);
+        bool is_inner_replaced = false;
+        for (int refinement = 0;; ++refinement) {
+            const double inner_root = std::sqrt(previous_increase);
+            end.value = previous_value + (root - inner_root) / (outer_root - inner_root) * (outer_value - previous_value);
+            end.is_found = true;
+            if (refinement == parameters.max_refinements) {
+                return end;
+            }
+            const double refined_increase = refit(point, end.value);
+            if (std::isnan(refined_increase) || std::abs(refined_increase - parameters.threshold) <=
+                                                    parameters.threshold_tolerance * parameters.threshold) {
+                return end;
+            }
+            if (refined_increase < parameters.threshold) {
+                if (is_inner_replaced) {
+                    outer_root = 0.5 * (root + outer_root);
+                }
+                is_inner_replaced = true;
+                previous_value = end.value;
+                previous_increase = refined_increase;
+                point = refit_point;
+            } else {
+                is_inner_replaced = false;
+                outer_value = end.value;
+                outer_root = std::sqrt(refined_increase);
+            }
+        }
+    }
+    end.value = previous_value;
+    return end;
+}
+} // namespace
+
+
+ProfileLikelihood::ProfileLikelihood(const Problem &problem,
+                                     const SimulatorGenerator &generator,
+                                     const SolverParameters &solver_parameters,
+                                     const ProfileParameters &parameters) :
+    ProfileLikelihood(problem, generator, solver_parameters, parameters, GetFluxMap(problem)) {
+}
+
+
+ProfileLikelihood::ProfileLikelihood(const Problem &problem,
+                                     const SimulatorGenerator &generator,
+                                     const SolverParameters &solver_parameters,
+                                     const ProfileParameters &parameters,
+                                     const FluxMap &flux_map) :
+    problem_{problem},
+    generator_{generator},
+    solver_parameters_{solver_parameters},
+    parameters_{parameters},
+    flux_map_{flux_map} {
+    // the pinned flux has to be linear in the optimizer variables
+    solver_parameters_.use_exchange_transform = false;
+    solver_parameters_.max_iterations = parameters_.max_iterations;
+    solver_parameters_.epsx = parameters_.epsx;
+}
+
+
+std::vector<FluxInterval> ProfileLikelihood::Run(const Eigen::VectorXd &optimum, double optimum_ssr,
+                                                 const std::vector<int> &reactions) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const size_t total_workers = GetTotalWorkers(parameters_.total_workers, reactions.size());
+
+    // GLPK isn't thread safe, so the feasible ranges are found before the workers start
+    std::vector<std::pair<double, double>> ranges;
+    for (int reaction : reactions) {
+        ranges.push_back(modelling_utills::GetFeasibleRange(flux_map_.coefficients.row(reaction).transpose(),
+                                                            problem_.constraints, problem_.lower_bounds,
+                                                            problem_.upper_bounds));
+    }
+
+    next_reaction_ = 0;
+    std::vector<FluxInterval> intervals(reactions.size());
+    RunWorkers(total_workers, [&](size_t) {
+        RunWorker(optimum, optimum_ssr, reactions, ranges, intervals);
+    });
+
+    int total_refits = 0;
+    double lowest_ssr = optimum_ssr;
+    for (const FluxInterval &interval : intervals) {
+        total_refits += interval.refits;
+        lowest_ssr = std::min(lowest_ssr, interval.lowest_ssr);
+    }
+    std::cout << "Profile likelihood: " << intervals.size() << " fluxes, " << total_refits << " refits on "
+              << total_workers << " workers in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+              << " seconds, SSR threshold " << optimum_ssr << " + " << parameters_.threshold << std::endl;
+    // the unfound ends are marked with *
+    for (const FluxInterval &interval : intervals) {
+        std::cout << " " << interval.name << ": " << interval.value << " [" << interval.lower
+                  << (interval.is_lower_found ? "" : "*") << ", " << interval.upper
+                  << (interval.is_upper_found ? "" : "*") << "]" << std::endl;
+    }
+    if (optimum_ssr - lowest_ssr > 1.e-3 * parameters_.threshold) {
+        std::cout << "Profile likelihood found SSR " << lowest_ssr << " lower than the optimum's" << std::endl;
+    }
+    return intervals;
+}
+
+
+void ProfileLikelihood::RunWorker(const Eigen::VectorXd &optimum, double optimum_ssr,
+                                  const std::vector<int> &reactions,
+                                  const std::vector<std::pair<double, double>> &ranges,
+                                  std::vector<FluxInterval> &intervals) {
+    Solver solver(problem_, generator_, solver_parameters_);
+    for (size_t i = next_reaction_++; i < reactions.size(); i = next_reaction_++) {
+        const int reaction = reactions[i];
+        const Eigen::VectorXd coefficients = flux_map_.coefficients.row(reaction).transpose();
+        FluxInterval &interval = intervals[i];
+        interval.reaction = reaction;
+        interval.name = problem_.reactions.at(reaction).name;
+        interval.value = flux_map_.offsets(reaction) + coefficients.dot(optimum);
+        interval.lower = interval.value;
+        interval.upper = interval.value;
+        interval.is_lower_found = false;
+        interval.is_upper_found = false;
+        interval.refits = 0;
+        interval.lowest_ssr = optimum_ssr;
+        if (coefficients.isZero()) {
+            continue;
+        }
+
+        // the ranges and the walk are in the coefficients of the free fluxes, without the offset
+        const std::pair<double, double> &range = ranges[i];
+        const double optimum_value = coefficients.dot(optimum);
+        const double initial_step = std::max(parameters_.initial_step * (range.second - range.first), 1.e-9);
+        const ProfileEnd lower = FindProfileEnd(solver, coefficients, optimum, optimum_ssr,
+                                                std::min(range.first, optimum_value), initial_step, parameters_);
+        const ProfileEnd upper = FindProfileEnd(solver, coefficients, optimum, optimum_ssr,
+                                                std::max(range.second, optimum_value), initial_step, parameters_);
+        solver.UnpinFlux();
+
+        interval.lower = flux_map_.offsets(reaction) + lower.value;
+        interval.upper = flux_map_.offsets(reaction) + upper.value;
+        interval.is_lower_found = lower.is_found;
+        interval.is_upper_found = upper.is_found;
+        interval.refits = lower.refits + upper.refits;
+        interval.lowest_ssr = std::min(lower.lowest_ssr, upper.lowest_ssr);
+    }
+}
+} // namespace khnum
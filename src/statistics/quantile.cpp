@@ -0,0 +1,17 @@
+#include "statistics/quantile.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+namespace khnum {
+double GetQuantile(const std::vector<double> &sorted_values, double probability) {
+    if (sorted_values.empty()) {
+        return std::nan("");
+    }
+    const double position = probability * (sorted_values.size() - 1);
+    const size_t lower = static_cast<size_t>(std::floor(position));
+    const size_t upper = std::min(lower + 1, sorted_values.size() - 1);
+    return sorted_values[lower] + (position - lower) * (sorted_values[upper] - sorted_values[lower]);
+}
+} // namespace khnum
@@ -48,4 +48,15 @@ bool operator==(const EmuReaction &lhs, const EmuReaction &rhs) {
         }
     }
 }
-} //namespace khnum
\ No newline at end of file
+} //namespace khnum
+
+
+namespace std {
+size_t hash<khnum::Emu>::operator()(const khnum::Emu &emu) const {
+    size_t result = hash<string>()(emu.name);
+    for (const char state : emu.atom_states) {
+        result = result * 31 + static_cast<size_t>(state != 0);
+    }
+    return result;
+}
+} // namespace std
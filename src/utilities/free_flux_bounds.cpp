@@ -0,0 +1,15 @@
+#include "utilities/free_flux_bounds.h"
+
+
+namespace khnum {
+std::pair<Eigen::VectorXd, Eigen::VectorXd> GetFreeFluxBounds(const Problem &problem) {
+    const int nullity = problem.nullspace.cols();
+    Eigen::VectorXd lower_bounds(nullity);
+    Eigen::VectorXd upper_bounds(nullity);
+    for (int i = 0; i < nullity; ++i) {
+        lower_bounds(i) = problem.lower_bounds[i];
+        upper_bounds(i) = problem.upper_bounds[i];
+    }
+    return {lower_bounds, upper_bounds};
+}
+} // namespace khnum
@@ -0,0 +1,9 @@
+#include "utilities/random_source.h"
+
+
+namespace khnum {
+std::mt19937 CreateRandomSource(uint64_t seed) {
+    std::seed_seq seed_sequence{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+    return std::mt19937(seed_sequence);
+}
+} // namespace khnum
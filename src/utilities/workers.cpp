@@ -0,0 +1,43 @@
+#include "utilities/workers.h"
+
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+
+namespace khnum {
+size_t GetTotalWorkers(size_t requested_workers, size_t total_tasks) {
+    if (requested_workers == 0) {
+        requested_workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max<size_t>(1, std::min(requested_workers, total_tasks));
+}
+
+
+void RunWorkers(size_t total_workers, const std::function<void(size_t worker)> &run_worker,
+                std::atomic<bool> *is_failed) {
+    std::vector<std::exception_ptr> errors(total_workers);
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < total_workers; ++worker) {
+        workers.emplace_back([&run_worker, &errors, is_failed, worker]() {
+            try {
+                run_worker(worker);
+            } catch (...) {
+                errors[worker] = std::current_exception();
+                if (is_failed) {
+                    *is_failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+} // namespace khnum
@@ -0,0 +1,76 @@
+#include <cmath>
+#include <limits>
+#include <string>
+#include <stdexcept>
+
+#include "catch/catch.hpp"
+#include "modeller/create_nullspace.h"
+#include "utilities/reaction.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+
+TEST_CASE("GetNullspaceWithPivotedQR()", "[Modelling Utils]") {
+    // A -> B, B -> C, B -> D, C -> E, D -> E, the third balance is the sum of the first two
+    Matrix stoichiometry(3, 5);
+    stoichiometry << 1.0, -1.0, -1.0,  0.0,  0.0,
+                     0.0,  1.0,  0.0, -1.0,  0.0,
+                     1.0,  0.0, -1.0, -1.0,  0.0;
+    std::vector<Reaction> reactions(5);
+    for (int i = 0; i < 5; ++i) {
+        reactions[i].id = i;
+        reactions[i].basis = std::numeric_limits<double>::quiet_NaN();
+        reactions[i].is_set_free = false;
+    }
+    // the fixed flux must stay free
+    reactions[0].basis = 1.0;
+
+    const Matrix nullspace = GetNullspaceWithPivotedQR(stoichiometry, reactions);
+
+    REQUIRE(nullspace.rows() == 2);
+    REQUIRE(nullspace.cols() == 3);
+    REQUIRE(reactions[4].id == 0);
+
+    // S * [-A; I] = 0 in the new reaction order
+    Matrix ordered(3, 5);
+    for (int i = 0; i < 5; ++i) {
+        ordered.col(i) = stoichiometry.col(reactions[i].id);
+    }
+    Matrix fluxes(5, 3);
+    fluxes << -nullspace, Matrix::Identity(3, 3);
+    REQUIRE((ordered * fluxes).norm() == Approx(0.0).margin(1.e-12));
+}
+
+
+TEST_CASE("GetNullspaceWithPivotedQR() without enough candidates", "[Modelling Utils]") {
+    // A -> B, B -> C, B -> D, C -> E, D -> E
+    Matrix stoichiometry(2, 5);
+    stoichiometry << 1.0, -1.0, -1.0,  0.0,  0.0,
+                     0.0,  1.0,  0.0, -1.0,  0.0;
+    std::vector<Reaction> reactions(5);
+    for (int i = 0; i < 5; ++i) {
+        reactions[i].id = i;
+        reactions[i].name = "v" + std::to_string(i);
+        reactions[i].basis = 1.0;
+        reactions[i].deviation = std::numeric_limits<double>::quiet_NaN();
+        reactions[i].is_set_free = false;
+    }
+    // only one candidate for the two dependent fluxes
+    reactions[0].basis = std::numeric_limits<double>::quiet_NaN();
+
+    SECTION("A fixed flux can't become dependent") {
+        REQUIRE_THROWS_AS(GetNullspaceWithPivotedQR(stoichiometry, reactions), std::runtime_error);
+    }
+
+    SECTION("A set free flux becomes dependent") {
+        for (int i = 1; i < 5; ++i) {
+            reactions[i].basis = std::numeric_limits<double>::quiet_NaN();
+            reactions[i].is_set_free = true;
+        }
+        const Matrix nullspace = GetNullspaceWithPivotedQR(stoichiometry, reactions);
+        REQUIRE(nullspace.rows() == 2);
+        REQUIRE(nullspace.cols() == 3);
+        REQUIRE(reactions[0].id == 0);
+    }
+}
@@ -0,0 +1,117 @@
+#include "catch/catch.hpp"
+#include "modeller/merge_equivalent_emus.h"
+#include "modeller/create_network_components.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+namespace {
+EmuReaction MakeEmuReaction(int id, const std::vector<Emu> &left, const Emu &right) {
+    EmuReaction reaction;
+    reaction.id = id;
+    for (const Emu &emu : left) {
+        reaction.left.push_back({emu, 1.0});
+    }
+    reaction.right = {right, 1.0};
+    return reaction;
+}
+} // namespace
+
+
+TEST_CASE("MergeEquivalentEmus()", "[Modelling Utils]") {
+    const Emu A{"A", {1, 1}};
+    const Emu B{"B", {1, 1}};
+    const Emu C{"C", {1, 1}};
+    const Emu D{"D", {1, 1}};
+    const Emu E{"E", {1, 0}};
+    const Emu F{"F", {1, 0}};
+    const Emu G{"G", {1, 1}};
+
+    SECTION("Pass-Through Chain") {
+        // A -> B -> C -> D, measured D
+        const std::vector<EmuReaction> reactions = {MakeEmuReaction(0, {A}, B),
+                                                    MakeEmuReaction(1, {B}, C),
+                                                    MakeEmuReaction(2, {C}, D)};
+        const std::vector<EmuReaction> result = MergeEquivalentEmus(reactions, {D}, {A});
+        REQUIRE(result.size() == 1);
+        REQUIRE(result[0] == MakeEmuReaction(2, {A}, D));
+    }
+
+    SECTION("Different Substrates") {
+        // A -> B, C -> B, B -> D, measured D
+        const std::vector<EmuReaction> reactions = {MakeEmuReaction(0, {A}, B),
+                                                    MakeEmuReaction(1, {C}, B),
+                                                    MakeEmuReaction(2, {B}, D)};
+        const std::vector<EmuReaction> result = MergeEquivalentEmus(reactions, {D}, {A, C});
+        REQUIRE(result.size() == 3);
+    }
+
+    SECTION("Equivalent After Merging") {
+        // A -> B -> C, A -> C, E + F -> G, C -> G, measured G
+        const std::vector<EmuReaction> reactions = {MakeEmuReaction(0, {A}, B),
+                                                    MakeEmuReaction(1, {B}, C),
+                                                    MakeEmuReaction(2, {A}, C),
+                                                    MakeEmuReaction(3, {E, F}, G),
+                                                    MakeEmuReaction(4, {C}, G)};
+        const std::vector<EmuReaction> result = MergeEquivalentEmus(reactions, {G}, {A, E, F});
+        REQUIRE(result.size() == 2);
+        REQUIRE(result[0] == MakeEmuReaction(3, {E, F}, G));
+        REQUIRE(result[1] == MakeEmuReaction(4, {A}, G));
+    }
+}
+
+TEST_CASE("GetNetworksSize()", "[Modelling Utils]") {
+    const Emu A{"A", {1}};
+    const Emu B{"B", {1}};
+    const Emu C{"C", {1}};
+
+    EmuReaction first;
+    first.left = {{A, 1.0}};
+    first.right = {B, 1.0};
+    EmuReaction second;
+    second.left = {{B, 1.0}};
+    second.right = {C, 1.0};
+    EmuReaction third;
+    third.left = {{A, 1.0}};
+    third.right = {C, 1.0};
+
+    const auto [total_unknowns, largest_network] = GetNetworksSize({{first, second, third}, {third}});
+    REQUIRE(total_unknowns == 3);
+    REQUIRE(largest_network == 2);
+    REQUIRE(GetUnknownEmusCount({first, second, third}) == 2);
+}
+
+
+TEST_CASE("GetLargestNetworkSize()", "[Modelling Utils]") {
+    const Emu A{"A", {1, 1}};
+    const Emu B{"B", {1, 1}};
+    const Emu C{"C", {1, 1}};
+    const Emu D{"D", {1, 1}};
+    const Emu E{"E", {1, 0}};
+    const Emu F{"F", {0, 1}};
+
+    SECTION("No cycles") {
+        // A -> B -> C
+        REQUIRE(GetLargestNetworkSize({MakeEmuReaction(0, {A}, B), MakeEmuReaction(1, {B}, C)}, {A}) == 1);
+    }
+
+    SECTION("The same as the built components") {
+        // A -> B <-> C -> D -> B, E + F -> D
+        const std::vector<EmuReaction> reactions = {MakeEmuReaction(0, {A}, B),
+                                                    MakeEmuReaction(1, {B}, C),
+                                                    MakeEmuReaction(2, {C}, B),
+                                                    MakeEmuReaction(3, {C}, D),
+                                                    MakeEmuReaction(4, {E, F}, D),
+                                                    MakeEmuReaction(5, {D}, B)};
+        REQUIRE(GetLargestNetworkSize(reactions, {A, E, F}) == 3);
+        REQUIRE(GetLargestNetworkSize(reactions, {A, E, F}) ==
+                GetNetworksSize(CreateNetworkComponents(reactions)).second);
+    }
+
+    SECTION("The input EMUs are known") {
+        // A <-> B, input A
+        const std::vector<EmuReaction> reactions = {MakeEmuReaction(0, {A}, B), MakeEmuReaction(1, {B}, A)};
+        REQUIRE(GetLargestNetworkSize(reactions, {}) == 2);
+        REQUIRE(GetLargestNetworkSize(reactions, {A}) == 1);
+    }
+}
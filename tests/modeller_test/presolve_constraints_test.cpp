@@ -0,0 +1,37 @@
+#include <cmath>
+
+#include "catch/catch.hpp"
+#include "modeller/presolve_constraints.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+
+TEST_CASE("PresolveConstraints()", "[Modelling Utils]") {
+    // 0 <= x0, x1 <= 10, x2 = 1
+    std::vector<double> lower_bounds = {0.0, 0.0, 1.0};
+    std::vector<double> upper_bounds = {10.0, 10.0, 1.0};
+    Matrix nullspace(6, 3);
+    nullspace << 1.0, 1.0, -4.0,    // x0 + x1 <= 4
+                 2.0, 2.0, -10.0,   // x0 + x1 <= 5, parallel to the first row
+                 1.0, 0.0, -20.0,   // x0 <= 20, implied by the bounds
+                 1.0, -1.0, -1.0,   // x0 - x1 <= 1
+                 1.0, 0.0, -3.0,    // x0 <= 3, implied by the tightened bounds
+                 3.0, 1.0, -10.0;   // 3 * x0 + x1 <= 10, implied by the first and the fourth rows
+
+    const LinearConstraints constraints = PresolveConstraints(nullspace, lower_bounds, upper_bounds);
+
+    REQUIRE(constraints.matrix.rows() == 2);
+    REQUIRE(constraints.matrix(0, 0) == Approx(1.0 / std::sqrt(2.0)));
+    REQUIRE(constraints.matrix(0, 1) == Approx(1.0 / std::sqrt(2.0)));
+    REQUIRE(constraints.matrix(0, 2) == 0.0);
+    REQUIRE(constraints.right_part(0) == Approx(4.0 / std::sqrt(2.0)));
+    REQUIRE(constraints.matrix(1, 1) == Approx(-1.0 / std::sqrt(2.0)));
+    REQUIRE(constraints.right_part(1) == Approx(1.0 / std::sqrt(2.0)));
+
+    // the extreme values are x0 = 2.5 at (2.5, 1.5) and x1 = 4 at (0, 4)
+    REQUIRE(lower_bounds == std::vector<double>{0.0, 0.0, 1.0});
+    REQUIRE(upper_bounds[0] == Approx(2.5));
+    REQUIRE(upper_bounds[1] == Approx(4.0));
+    REQUIRE(upper_bounds[2] == 1.0);
+}
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <algorithm>
+#include <string>
+
+#include "catch/catch.hpp"
+#include "simulator/generator.h"
+
+using namespace khnum;
+
+namespace {
+// Input -> E1 <-> E2 <-> ... <-> En, the last emu is measured
+GeneratorParameters CreateChainModel(size_t emus_total) {
+    const int forward_flux = 0;
+    const int backward_flux = 1;
+
+    GeneratorParameters parameters;
+    const Emu input{"Input", {1}};
+    parameters.input_mids.push_back({input, {0.5, 0.5}});
+
+    std::vector<Emu> emus;
+    for (size_t i = 0; i < emus_total; ++i) {
+        emus.push_back(Emu{"E" + std::to_string(i), {1}});
+    }
+
+    EmuNetwork network;
+    network.push_back(EmuReaction{forward_flux, {{input, 1.0}}, {emus[0], 1.0}, 1.0});
+    for (size_t i = 0; i + 1 < emus_total; ++i) {
+        network.push_back(EmuReaction{forward_flux, {{emus[i], 1.0}}, {emus[i + 1], 1.0}, 1.0});
+        network.push_back(EmuReaction{backward_flux, {{emus[i + 1], 1.0}}, {emus[i], 1.0}, 1.0});
+    }
+    parameters.networks.push_back(network);
+
+    Measurement measurement;
+    measurement.emu = emus.back();
+    measurement.mid = {0.5, 0.5};
+    measurement.errors = {0.01, 0.01};
+    measurement.correction_matrix = Matrix::Identity(2, 2);
+    parameters.measurements.push_back(measurement);
+    parameters.measured_isotopes.push_back(measurement.emu);
+
+    parameters.nullspace = Matrix::Zero(0, 2);
+    parameters.free_flux_id_to_nullspace_position = {-1, -1};
+    parameters.free_fluxes_id = {forward_flux, backward_flux};
+    return parameters;
+}
+
+double MeasureGenerationTime(const GeneratorParameters &parameters) {
+    double best_time = std::numeric_limits<double>::max();
+    for (int run = 0; run < 3; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        SimulatorGenerator generator(parameters);
+        const auto end = std::chrono::steady_clock::now();
+        best_time = std::min(best_time, std::chrono::duration<double>(end - start).count());
+    }
+    return best_time;
+}
+} // namespace
+
+
+TEST_CASE("SimulatorGenerator system size", "[Simulator]") {
+    for (size_t emus_total : {2, 10, 2000}) {
+        const std::vector<NetworkSystemSize> sizes = SimulatorGenerator(CreateChainModel(emus_total)).GetSystemSizes();
+        REQUIRE(sizes.size() == 1);
+        REQUIRE(sizes[0].unknown_emus == emus_total);
+        REQUIRE(sizes[0].known_emus == 1);
+        // the diagonal and the two neighbours of the chain
+        REQUIRE(sizes[0].A_nonzeros == 3 * emus_total - 2);
+        REQUIRE(sizes[0].B_nonzeros == 1);
+    }
+}
+
+
+// Hidden, run it by its name. A quadratic generation would be 64 times slower
+TEST_CASE("SimulatorGenerator scaling benchmark", "[.][benchmark]") {
+    const size_t small_model = 2000;
+    const size_t scale = 8;
+
+    const double small_model_time = MeasureGenerationTime(CreateChainModel(small_model));
+    const double large_model_time = MeasureGenerationTime(CreateChainModel(scale * small_model));
+    WARN("Generation of " << small_model << " EMUs: " << small_model_time << " seconds, of " << scale * small_model
+         << " EMUs: " << large_model_time << " seconds");
+}
@@ -0,0 +1,70 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "catch/catch.hpp"
+#include "simulator/generator.h"
+#include "solver/solver.h"
+#include "utilities/free_flux_bounds.h"
+#include "../solver_test/solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+// modelTiny with the A -> H -> F branch, it changes only the network of F:111,
+// so the sensitivities of the other networks by the branch flux are skipped
+const std::string kLooselyCoupledModel = kTinyModel +
+    "R8,A = H,abc = abc,,F,,\n"
+    "R9,H = F,abc = abc,,F,,\n";
+
+// The jacobian of the skipped sensitivities must be the central finite differences of the residuals
+void CheckJacobian(const Problem &problem, const SimulatorGenerator &generator) {
+    Solver solver(problem, generator);
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const Eigen::VectorXd point = 0.5 * (lower_bounds + upper_bounds);
+    Eigen::VectorXd residuals;
+    Matrix jacobian;
+    solver.CalculateJacobian(point, residuals, jacobian);
+    REQUIRE(jacobian.allFinite());
+    REQUIRE(jacobian.cols() == point.size());
+
+    for (int flux = 0; flux < point.size(); ++flux) {
+        const double step = 1.e-6 * std::max(1.0, std::abs(point(flux)));
+        Eigen::VectorXd forward_residuals;
+        Eigen::VectorXd backward_residuals;
+        Eigen::VectorXd shifted_point = point;
+        shifted_point(flux) = point(flux) + step;
+        solver.CalculateResiduals(shifted_point, forward_residuals);
+        shifted_point(flux) = point(flux) - step;
+        solver.CalculateResiduals(shifted_point, backward_residuals);
+        const Eigen::VectorXd differences = (forward_residuals - backward_residuals) / (2.0 * step);
+        for (int residual = 0; residual < residuals.size(); ++residual) {
+            REQUIRE(jacobian(residual, flux) == Approx(differences(residual)).margin(1.e-5).epsilon(1.e-4));
+        }
+    }
+}
+} // namespace
+
+
+TEST_CASE("Skipped sensitivities", "[Simulator]") {
+    SECTION("modelTiny") {
+        const Problem problem = CreateTinyProblem();
+        const SimulatorGenerator generator(problem.simulator_parameters_);
+        CheckJacobian(problem, generator);
+    }
+
+    SECTION("loosely coupled networks") {
+        const Problem problem = CreateTinyProblem(kLooselyCoupledModel);
+        const SimulatorGenerator generator(problem.simulator_parameters_);
+        const size_t total_free_fluxes = problem.nullspace.cols();
+        size_t total_skipped = 0;
+        for (const std::vector<size_t> &influencing_fluxes : generator.GetInfluencingFluxes()) {
+            REQUIRE(influencing_fluxes.size() <= total_free_fluxes);
+            total_skipped += total_free_fluxes - influencing_fluxes.size();
+        }
+        REQUIRE(total_skipped > 0);
+        CheckJacobian(problem, generator);
+    }
+}
@@ -0,0 +1,114 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include "catch/catch.hpp"
+#include "solver/batch_fitter.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+TEST_CASE("ReadBatchDataset()", "[Solver]") {
+    Problem problem;
+    Measurement measurement;
+    measurement.emu = {"ASP", {1, 1}};
+    measurement.mid = {0.5, 0.3, 0.2};
+    measurement.errors = {0.01, 0.01, 0.01};
+    problem.measurements = {measurement};
+
+    const std::string path = GetUniqueTempPath("batch_sample") + ".csv";
+
+    SECTION("The values and the errors are of the sample") {
+        std::ofstream(path) << "measurements,error\n0.2,0.02\n0.4,0.03\n0.4,0.04\n";
+        const BatchDataset dataset = ReadBatchDataset(path, problem);
+        REQUIRE(dataset.name == std::filesystem::path(path).stem().string());
+        REQUIRE(dataset.measurements.size() == 1);
+        REQUIRE(dataset.measurements[0].emu.name == "ASP");
+        REQUIRE(dataset.measurements[0].mid == Mid{0.2, 0.4, 0.4});
+        REQUIRE(dataset.measurements[0].errors == Errors{0.02, 0.03, 0.04});
+    }
+
+    SECTION("The MIDs are normalized") {
+        std::ofstream(path) << "measurements,error\n0.4,0.02\n0.8,0.03\n0.8,0.04\n";
+        const BatchDataset dataset = ReadBatchDataset(path, problem);
+        REQUIRE(dataset.measurements[0].mid[0] == Approx(0.2));
+    }
+
+    SECTION("The sample must have all the measured values") {
+        std::ofstream(path) << "measurements,error\n0.2,0.02\n0.4,0.03\n";
+        REQUIRE_THROWS_AS(ReadBatchDataset(path, problem), std::runtime_error);
+    }
+
+    std::filesystem::remove(path);
+}
+
+
+TEST_CASE("BatchFitter", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    // the alglib optimizer stops at the start points of the tiny problem
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+    BatchParameters parameters;
+    parameters.starts_per_dataset = 3;
+    parameters.total_workers = 2;
+    parameters.master_seed = 3;
+    parameters.output_path = GetUniqueTempPath("batch_output") + ".csv";
+
+    // the samples of modelTiny with the first value of every MID raised by 5% more per sample
+    std::vector<BatchDataset> datasets;
+    for (int sample = 0; sample < 3; ++sample) {
+        BatchDataset dataset{"sample" + std::to_string(sample), problem.measurements};
+        for (Measurement &measurement : dataset.measurements) {
+            measurement.mid[0] *= 1.0 + 0.05 * sample;
+            double sum = 0.0;
+            for (double value : measurement.mid) {
+                sum += value;
+            }
+            for (double &value : measurement.mid) {
+                value /= sum;
+            }
+        }
+        datasets.push_back(dataset);
+    }
+    const auto count_lines = [&parameters]() {
+        std::ifstream input(parameters.output_path);
+        size_t total_lines = 0;
+        for (std::string line; std::getline(input, line);) {
+            ++total_lines;
+        }
+        return total_lines;
+    };
+
+    SECTION("Every dataset but the first is warm-started from the previous optimum") {
+        const std::vector<BatchResult> results = BatchFitter(problem, generator, solver_parameters, parameters)
+            .Run(datasets);
+        REQUIRE(results.size() == datasets.size());
+        for (size_t dataset = 0; dataset < results.size(); ++dataset) {
+            REQUIRE(results[dataset].best_result.has_value());
+            REQUIRE(results[dataset].total_starts == parameters.starts_per_dataset + (dataset > 0 ? 1 : 0));
+        }
+        // the header and a line per dataset
+        REQUIRE(count_lines() == datasets.size() + 1);
+    }
+
+    SECTION("The dataset after the one without an optimum has no warm start") {
+        for (Measurement &measurement : datasets[1].measurements) {
+            measurement.mid.assign(measurement.mid.size(), std::nan(""));
+        }
+        const std::vector<BatchResult> results = BatchFitter(problem, generator, solver_parameters, parameters)
+            .Run(datasets);
+        REQUIRE(results[0].best_result.has_value());
+        REQUIRE_FALSE(results[1].best_result.has_value());
+        REQUIRE(results[1].total_starts == parameters.starts_per_dataset + 1);
+        REQUIRE(results[2].best_result.has_value());
+        REQUIRE(results[2].total_starts == parameters.starts_per_dataset);
+        REQUIRE_FALSE(results[2].is_best_warm);
+        REQUIRE(count_lines() == datasets.size() + 1);
+    }
+
+    std::filesystem::remove(parameters.output_path);
+}
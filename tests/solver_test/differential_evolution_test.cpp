@@ -0,0 +1,111 @@
+#include <random>
+#include <algorithm>
+
+#include "catch/catch.hpp"
+#include "solver/differential_evolution.h"
+#include "solver/polytope_sampler.h"
+#include "utilities/free_flux_bounds.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+TEST_CASE("DifferentialEvolution::GetFeasibleStep()", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const DifferentialEvolution evolution(problem, generator, SolverParameters(), DifferentialEvolutionParameters());
+
+    const int nullity = problem.nullspace.cols();
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const LinearConstraints &constraints = problem.constraints;
+    const Eigen::VectorXd parent =
+        PolytopeSampler(lower_bounds, upper_bounds, constraints.matrix, constraints.right_part).GetCenter();
+    // the smallest slack of the bounds and the constraints, it's zero on the boundary
+    const auto get_slack = [&](const Eigen::VectorXd &point) {
+        double slack = std::min((point - lower_bounds).minCoeff(), (upper_bounds - point).minCoeff());
+        if (constraints.matrix.rows() > 0) {
+            slack = std::min(slack, (constraints.right_part - constraints.matrix * point).minCoeff());
+        }
+        return slack;
+    };
+
+    SECTION("The feasible trial isn't clipped") {
+        REQUIRE(evolution.GetFeasibleStep(parent, Eigen::VectorXd::Zero(nullity)) == 1.0);
+        Eigen::VectorXd direction = Eigen::VectorXd::Zero(nullity);
+        direction(nullity - 1) = 1.e-3 * get_slack(parent);
+        REQUIRE(evolution.GetFeasibleStep(parent, direction) == 1.0);
+    }
+
+    SECTION("The infeasible trial is clipped on the boundary") {
+        std::mt19937 random_source(3);
+        std::normal_distribution<> get_normal(0.0, 1.0);
+        const double width = (upper_bounds - lower_bounds).maxCoeff();
+        for (int trial = 0; trial < 100; ++trial) {
+            Eigen::VectorXd direction(nullity);
+            for (int i = 0; i < nullity; ++i) {
+                // the fixed free fluxes can't move
+                direction(i) = lower_bounds(i) < upper_bounds(i) ? 10.0 * width * get_normal(random_source) : 0.0;
+            }
+            const double step = evolution.GetFeasibleStep(parent, direction);
+            REQUIRE(step < 1.0);
+            REQUIRE(get_slack(parent + step * direction) == Approx(0.0).margin(1.e-9 * width));
+        }
+    }
+
+    SECTION("No step out of the boundary") {
+        Eigen::VectorXd direction = Eigen::VectorXd::Zero(nullity);
+        for (int i = 0; i < nullity; ++i) {
+            if (lower_bounds(i) < upper_bounds(i)) {
+                direction(i) = upper_bounds(i) - lower_bounds(i);
+                break;
+            }
+        }
+        const Eigen::VectorXd on_boundary = parent + evolution.GetFeasibleStep(parent, direction) * direction;
+        REQUIRE(evolution.GetFeasibleStep(on_boundary, direction) == Approx(0.0).margin(1.e-12));
+    }
+}
+
+
+TEST_CASE("DifferentialEvolution::Run()", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    // the alglib optimizer stops at the start points of the tiny problem
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+    DifferentialEvolutionParameters parameters;
+    parameters.total_polished = 4;
+    parameters.total_workers = 2;
+    parameters.master_seed = 17;
+    // only the target stops the search, the optimum of the multistarts is 851.666
+    parameters.max_generations = 1000;
+    parameters.tolerance = 0.0;
+    parameters.target_ssr = 852.0;
+
+    DifferentialEvolution evolution(problem, generator, solver_parameters, parameters);
+    const std::vector<StartResult> results = evolution.Run();
+    const DifferentialEvolutionReport &report = evolution.GetReport();
+    REQUIRE(report.is_target_reached);
+    REQUIRE(report.generations < parameters.max_generations);
+    REQUIRE(!results.empty());
+    REQUIRE(results.size() <= parameters.total_polished);
+    REQUIRE(report.candidate_ssr.size() == results.size());
+    REQUIRE(report.candidate_ssr.front() <= *parameters.target_ssr);
+
+    // the polishing keeps the candidates feasible and doesn't make them worse
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const LinearConstraints &constraints = problem.constraints;
+    const double tolerance = 1.e-9 * (upper_bounds - lower_bounds).maxCoeff();
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Eigen::VectorXd point = Eigen::Map<const Eigen::VectorXd>(results[i].free_fluxes.getcontent(),
+                                                                         results[i].free_fluxes.length());
+        REQUIRE((point - lower_bounds).minCoeff() >= -tolerance);
+        REQUIRE((upper_bounds - point).minCoeff() >= -tolerance);
+        if (constraints.matrix.rows() > 0) {
+            REQUIRE((constraints.right_part - constraints.matrix * point).minCoeff() >= -tolerance);
+        }
+        REQUIRE(results[i].ssr <= report.candidate_ssr[i]);
+        if (i > 0) {
+            REQUIRE(report.candidate_ssr[i - 1] <= report.candidate_ssr[i]);
+        }
+    }
+}
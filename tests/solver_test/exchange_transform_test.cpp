@@ -0,0 +1,28 @@
+#include "catch/catch.hpp"
+#include "solver/exchange_transform.h"
+
+using namespace khnum;
+
+
+TEST_CASE("ExchangeTransform", "[Solver]") {
+    const ExchangeTransform transform({1}, 2.0);
+    const Eigen::Vector3d free_fluxes(5.0, 6.0, -1.0);
+
+    Eigen::VectorXd variables = free_fluxes;
+    transform.ToVariables(variables);
+    REQUIRE(variables(0) == 5.0);
+    REQUIRE(variables(1) == Approx(0.75));
+    REQUIRE(variables(2) == -1.0);
+
+    Eigen::VectorXd fluxes = variables;
+    transform.ToFluxes(fluxes);
+    REQUIRE(fluxes(1) == Approx(6.0));
+
+    // d flux / d variable = 2 / (1 - 0.75)^2
+    Matrix jacobian = Matrix::Ones(2, 3);
+    JacobianMap jacobian_map(jacobian.data(), 2, 3, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(2, 1));
+    transform.ScaleJacobian(variables, jacobian_map);
+    REQUIRE(jacobian(0, 0) == 1.0);
+    REQUIRE(jacobian(1, 1) == Approx(32.0));
+    REQUIRE(jacobian(1, 2) == 1.0);
+}
@@ -0,0 +1,64 @@
+#include "catch/catch.hpp"
+#include "solver/identifiability.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+// the fixed free fluxes aren't checked
+int GetVariableFreeFluxesCount(const Problem &problem) {
+    int total_variable = 0;
+    for (int i = 0; i < problem.nullspace.cols(); ++i) {
+        total_variable += problem.lower_bounds[i] < problem.upper_bounds[i];
+    }
+    return total_variable;
+}
+} // namespace
+
+
+TEST_CASE("CheckIdentifiability()", "[Solver]") {
+    SECTION("The free fluxes of the tiny model are identifiable") {
+        const Problem problem = CreateTinyProblem();
+        const SimulatorGenerator generator(problem.simulator_parameters_);
+        const IdentifiabilityReport report = CheckIdentifiability(problem, generator, 42);
+        REQUIRE(report.total_points == 10);
+        REQUIRE(report.rank == GetVariableFreeFluxesCount(problem));
+        REQUIRE(report.null_directions.cols() == 0);
+        REQUIRE(report.non_identifiable.empty());
+    }
+
+    SECTION("The split of two parallel reactions isn't identifiable") {
+        Problem problem = CreateTinyProblem(kTinyModel + "R8,B = D,abc = abc,,F,,\n");
+        const SimulatorGenerator generator(problem.simulator_parameters_);
+        const IdentifiabilityReport report = CheckIdentifiability(problem, generator, 42);
+        REQUIRE(report.rank == GetVariableFreeFluxesCount(problem) - 1);
+        REQUIRE(report.null_directions.cols() == 1);
+        REQUIRE(report.non_identifiable.size() == 1);
+
+        FixNonIdentifiableFluxes(report, problem);
+        const int fixed = report.non_identifiable[0];
+        REQUIRE(problem.lower_bounds[fixed] == problem.upper_bounds[fixed]);
+        REQUIRE(CheckIdentifiability(problem, generator, 42).non_identifiable.empty());
+    }
+
+    SECTION("The check of the polytope without the interior is skipped") {
+        Problem problem = CreateTinyProblem();
+        const SimulatorGenerator generator(problem.simulator_parameters_);
+        int flux = 0;
+        while (problem.lower_bounds[flux] == problem.upper_bounds[flux]) {
+            ++flux;
+        }
+        // flux <= its lower bound
+        LinearConstraints &constraints = problem.constraints;
+        constraints.matrix.conservativeResize(constraints.matrix.rows() + 1, problem.nullspace.cols());
+        constraints.matrix.row(constraints.matrix.rows() - 1).setZero();
+        constraints.matrix(constraints.matrix.rows() - 1, flux) = 1.0;
+        constraints.right_part.conservativeResize(constraints.right_part.size() + 1);
+        constraints.right_part(constraints.right_part.size() - 1) = problem.lower_bounds[flux];
+
+        const IdentifiabilityReport report = CheckIdentifiability(problem, generator, 42);
+        REQUIRE(report.total_points == 0);
+        REQUIRE(report.non_identifiable.empty());
+    }
+}
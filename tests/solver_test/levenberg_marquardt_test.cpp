@@ -0,0 +1,77 @@
+#include <cmath>
+
+#include "catch/catch.hpp"
+#include "solver/levenberg_marquardt.h"
+
+using namespace khnum;
+
+namespace {
+// r_i = x0 * exp(x1 * t_i) - y_i
+LeastSquaresFunctions GetExponentialFit(const std::vector<double> &times, const std::vector<double> &values) {
+    LeastSquaresFunctions functions;
+    functions.residuals = [times, values](const Eigen::VectorXd &x, Eigen::VectorXd &residuals) {
+        residuals.resize(times.size());
+        for (size_t i = 0; i < times.size(); ++i) {
+            residuals(i) = x(0) * std::exp(x(1) * times[i]) - values[i];
+        }
+    };
+    functions.jacobian = [times, values](const Eigen::VectorXd &x, Eigen::VectorXd &residuals, Matrix &jacobian) {
+        residuals.resize(times.size());
+        jacobian.resize(times.size(), 2);
+        for (size_t i = 0; i < times.size(); ++i) {
+            const double exponent = std::exp(x(1) * times[i]);
+            residuals(i) = x(0) * exponent - values[i];
+            jacobian(i, 0) = exponent;
+            jacobian(i, 1) = x(0) * times[i] * exponent;
+        }
+    };
+    functions.second_directional_derivative = [times](const Eigen::VectorXd &x, const Eigen::VectorXd &direction,
+                                                      Eigen::VectorXd &second_derivative) {
+        second_derivative.resize(times.size());
+        for (size_t i = 0; i < times.size(); ++i) {
+            const double exponent = std::exp(x(1) * times[i]);
+            second_derivative(i) = 2.0 * direction(0) * direction(1) * times[i] * exponent +
+                                   x(0) * direction(1) * direction(1) * times[i] * times[i] * exponent;
+        }
+    };
+    return functions;
+}
+} // namespace
+
+
+TEST_CASE("LevenbergMarquardt::Optimize()", "[Solver]") {
+    const std::vector<double> times = {0.0, 0.5, 1.0, 1.5, 2.0, 2.5, 3.0};
+    std::vector<double> values;
+    for (double time : times) {
+        values.push_back(2.0 * std::exp(-0.7 * time));
+    }
+    const Eigen::VectorXd lower_bounds = Eigen::VectorXd::Constant(2, -10.0);
+    const Eigen::VectorXd upper_bounds = Eigen::VectorXd::Constant(2, 10.0);
+
+    SECTION("Exponential Fit") {
+        for (bool use_geodesic_acceleration : {false, true}) {
+            LevenbergMarquardtParameters parameters;
+            parameters.epsx = 1.e-10;
+            parameters.use_geodesic_acceleration = use_geodesic_acceleration;
+            LevenbergMarquardt optimizer(GetExponentialFit(times, values), lower_bounds, upper_bounds, parameters);
+
+            const Eigen::VectorXd result = optimizer.Optimize(Eigen::Vector2d(1.0, 0.5));
+            REQUIRE(result(0) == Approx(2.0));
+            REQUIRE(result(1) == Approx(-0.7));
+            REQUIRE(optimizer.GetReport().ssr < 1.e-12);
+        }
+    }
+
+    SECTION("Active Inequality") {
+        LevenbergMarquardtParameters parameters;
+        parameters.epsx = 1.e-10;
+        LevenbergMarquardt optimizer(GetExponentialFit(times, values), lower_bounds, upper_bounds, parameters);
+        // x0 <= 1.5
+        optimizer.SetInequalityConstraints(Matrix::Identity(1, 2), Eigen::VectorXd::Constant(1, 1.5));
+
+        const Eigen::VectorXd result = optimizer.Optimize(Eigen::Vector2d(3.0, 0.5));
+        REQUIRE(result(0) == Approx(1.5));
+        REQUIRE(result(0) <= 1.5 + 1.e-10);
+        REQUIRE(optimizer.GetReport().ssr > 0.0);
+    }
+}
@@ -0,0 +1,321 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <atomic>
+#include <stdexcept>
+#include <optional>
+#include <cmath>
+#include <chrono>
+
+#include "catch/catch.hpp"
+#include "solver/multistart_scheduler.h"
+#include "solver/basin_registry.h"
+#include "solver/polytope_sampler.h"
+#include "solver/start_log.h"
+#include "solver/telemetry.h"
+#include "utilities/free_flux_bounds.h"
+#include "utilities/workers.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+struct RungRun {
+    int iterations;
+    double ssr;
+};
+
+// The runs of every start in the order of the rungs, the telemetry of one worker keeps this order
+std::map<size_t, std::vector<RungRun>> ReadRungRuns(const std::string &path) {
+    std::ifstream input(path + "_starts.csv");
+    std::map<size_t, std::vector<RungRun>> runs;
+    std::string line;
+    std::getline(input, line);
+    while (std::getline(input, line)) {
+        std::vector<std::string> cells;
+        std::stringstream stream(line);
+        for (std::string cell; std::getline(stream, cell, ',');) {
+            cells.push_back(cell);
+        }
+        runs[std::stoul(cells[0])].push_back({std::stoi(cells[2]), std::stod(cells[10])});
+    }
+    return runs;
+}
+
+// The starts of the rung with the lowest SSRs, rung 0 is of all the starts
+std::set<size_t> GetBestStarts(const std::map<size_t, std::vector<RungRun>> &runs, size_t rung, size_t total) {
+    std::vector<std::pair<double, size_t>> ssrs;
+    for (const auto &[start, start_runs] : runs) {
+        if (start_runs.size() > rung) {
+            ssrs.emplace_back(start_runs[rung].ssr, start);
+        }
+    }
+    std::sort(ssrs.begin(), ssrs.end());
+    std::set<size_t> best_starts;
+    for (size_t i = 0; i < std::min(total, ssrs.size()); ++i) {
+        best_starts.insert(ssrs[i].second);
+    }
+    return best_starts;
+}
+} // namespace
+
+
+TEST_CASE("MultistartScheduler resumes the basins", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const int nullity = problem.nullspace.cols();
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const LinearConstraints &constraints = problem.constraints;
+    const Eigen::VectorXd optimum =
+        PolytopeSampler(lower_bounds, upper_bounds, constraints.matrix, constraints.right_part).GetCenter();
+    const std::vector<double> optimum_fluxes(optimum.data(), optimum.data() + nullity);
+
+    MultistartParameters parameters;
+    parameters.total_starts = 3;
+    parameters.total_workers = 1;
+    parameters.master_seed = 7;
+    parameters.use_basin_registry = true;
+    parameters.log_path = GetUniqueTempPath("resumed_basins.log");
+    parameters.resume = true;
+    {
+        // the start 2 was heading into the optimum of the start 0, the start 1 was terminated in a basin of the
+        // other run, which isn't in the log
+        StartLog log(parameters.log_path, nullity, parameters.total_starts, *parameters.master_seed, false);
+        log.Append(CreateStartResult(0, optimum_fluxes, 1.0));
+        StartResult lost_basin = CreateStartResult(1, optimum_fluxes, 0.5);
+        lost_basin.is_terminated_early = true;
+        log.Append(lost_basin);
+        StartResult known_basin = CreateStartResult(2, optimum_fluxes, 3.0);
+        known_basin.is_terminated_early = true;
+        log.Append(known_basin);
+    }
+
+    MultistartScheduler scheduler(problem, generator, SolverParameters(), parameters);
+    const std::vector<StartResult> results = scheduler.Run();
+    REQUIRE(results.size() == 3);
+    REQUIRE(results[0].basin == 0);
+    REQUIRE_FALSE(results[1].basin.has_value());
+    REQUIRE(results[2].is_terminated_early);
+    REQUIRE(results[2].basin == 0);
+
+    std::remove(parameters.log_path.c_str());
+}
+
+
+
+TEST_CASE("MultistartScheduler doesn't depend on the worker count", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    // the alglib optimizer stops at the start points of the tiny problem
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+    MultistartParameters parameters;
+    parameters.total_starts = 8;
+    parameters.master_seed = 5;
+
+    const auto run = [&](size_t total_workers) {
+        parameters.total_workers = total_workers;
+        MultistartScheduler scheduler(problem, generator, solver_parameters, parameters);
+        const std::vector<StartResult> results = scheduler.Run();
+        REQUIRE(results.size() == parameters.total_starts);
+        return results;
+    };
+    // every start is seeded from the master seed and its number, whichever worker runs it
+    const std::vector<StartResult> serial_results = run(1);
+    const std::vector<StartResult> parallel_results = run(3);
+    for (size_t start = 0; start < parameters.total_starts; ++start) {
+        const StartResult &serial_result = serial_results[start];
+        const StartResult &parallel_result = parallel_results[start];
+        REQUIRE(serial_result.start == start);
+        REQUIRE(parallel_result.start == start);
+        REQUIRE(parallel_result.seed == serial_result.seed);
+        REQUIRE(parallel_result.ssr == serial_result.ssr);
+        REQUIRE(parallel_result.free_fluxes.length() == serial_result.free_fluxes.length());
+        for (int i = 0; i < serial_result.free_fluxes.length(); ++i) {
+            REQUIRE(parallel_result.free_fluxes[i] == serial_result.free_fluxes[i]);
+        }
+    }
+}
+
+
+TEST_CASE("Solver deadline", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    BasinRegistry basin_registry(lower_bounds, upper_bounds, 0.05);
+    Solver solver(problem, generator, solver_parameters);
+    solver.SetBasinRegistry(&basin_registry);
+
+    // the start of the seed takes several steps, the passed deadline stops it at the first one
+    const uint64_t seed = GetStartSeed(5, 0);
+    const StartResult finished_result = solver.SolveFromStart(0, seed);
+    REQUIRE_FALSE(finished_result.is_cancelled);
+    REQUIRE(finished_result.iterations > 1);
+    REQUIRE(basin_registry.GetSize() == 1);
+
+    solver.SetDeadline(std::chrono::steady_clock::now());
+    const StartResult cancelled_result = solver.SolveFromStart(0, seed);
+    REQUIRE(cancelled_result.is_cancelled);
+    REQUIRE(cancelled_result.iterations == 1);
+    REQUIRE(cancelled_result.ssr > finished_result.ssr);
+    // the point reached isn't an optimum
+    REQUIRE(basin_registry.GetSize() == 1);
+}
+
+
+TEST_CASE("MultistartScheduler time budget", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+    MultistartParameters parameters;
+    parameters.total_starts = 100;
+    parameters.total_workers = 2;
+    parameters.master_seed = 13;
+    parameters.prioritize_starts = true;
+
+    // the budgets are far shorter than the starts, the ones running at the deadline are cancelled.
+    // Whether a start is running then depends on the timing, so the budget is lengthened until one is
+    // and the runs without the cancelled starts only check the best result
+    size_t total_cancelled = 0;
+    for (int attempt = 1; total_cancelled == 0 && attempt <= 20; ++attempt) {
+        parameters.time_budget = 0.002 * attempt;
+        MultistartScheduler scheduler(problem, generator, solver_parameters, parameters);
+        const std::vector<StartResult> results = scheduler.Run();
+        REQUIRE(results.size() < parameters.total_starts);
+
+        // the cancelled starts stopped short of their optima, they are never the best
+        const std::optional<StartResult> best_result = scheduler.GetBestResult();
+        std::optional<double> best_ssr;
+        for (const StartResult &result : results) {
+            if (result.is_cancelled) {
+                ++total_cancelled;
+            } else if (std::isfinite(result.ssr) && (!best_ssr || result.ssr < *best_ssr)) {
+                best_ssr = result.ssr;
+            }
+        }
+        REQUIRE(best_result.has_value() == best_ssr.has_value());
+        if (best_result) {
+            REQUIRE_FALSE(best_result->is_cancelled);
+            REQUIRE(best_result->ssr == *best_ssr);
+        }
+    }
+    if (total_cancelled == 0) {
+        WARN("No start was running at the deadline");
+    }
+}
+
+
+TEST_CASE("MultistartScheduler successive halving", "[Solver]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    MultistartParameters parameters;
+    parameters.total_starts = 9;
+    parameters.total_workers = 1;
+    parameters.master_seed = 11;
+    parameters.halving_factor = 3;
+    // the alglib optimizer stops at the start points of the tiny problem
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+    // the feasible starts, the rungs below are of their iterations
+    solver_parameters.start_sampling = StartSampling::hit_and_run;
+    const std::string path = GetUniqueTempPath("successive_halving");
+    Telemetry telemetry(TelemetryFormat::csv, path);
+
+    const auto run = [&](int screening_iterations) {
+        parameters.screening_iterations = screening_iterations;
+        // the rungs of screening_iterations and 3 * screening_iterations, then the refinement
+        solver_parameters.max_iterations = 9 * screening_iterations;
+        MultistartScheduler scheduler(problem, generator, solver_parameters, parameters);
+        scheduler.SetTelemetry(&telemetry);
+        const std::vector<StartResult> results = scheduler.Run();
+        telemetry.Write();
+        REQUIRE(results.size() == parameters.total_starts);
+        return results;
+    };
+
+    SECTION("The best third of the running starts is promoted") {
+        const std::vector<StartResult> results = run(1);
+        const std::map<size_t, std::vector<RungRun>> runs = ReadRungRuns(path);
+        REQUIRE(runs.size() == parameters.total_starts);
+
+        // no start converges in the screening
+        const std::set<size_t> first_survivors = GetBestStarts(runs, 0, 3);
+        for (const auto &[start, start_runs] : runs) {
+            REQUIRE(start_runs[0].iterations == 1);
+            REQUIRE((start_runs.size() > 1) == (first_survivors.count(start) > 0));
+            if (start_runs.size() > 1) {
+                REQUIRE(start_runs[1].iterations == 3);
+            }
+        }
+        const std::set<size_t> refined_starts = GetBestStarts(runs, 1, 1);
+        for (const StartResult &result : results) {
+            const std::vector<RungRun> &start_runs = runs.at(result.start);
+            REQUIRE((start_runs.size() == 3) == (refined_starts.count(result.start) > 0));
+            REQUIRE(result.is_screened_out == (refined_starts.count(result.start) == 0));
+            // the result of the last rung with the iterations of all of them
+            REQUIRE(result.ssr == Approx(start_runs.back().ssr));
+            int iterations = 0;
+            for (const RungRun &start_run : start_runs) {
+                iterations += start_run.iterations;
+            }
+            REQUIRE(result.iterations == iterations);
+        }
+    }
+
+    SECTION("The converged starts aren't screened out") {
+        const std::vector<StartResult> results = run(2);
+        const std::map<size_t, std::vector<RungRun>> runs = ReadRungRuns(path);
+
+        const std::set<size_t> first_survivors = GetBestStarts(runs, 0, 3);
+        for (const StartResult &result : results) {
+            const std::vector<RungRun> &start_runs = runs.at(result.start);
+            if (first_survivors.count(result.start)) {
+                // converged in the second rung, so refined without competing
+                REQUIRE(start_runs.size() == 3);
+                REQUIRE(start_runs[1].iterations < 6);
+                REQUIRE_FALSE(result.is_screened_out);
+            } else {
+                REQUIRE(start_runs.size() == 1);
+                REQUIRE(result.is_screened_out);
+            }
+        }
+    }
+
+    std::filesystem::remove(path + "_starts.csv");
+    std::filesystem::remove(path + "_workers.csv");
+}
+
+
+TEST_CASE("RunWorkers()", "[Solver]") {
+    std::atomic<size_t> finished_workers{0};
+    std::atomic<bool> is_failed{false};
+
+    SECTION("The error of a worker is rethrown after all of them finish") {
+        REQUIRE_THROWS_AS(RunWorkers(4, [&finished_workers](size_t worker) {
+            if (worker == 2) {
+                throw std::runtime_error("worker 2");
+            }
+            ++finished_workers;
+        }, &is_failed), std::runtime_error);
+        REQUIRE(finished_workers == 3);
+        REQUIRE(is_failed);
+    }
+
+    SECTION("No error") {
+        RunWorkers(4, [&finished_workers](size_t) {
+            ++finished_workers;
+        }, &is_failed);
+        REQUIRE(finished_workers == 4);
+        REQUIRE_FALSE(is_failed);
+    }
+}
@@ -0,0 +1,52 @@
+#include <cmath>
+#include <random>
+
+#include "catch/catch.hpp"
+#include "solver/polytope_sampler.h"
+
+using namespace khnum;
+
+
+TEST_CASE("PolytopeSampler", "[Solver]") {
+    // triangle x0 + x1 <= 1 in the unit square, x2 is fixed
+    const Eigen::Vector3d lower_bounds(0.0, 0.0, 2.0);
+    const Eigen::Vector3d upper_bounds(1.0, 1.0, 2.0);
+    Matrix constraints(1, 3);
+    constraints << 1.0, 1.0, 0.5;
+    const Eigen::VectorXd right_part = Eigen::VectorXd::Constant(1, 2.0);
+
+    PolytopeSampler sampler(lower_bounds, upper_bounds, constraints, right_part);
+    std::mt19937 random_source(1);
+
+    SECTION("Center") {
+        // the largest inscribed circle of the triangle has the radius 1 - 1 / sqrt(2)
+        REQUIRE(sampler.GetCenter()(0) == Approx(1.0 - 1.0 / std::sqrt(2.0)));
+        REQUIRE(sampler.GetCenter()(1) == Approx(1.0 - 1.0 / std::sqrt(2.0)));
+        REQUIRE(sampler.GetCenter()(2) == 2.0);
+    }
+
+    SECTION("Hit-And-Run") {
+        const std::vector<Eigen::VectorXd> points = sampler.Sample(4000, random_source);
+        Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+        for (const Eigen::VectorXd &point : points) {
+            REQUIRE(point(0) >= 0.0);
+            REQUIRE(point(1) >= 0.0);
+            REQUIRE(point(0) + point(1) <= 1.0 + 1.e-12);
+            REQUIRE(point(2) == 2.0);
+            mean += point;
+        }
+        mean /= points.size();
+        // the centroid of the triangle
+        REQUIRE(mean(0) == Approx(1.0 / 3.0).margin(0.02));
+        REQUIRE(mean(1) == Approx(1.0 / 3.0).margin(0.02));
+    }
+
+    SECTION("Low Discrepancy") {
+        const std::vector<Eigen::VectorXd> points = sampler.SampleLowDiscrepancy(100, random_source);
+        REQUIRE(points.size() == 100);
+        for (const Eigen::VectorXd &point : points) {
+            REQUIRE(point(0) + point(1) <= 1.0 + 1.e-12);
+        }
+        REQUIRE(GetRadicalInverse(6, 2) == Approx(0.375));
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <filesystem>
+
+#include "solver/solver.h"
+#include "modeller/modeller.h"
+#include "parser/open_flux_parser/open_flux_parser.h"
+
+
+namespace khnum {
+// The finished start of the seed 100 + start
+inline StartResult CreateStartResult(size_t start, const std::vector<double> &free_fluxes, double ssr) {
+    StartResult result;
+    result.start = start;
+    result.seed = 100 + start;
+    result.free_fluxes.setcontent(free_fluxes.size(), free_fluxes.data());
+    result.ssr = ssr;
+    result.iterations = 10;
+    result.evaluations = 20;
+    result.is_terminated_early = false;
+    result.seconds = 0.5;
+    return result;
+}
+
+// A path in the temporary directory no other test run uses, nothing is created there
+inline std::string GetUniqueTempPath(const std::string &name) {
+    std::random_device random_source;
+    const std::string suffix = std::to_string(random_source()) + "_" + std::to_string(random_source());
+    return (std::filesystem::temp_directory_path() / ("khnum_" + name + "_" + suffix)).string();
+}
+
+// The reactions of modelTiny, its measurements are of F:111 and E:1
+const std::string kTinyModel =
+    "RxnID,rxnEq,rxnCTrans,rates,rxnType,basis,deviation\n"
+    "R1,A = B,abc = abc,,F,1,\n"
+    "R2,B = D,abc = abc,,FR,,\n"
+    "R3,D = B,abc = abc,,R,X,\n"
+    "R4,B = C + E,abc = bc + a,,F,,\n"
+    "R5,B + C = D + G,abc + de = bcd + ae,,F,,\n"
+    "R6,G = E + E,ab = a + b,,F,,\n"
+    "R7,D = F,abc = abc,,F,,\n";
+
+// Models the reactions of the OpenFlux model.csv with the rest of the files of modelTiny
+inline Problem CreateTinyProblem(const std::string &model = kTinyModel) {
+    const std::string directory = GetUniqueTempPath("tiny_model");
+    std::filesystem::create_directories(directory);
+    std::ofstream(directory + "/model.csv") << model;
+    std::ofstream(directory + "/excluded_metabolites.txt") << "A\nE\nF\n";
+    std::ofstream(directory + "/measured_isotopes.txt") << "F:111\nE:1\n";
+    std::ofstream(directory + "/measurements.csv") << "measurements,error\n0.0001,0.02\n0.8008,0.02\n0.1983,0.02\n"
+                                                      "0.0900,0.02\n0.9333,0.02\n0.0667,0.02\n";
+    std::ofstream(directory + "/substrate_input.csv") << "Substrate,labeling pattern,ratio\nA,0.4 0.3 0.4,1.0\n";
+
+    ParserOpenFlux parser(directory);
+    parser.Parse();
+    std::filesystem::remove_all(directory);
+
+    Modeller modeller(parser.GetResults());
+    modeller.CalculateInputSubstrateMids();
+    modeller.CreateEmuNetworks();
+    modeller.CreateNullspaceMatrix();
+    modeller.CalculateFluxBounds();
+    modeller.PresolveConstraints();
+    modeller.CalculateMeasurementsCount();
+    modeller.CheckModelForErrors();
+    return modeller.GetProblem();
+}
+} // namespace khnum
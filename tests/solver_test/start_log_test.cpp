@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+
+#include "catch/catch.hpp"
+#include "solver/start_log.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+StartResult CreateResult(size_t start, double ssr, bool is_cancelled) {
+    StartResult result = CreateStartResult(start, {1.0 * start, 2.0, 3.0}, ssr);
+    result.is_cancelled = is_cancelled;
+    return result;
+}
+} // namespace
+
+
+TEST_CASE("StartLog", "[Solver]") {
+    const std::string path = GetUniqueTempPath("start_log_test.log");
+    {
+        StartLog log(path, 3, 5, 42, false);
+        log.Append(CreateResult(2, 1.5, false));
+        log.Append(CreateResult(0, 7.0, true));
+        log.Append(CreateResult(4, 2.5, false));
+    }
+
+    SECTION("Read") {
+        const StartLogContents contents = ReadStartLog(path);
+        REQUIRE(contents.header.nullity == 3);
+        REQUIRE(contents.header.total_starts == 5);
+        REQUIRE(contents.header.master_seed == 42);
+        REQUIRE(contents.results.size() == 3);
+        REQUIRE(contents.results[0].start == 2);
+        REQUIRE(contents.results[0].seed == 102);
+        REQUIRE(contents.results[0].ssr == 1.5);
+        REQUIRE(contents.results[0].free_fluxes[0] == 2.0);
+        REQUIRE(contents.results[1].is_cancelled);
+        REQUIRE(contents.results[2].free_fluxes[2] == 3.0);
+    }
+
+    SECTION("The cancelled starts aren't completed") {
+        StartLog log(path, 3, 5, 42, true);
+        const std::vector<StartResult> completed_results = log.GetCompletedResults();
+        REQUIRE(completed_results.size() == 2);
+        REQUIRE(completed_results[0].start == 2);
+        REQUIRE(completed_results[1].start == 4);
+    }
+
+    SECTION("The cut record is overwritten") {
+        {
+            std::ofstream output(path, std::ios::binary | std::ios::app);
+            output.write("cut", 3);
+        }
+        {
+            StartLog log(path, 3, 5, 42, true);
+            log.Append(CreateResult(0, 0.5, false));
+        }
+        const StartLogContents contents = ReadStartLog(path);
+        REQUIRE(contents.results.size() == 4);
+        REQUIRE(contents.results.back().ssr == 0.5);
+        REQUIRE(StartLog(path, 3, 5, 42, true).GetCompletedResults().size() == 3);
+    }
+
+    SECTION("The existing log isn't overwritten") {
+        REQUIRE_THROWS_AS(StartLog(path, 3, 5, 42, false), std::runtime_error);
+        REQUIRE(ReadStartLog(path).results.size() == 3);
+    }
+
+    SECTION("The log of the other run can't be resumed") {
+        REQUIRE_THROWS(StartLog(path, 3, 5, 43, true));
+        REQUIRE_THROWS(StartLog(path, 4, 5, 42, true));
+    }
+
+    std::remove(path.c_str());
+}
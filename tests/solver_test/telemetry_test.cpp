@@ -0,0 +1,99 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include "catch/catch.hpp"
+#include "solver/telemetry.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+std::vector<std::string> ReadLines(const std::string &path) {
+    std::ifstream input(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(input, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+} // namespace
+
+
+TEST_CASE("Telemetry", "[Solver]") {
+    const std::string path = GetUniqueTempPath("telemetry");
+
+    const auto fill = [](Telemetry &telemetry) {
+        // the starts are added in the order they finish
+        telemetry.AddStart({3, 1, 4, 5, 4, 10, 0, 0.25, 0.75, 2.0, {8.0, 3.0, 2.0}});
+        telemetry.AddStart({1, 0, 2, 3, 2, 6, 1, 0.5, 1.0, std::nan(""), {}});
+        telemetry.AddWorker(0, {1, 1.0, 2.0});
+        telemetry.AddWorker(1, {1, 0.75, 2.0});
+        // of the next run
+        telemetry.AddWorker(0, {2, 1.0, 2.0});
+    };
+
+    SECTION("CSV") {
+        Telemetry telemetry(TelemetryFormat::csv, path);
+        fill(telemetry);
+        telemetry.Write();
+
+        const std::vector<std::string> starts = ReadLines(path + "_starts.csv");
+        REQUIRE(starts.size() == 3);
+        REQUIRE(starts[0] == "start,worker,iterations,residual_evaluations,jacobian_evaluations,"
+                             "linear_solver_iterations,linear_solver_failures,simulation_seconds,optimizer_seconds,"
+                             "seconds,ssr,ssr_trajectory");
+        // ordered by the start
+        REQUIRE(starts[1] == "1,0,2,3,2,6,1,0.5,0.5,1,nan,");
+        REQUIRE(starts[2] == "3,1,4,5,4,10,0,0.25,0.5,0.75,2,8;3;2");
+
+        const std::vector<std::string> workers = ReadLines(path + "_workers.csv");
+        REQUIRE(workers.size() == 3);
+        REQUIRE(workers[0] == "worker,starts,busy_seconds,wall_seconds,utilization");
+        REQUIRE(workers[1] == "0,3,2,4,0.5");
+        REQUIRE(workers[2] == "1,1,0.75,2,0.375");
+
+        std::filesystem::remove(path + "_starts.csv");
+        std::filesystem::remove(path + "_workers.csv");
+    }
+
+    SECTION("JSON") {
+        Telemetry telemetry(TelemetryFormat::json, path);
+        fill(telemetry);
+        telemetry.Write();
+
+        std::ifstream input(path + ".json");
+        std::stringstream json;
+        json << input.rdbuf();
+        REQUIRE(json.str() ==
+                "{\n"
+                "  \"starts\": [\n"
+                "    {\"start\": 3, \"worker\": 1, \"iterations\": 4, \"residual_evaluations\": 5, "
+                "\"jacobian_evaluations\": 4, \"linear_solver_iterations\": 10, \"linear_solver_failures\": 0, "
+                "\"simulation_seconds\": 0.25, \"optimizer_seconds\": 0.5, \"seconds\": 0.75, \"ssr\": 2, "
+                "\"ssr_trajectory\": [8, 3, 2]},\n"
+                "    {\"start\": 1, \"worker\": 0, \"iterations\": 2, \"residual_evaluations\": 3, "
+                "\"jacobian_evaluations\": 2, \"linear_solver_iterations\": 6, \"linear_solver_failures\": 1, "
+                "\"simulation_seconds\": 0.5, \"optimizer_seconds\": 0.5, \"seconds\": 1, \"ssr\": null, "
+                "\"ssr_trajectory\": []}\n"
+                "  ],\n"
+                "  \"workers\": [\n"
+                "    {\"worker\": 0, \"starts\": 3, \"busy_seconds\": 2, \"wall_seconds\": 4},\n"
+                "    {\"worker\": 1, \"starts\": 1, \"busy_seconds\": 0.75, \"wall_seconds\": 2}\n"
+                "  ]\n"
+                "}\n");
+
+        std::filesystem::remove(path + ".json");
+    }
+
+    SECTION("The unwritable path") {
+        Telemetry telemetry(TelemetryFormat::json, path + "/missing/telemetry");
+        fill(telemetry);
+        REQUIRE_THROWS_AS(telemetry.Write(), std::runtime_error);
+    }
+}
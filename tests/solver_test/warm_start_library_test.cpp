@@ -0,0 +1,100 @@
+#include <random>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "catch/catch.hpp"
+#include "solver/warm_start_library.h"
+#include "solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+Problem CreateProblem() {
+    Problem problem;
+    problem.reactions = {{0, "v1"}, {1, "v2"}, {2, "v3"}};
+    problem.reactions_total = 3;
+    problem.nullspace = Matrix(3, 2);
+    problem.nullspace << 1.0, 0.0,
+                         0.0, 1.0,
+                         -1.0, -1.0;
+    problem.lower_bounds = {0.0, 0.0, 0.0};
+    problem.upper_bounds = {1.0, 1.0, 2.0};
+    // v1 + v2 <= 1.5
+    problem.constraints.matrix = Matrix(1, 2);
+    problem.constraints.matrix << 1.0, 1.0;
+    problem.constraints.right_part = Eigen::VectorXd::Constant(1, 1.5);
+    return problem;
+}
+
+StartResult CreateResult(size_t start, double v1, double v2, double ssr) {
+    return CreateStartResult(start, {v1, v2}, ssr);
+}
+} // namespace
+
+
+TEST_CASE("GetModelHash()", "[Solver]") {
+    Problem problem = CreateProblem();
+    const uint64_t hash = GetModelHash(problem);
+    REQUIRE(GetModelHash(CreateProblem()) == hash);
+
+    SECTION("The bounds aren't hashed") {
+        problem.upper_bounds[0] = 10.0;
+        REQUIRE(GetModelHash(problem) == hash);
+    }
+
+    SECTION("The free flux selection is hashed") {
+        problem.nullspace(2, 0) = 1.0;
+        REQUIRE(GetModelHash(problem) != hash);
+    }
+}
+
+
+TEST_CASE("WarmStartLibrary", "[Solver]") {
+    const std::string directory = GetUniqueTempPath("warm_start_test");
+    std::filesystem::remove_all(directory);
+    const Problem problem = CreateProblem();
+    {
+        WarmStartLibrary library(directory, problem);
+        REQUIRE(library.GetSize() == 0);
+        // the second is in the basin of the first, the third is a distinct worse optimum
+        const std::vector<StartResult> results = {CreateResult(0, 0.5, 0.5, 1.0),
+                                                  CreateResult(1, 0.51, 0.5, 1.0005),
+                                                  CreateResult(2, 0.1, 0.9, 20.0)};
+        const WarmStartStatistics statistics = library.Update(results, std::vector<std::optional<size_t>>(3));
+        REQUIRE(statistics.cold_starts == 3);
+        REQUIRE(statistics.cold_hits == 2);
+        REQUIRE(library.GetSize() == 2);
+        library.Save();
+    }
+
+    WarmStartLibrary library(directory, problem);
+    REQUIRE(library.GetSize() == 2);
+    REQUIRE(library.GetStatistics().total_runs == 1);
+
+    SECTION("The start points are feasible") {
+        std::mt19937 random_source(42);
+        for (int i = 0; i < 100; ++i) {
+            const std::optional<Eigen::VectorXd> point = library.GetStartPoint(0, 0.5, random_source);
+            REQUIRE(point);
+            REQUIRE((*point)(0) >= 0.0);
+            REQUIRE((*point)(1) <= 1.0);
+            REQUIRE((*point)(0) + (*point)(1) <= 1.5);
+        }
+    }
+
+    SECTION("The warm starts are counted for their optima") {
+        const std::vector<StartResult> results = {CreateResult(0, 0.1, 0.9, 19.0),
+                                                  CreateResult(1, 0.5, 0.5, 1.0)};
+        const WarmStartStatistics statistics = library.Update(results, {1, std::nullopt});
+        REQUIRE(statistics.warm_starts == 1);
+        REQUIRE(statistics.warm_hits == 0);
+        REQUIRE(statistics.cold_hits == 1);
+        REQUIRE(library.GetStatistics().total_runs == 2);
+        REQUIRE(library.GetStatistics().cold_starts == 4);
+        REQUIRE(library.GetSize() == 2);
+    }
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,43 @@
+#include "catch/catch.hpp"
+#include "statistics/linearized_statistics.h"
+
+using namespace khnum;
+
+
+TEST_CASE("GetParameterCovariance()", "[Statistics]") {
+    // the straight line a + b * t at t = 0, 1, 2, 3
+    Matrix jacobian(4, 2);
+    jacobian << 1.0, 0.0,
+                1.0, 1.0,
+                1.0, 2.0,
+                1.0, 3.0;
+    const Eigen::VectorXd scales = Eigen::Vector2d(10.0, 0.5);
+
+    SECTION("Unconstrained") {
+        const ParameterCovariance result = GetParameterCovariance(jacobian, Matrix(0, 2), scales);
+        const Matrix expected = (jacobian.transpose() * jacobian).inverse();
+        REQUIRE(result.rank == 2);
+        REQUIRE(result.null_directions.cols() == 0);
+        REQUIRE((result.covariance - expected).norm() == Approx(0.0).margin(1.e-12));
+    }
+
+    SECTION("The active bound pins the parameter") {
+        Matrix active_rows(1, 2);
+        active_rows << 1.0, 0.0;
+        const ParameterCovariance result = GetParameterCovariance(jacobian, active_rows, scales);
+        REQUIRE(result.rank == 1);
+        REQUIRE(result.covariance(0, 0) == Approx(0.0).margin(1.e-12));
+        REQUIRE(result.covariance(0, 1) == Approx(0.0).margin(1.e-12));
+        REQUIRE(result.covariance(1, 1) == Approx(1.0 / jacobian.col(1).squaredNorm()));
+    }
+
+    SECTION("The duplicated column is a null direction") {
+        Matrix duplicated(4, 3);
+        duplicated << jacobian, jacobian.col(1);
+        const ParameterCovariance result = GetParameterCovariance(duplicated, Matrix(0, 3), Eigen::Vector3d::Ones());
+        REQUIRE(result.rank == 2);
+        REQUIRE(result.null_directions.cols() == 1);
+        REQUIRE((duplicated * result.null_directions).norm() == Approx(0.0).margin(1.e-12));
+        REQUIRE(std::abs(result.null_directions(1, 0)) == Approx(std::sqrt(0.5)));
+    }
+}
@@ -0,0 +1,138 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "catch/catch.hpp"
+#include "statistics/monte_carlo.h"
+#include "statistics/flux_map.h"
+#include "utilities/free_flux_bounds.h"
+#include "../solver_test/solver_test_utilities.h"
+
+using namespace khnum;
+
+
+TEST_CASE("MonteCarlo::Resample()", "[Statistics]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    std::vector<double> measured_values;
+    std::vector<double> errors;
+    for (const Measurement &measurement : problem.measurements) {
+        measured_values.insert(measured_values.end(), measurement.mid.begin(), measurement.mid.end());
+        errors.insert(errors.end(), measurement.errors.begin(), measurement.errors.end());
+    }
+    const int total_values = measured_values.size();
+    Eigen::VectorXd best_fit_residuals(total_values);
+    for (int i = 0; i < total_values; ++i) {
+        best_fit_residuals(i) = i + 1.0;
+    }
+    MonteCarloParameters parameters;
+    parameters.output_path = "";
+
+    SECTION("The measurements are drawn around the measured values") {
+        parameters.resampling = Resampling::measurements;
+        const MonteCarlo monte_carlo(problem, generator, SolverParameters(), parameters);
+        Eigen::VectorXd first;
+        Eigen::VectorXd second;
+        monte_carlo.Resample(best_fit_residuals, 7, first);
+        monte_carlo.Resample(best_fit_residuals, 7, second);
+        REQUIRE(first.size() == total_values);
+        REQUIRE(first == second);
+        monte_carlo.Resample(best_fit_residuals, 8, second);
+        REQUIRE(first != second);
+
+        // the noise is N(0, error^2)
+        const size_t total_replicates = 4000;
+        Eigen::VectorXd sum = Eigen::VectorXd::Zero(total_values);
+        Eigen::VectorXd square_sum = Eigen::VectorXd::Zero(total_values);
+        Eigen::VectorXd values;
+        for (size_t replicate = 0; replicate < total_replicates; ++replicate) {
+            monte_carlo.Resample(best_fit_residuals, replicate, values);
+            for (int i = 0; i < total_values; ++i) {
+                const double noise = (values(i) - measured_values[i]) / errors[i];
+                sum(i) += noise;
+                square_sum(i) += noise * noise;
+            }
+        }
+        for (int i = 0; i < total_values; ++i) {
+            REQUIRE(sum(i) / total_replicates == Approx(0.0).margin(0.1));
+            REQUIRE(square_sum(i) / total_replicates == Approx(1.0).epsilon(0.1));
+        }
+    }
+
+    SECTION("The residuals are bootstrapped around the simulated values") {
+        parameters.resampling = Resampling::residuals;
+        const MonteCarlo monte_carlo(problem, generator, SolverParameters(), parameters);
+        std::vector<bool> is_drawn(total_values, false);
+        Eigen::VectorXd values;
+        for (uint64_t seed = 0; seed < 100; ++seed) {
+            monte_carlo.Resample(best_fit_residuals, seed, values);
+            REQUIRE(values.size() == total_values);
+            for (int i = 0; i < total_values; ++i) {
+                // residual = (simulated - measured) / error
+                const double simulated = measured_values[i] + errors[i] * best_fit_residuals(i);
+                const double residual = (simulated - values(i)) / errors[i];
+                const int drawn = std::lround(residual) - 1;
+                REQUIRE(residual == Approx(drawn + 1.0));
+                REQUIRE(drawn >= 0);
+                REQUIRE(drawn < total_values);
+                is_drawn[drawn] = true;
+            }
+        }
+        REQUIRE(std::all_of(is_drawn.begin(), is_drawn.end(), [](bool value) { return value; }));
+    }
+}
+
+
+TEST_CASE("MonteCarlo::Run()", "[Statistics]") {
+    Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    SolverParameters solver_parameters;
+    solver_parameters.optimizer = Optimizer::native_lm;
+
+    // the measurements are simulated at the middle of the bounds, so it's the best fit with zero SSR
+    for (Measurement &measurement : problem.measurements) {
+        measurement.errors.assign(measurement.errors.size(), 1.e-3);
+    }
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const Eigen::VectorXd optimum = 0.5 * (lower_bounds + upper_bounds);
+    Eigen::VectorXd residuals;
+    Solver(problem, generator, solver_parameters).CalculateResiduals(optimum, residuals);
+    int residual = 0;
+    for (Measurement &measurement : problem.measurements) {
+        for (size_t mass_shift = 0; mass_shift < measurement.mid.size(); ++mass_shift) {
+            measurement.mid[mass_shift] += measurement.errors[mass_shift] * residuals(residual++);
+        }
+    }
+
+    MonteCarloParameters parameters;
+    parameters.total_replicates = 40;
+    parameters.total_workers = 2;
+    parameters.seed = 3;
+    parameters.output_path = "";
+    const std::vector<FluxDistribution> distributions =
+        MonteCarlo(problem, generator, solver_parameters, parameters).Run(optimum);
+
+    const FluxMap flux_map = GetFluxMap(problem);
+    const std::vector<int> model_fluxes = GetModelFluxes(flux_map);
+    REQUIRE(distributions.size() == model_fluxes.size());
+    const Eigen::VectorXd best_fit_fluxes = flux_map.coefficients * optimum + flux_map.offsets;
+    for (size_t i = 0; i < distributions.size(); ++i) {
+        const FluxDistribution &distribution = distributions[i];
+        REQUIRE(distribution.reaction == model_fluxes[i]);
+        REQUIRE(std::isfinite(distribution.mean));
+        REQUIRE(std::isfinite(distribution.standard_deviation));
+        REQUIRE(std::isfinite(distribution.lower));
+        REQUIRE(std::isfinite(distribution.upper));
+        // the interval of every flux contains its best fit value
+        const double value = best_fit_fluxes(distribution.reaction);
+        REQUIRE(distribution.lower <= value + 1.e-6);
+        REQUIRE(value - 1.e-6 <= distribution.upper);
+    }
+
+    // the bootstrap needs the residuals of the best fit
+    parameters.resampling = Resampling::residuals;
+    const Eigen::VectorXd failed_optimum = Eigen::VectorXd::Constant(optimum.size(), std::nan(""));
+    REQUIRE_THROWS_AS(MonteCarlo(problem, generator, solver_parameters, parameters).Run(failed_optimum),
+                      std::runtime_error);
+}
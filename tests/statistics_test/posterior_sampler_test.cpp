@@ -0,0 +1,191 @@
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "catch/catch.hpp"
+#include "statistics/posterior_sampler.h"
+#include "statistics/flux_map.h"
+#include "utilities/free_flux_bounds.h"
+#include "../solver_test/solver_test_utilities.h"
+
+using namespace khnum;
+
+
+TEST_CASE("GetChainDiagnostics()", "[Statistics]") {
+    std::mt19937 random_source(42);
+    std::normal_distribution<> get_normal(0.0, 1.0);
+    const size_t total_chains = 4;
+    const size_t length = 5000;
+
+    SECTION("Independent samples") {
+        std::vector<std::vector<double>> chains(total_chains);
+        for (std::vector<double> &chain : chains) {
+            for (size_t i = 0; i < length; ++i) {
+                chain.push_back(get_normal(random_source));
+            }
+        }
+        const ChainDiagnostics diagnostics = GetChainDiagnostics(chains);
+        REQUIRE(diagnostics.r_hat == Approx(1.0).margin(0.01));
+        REQUIRE(diagnostics.effective_sample_size == Approx(total_chains * length).epsilon(0.1));
+    }
+
+    SECTION("Autoregressive samples") {
+        // ESS of AR(1) is the length * (1 - phi) / (1 + phi)
+        const double phi = 0.9;
+        std::vector<std::vector<double>> chains(total_chains);
+        for (std::vector<double> &chain : chains) {
+            double value = get_normal(random_source) / std::sqrt(1.0 - phi * phi);
+            for (size_t i = 0; i < length; ++i) {
+                value = phi * value + get_normal(random_source);
+                chain.push_back(value);
+            }
+        }
+        const ChainDiagnostics diagnostics = GetChainDiagnostics(chains);
+        REQUIRE(diagnostics.r_hat < 1.05);
+        REQUIRE(diagnostics.effective_sample_size == Approx(total_chains * length * (1.0 - phi) / (1.0 + phi))
+                                                         .epsilon(0.25));
+    }
+
+    SECTION("The chains in the different places") {
+        std::vector<std::vector<double>> chains(total_chains);
+        for (size_t chain = 0; chain < total_chains; ++chain) {
+            for (size_t i = 0; i < length; ++i) {
+                chains[chain].push_back(chain + get_normal(random_source));
+            }
+        }
+        REQUIRE(GetChainDiagnostics(chains).r_hat > 1.1);
+    }
+
+    SECTION("Constant values") {
+        const std::vector<std::vector<double>> chains(total_chains, std::vector<double>(length, 1.0));
+        const ChainDiagnostics diagnostics = GetChainDiagnostics(chains);
+        REQUIRE(diagnostics.r_hat == 1.0);
+        REQUIRE(diagnostics.effective_sample_size == total_chains * length);
+    }
+}
+
+
+TEST_CASE("PosteriorSampler needs samples", "[Statistics]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    SamplerParameters parameters;
+    parameters.output_path = "";
+    parameters.total_samples = 0;
+    REQUIRE_THROWS_AS(PosteriorSampler(problem, generator, SolverParameters(), parameters), std::runtime_error);
+    parameters.total_samples = 10;
+    parameters.total_chains = 0;
+    REQUIRE_THROWS_AS(PosteriorSampler(problem, generator, SolverParameters(), parameters), std::runtime_error);
+}
+
+
+TEST_CASE("PosteriorSampler on a gaussian", "[Statistics]") {
+    // E gets the atom b of A by R2 and the atom a by R3, so its MID and the ones of C and F are linear in R2
+    // and the posterior of R2, the only sampled free flux, is gaussian
+    const std::string model =
+        "RxnID,rxnEq,rxnCTrans,rates,rxnType,basis,deviation\n"
+        "R1,A = B,abc = abc,,F,1,\n"
+        "R2,B = C + E,abc = ac + b,,F,X,\n"
+        "R3,B = C + E,abc = bc + a,,F,,\n"
+        "R4,C = F,ab = ab,,F,,\n";
+    Problem problem = CreateTinyProblem(model);
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const SolverParameters solver_parameters;
+
+    // the measurements are simulated at the middle of the bounds, so it's the mean of the posterior
+    for (Measurement &measurement : problem.measurements) {
+        measurement.errors.assign(measurement.errors.size(), 2.e-3);
+    }
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const Eigen::VectorXd optimum = 0.5 * (lower_bounds + upper_bounds);
+    Eigen::VectorXd residuals;
+    Solver(problem, generator, solver_parameters).CalculateResiduals(optimum, residuals);
+    int residual = 0;
+    for (Measurement &measurement : problem.measurements) {
+        for (size_t mass_shift = 0; mass_shift < measurement.mid.size(); ++mass_shift) {
+            measurement.mid[mass_shift] += measurement.errors[mass_shift] * residuals(residual++);
+        }
+    }
+
+    // SSR = (slope * (Vfree - mean))^2, so the variance of the free flux is 1 / slope^2
+    REQUIRE((lower_bounds.array() < upper_bounds.array()).count() == 1);
+    int sampled_flux = 0;
+    while (lower_bounds(sampled_flux) == upper_bounds(sampled_flux)) {
+        ++sampled_flux;
+    }
+    const double shift = 0.1;
+    Eigen::VectorXd moved = optimum;
+    moved(sampled_flux) += shift;
+    Eigen::VectorXd moved_residuals;
+    Solver(problem, generator, solver_parameters).CalculateResiduals(moved, moved_residuals);
+    const double free_flux_deviation = shift / moved_residuals.norm();
+    REQUIRE(6.0 * free_flux_deviation < 0.5 * (upper_bounds(sampled_flux) - lower_bounds(sampled_flux)));
+
+    const int r2 = std::find_if(problem.reactions.begin(), problem.reactions.end(),
+                                [](const ReactionsName &reaction) { return reaction.name == "R2"; }) -
+                   problem.reactions.begin();
+    const FluxMap flux_map = GetFluxMap(problem);
+    const double mean = flux_map.coefficients.row(r2).dot(optimum) + flux_map.offsets(r2);
+    const double standard_deviation = std::abs(flux_map.coefficients(r2, sampled_flux)) * free_flux_deviation;
+    REQUIRE(standard_deviation > 0.0);
+
+    SamplerParameters parameters;
+    parameters.total_chains = 2;
+    parameters.burn_in = 500;
+    parameters.total_samples = 2000;
+    parameters.total_workers = 1;
+    parameters.seed = 5;
+    parameters.output_path = "";
+    double target_acceptance = 0.0;
+
+    SECTION("MALA") {
+        parameters.proposal = Proposal::mala;
+        target_acceptance = 0.574;
+    }
+
+    SECTION("Adaptive Metropolis") {
+        parameters.proposal = Proposal::adaptive_metropolis;
+        target_acceptance = 0.234;
+    }
+
+    PosteriorSampler sampler(problem, generator, solver_parameters, parameters);
+    const std::vector<FluxPosterior> posteriors = sampler.Run(optimum);
+    const auto posterior = std::find_if(posteriors.begin(), posteriors.end(), [r2](const FluxPosterior &flux) {
+        return flux.reaction == r2;
+    });
+    REQUIRE(posterior != posteriors.end());
+    // the step adapted in the burn-in keeps the acceptance close to the target
+    REQUIRE(sampler.GetAcceptanceRate() == Approx(target_acceptance).margin(0.1));
+    REQUIRE(posterior->mean == Approx(mean).margin(0.2 * standard_deviation));
+    REQUIRE(posterior->standard_deviation * posterior->standard_deviation ==
+            Approx(standard_deviation * standard_deviation).epsilon(0.25));
+    REQUIRE(posterior->diagnostics.r_hat < 1.05);
+}
+
+
+// Hidden, run it by its name
+TEST_CASE("PosteriorSampler benchmark", "[.][benchmark]") {
+    const Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const Eigen::VectorXd optimum = 0.5 * (lower_bounds + upper_bounds);
+    SamplerParameters parameters;
+    parameters.total_chains = 1;
+    parameters.total_workers = 1;
+    parameters.burn_in = 1000;
+    parameters.total_samples = 10000;
+    parameters.output_path = "";
+    const double total_steps = parameters.burn_in + parameters.total_samples;
+
+    for (Proposal proposal : {Proposal::adaptive_metropolis, Proposal::mala}) {
+        parameters.proposal = proposal;
+        PosteriorSampler sampler(problem, generator, SolverParameters(), parameters);
+        const auto start = std::chrono::steady_clock::now();
+        sampler.Run(optimum);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        WARN((proposal == Proposal::mala ? "MALA: " : "Adaptive Metropolis: ") << total_steps / seconds
+             << " steps per second");
+    }
+}
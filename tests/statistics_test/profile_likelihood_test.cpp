@@ -0,0 +1,139 @@
+#include "catch/catch.hpp"
+#include "solver/solver.h"
+#include "statistics/flux_map.h"
+#include "statistics/profile_likelihood.h"
+#include "utilities/free_flux_bounds.h"
+#include "../solver_test/solver_test_utilities.h"
+
+using namespace khnum;
+
+
+namespace {
+// The SSR of the refit with the flux pinned at the value
+double GetPinnedSsr(Solver &solver, const Eigen::VectorXd &coefficients, double value,
+                    const Eigen::VectorXd &optimum) {
+    const Eigen::VectorXd initial_point =
+        optimum + coefficients * ((value - coefficients.dot(optimum)) / coefficients.squaredNorm());
+    solver.PinFlux(coefficients, value);
+    const StartResult result = solver.SolveFromStart(0, 0, initial_point);
+    solver.UnpinFlux();
+    return result.ssr;
+}
+
+
+// The measurements are simulated at the middle of the bounds, so it's the optimum with zero SSR.
+// The small errors make the intervals narrower than the bounds, with the large ones the profiles reach the bounds
+Eigen::VectorXd SetOptimumAtMiddle(Problem &problem, const SimulatorGenerator &generator,
+                                   const SolverParameters &solver_parameters, double error) {
+    for (Measurement &measurement : problem.measurements) {
+        measurement.errors.assign(measurement.errors.size(), error);
+    }
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    const Eigen::VectorXd optimum = 0.5 * (lower_bounds + upper_bounds);
+    Eigen::VectorXd residuals;
+    Solver(problem, generator, solver_parameters).CalculateResiduals(optimum, residuals);
+    int residual = 0;
+    for (Measurement &measurement : problem.measurements) {
+        for (size_t mass_shift = 0; mass_shift < measurement.mid.size(); ++mass_shift) {
+            measurement.mid[mass_shift] += measurement.errors[mass_shift] * residuals(residual++);
+        }
+    }
+    return optimum;
+}
+} // namespace
+
+
+TEST_CASE("GetFluxMap()", "[Statistics]") {
+    const Problem problem = CreateTinyProblem();
+    const FluxMap flux_map = GetFluxMap(problem);
+    const int nullity = problem.nullspace.cols();
+    REQUIRE(flux_map.coefficients.rows() == static_cast<int>(problem.reactions_total));
+    REQUIRE(flux_map.coefficients.bottomRows(nullity) == Matrix::Identity(nullity, nullity));
+    REQUIRE(flux_map.coefficients.middleRows(problem.reactions_total - nullity - problem.nullspace.rows(),
+                                             problem.nullspace.rows()) == -problem.nullspace);
+    for (int reaction = problem.reactions_total - nullity - problem.nullspace.rows();
+         reaction < static_cast<int>(problem.reactions_total); ++reaction) {
+        REQUIRE(IsModelFlux(flux_map, reaction));
+    }
+}
+
+
+TEST_CASE("ProfileLikelihood", "[Statistics]") {
+    Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const SolverParameters solver_parameters;
+    const Eigen::VectorXd optimum = SetOptimumAtMiddle(problem, generator, solver_parameters, 1.e-3);
+    const int nullity = problem.nullspace.cols();
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    std::vector<int> reactions;
+    for (int i = 0; i < nullity; ++i) {
+        if (lower_bounds(i) < upper_bounds(i)) {
+            reactions.push_back(problem.reactions_total - nullity + i);
+        }
+    }
+    REQUIRE(!reactions.empty());
+
+    ProfileParameters parameters;
+    parameters.total_workers = 1;
+    const std::vector<FluxInterval> intervals =
+        ProfileLikelihood(problem, generator, solver_parameters, parameters).Run(optimum, 0.0, reactions);
+    REQUIRE(intervals.size() == reactions.size());
+
+    const FluxMap flux_map = GetFluxMap(problem);
+    Solver solver(problem, generator, solver_parameters);
+    solver.SetStepTolerance(parameters.epsx);
+    for (const FluxInterval &interval : intervals) {
+        // the profile brackets the optimum
+        REQUIRE(interval.value == Approx(optimum(interval.reaction - problem.reactions_total + nullity)));
+        REQUIRE(interval.lower < interval.value);
+        REQUIRE(interval.value < interval.upper);
+
+        // and stops where the SSR increase crosses the threshold
+        const Eigen::VectorXd coefficients = flux_map.coefficients.row(interval.reaction).transpose();
+        for (const auto &[value, is_found] : {std::make_pair(interval.lower, interval.is_lower_found),
+                                               std::make_pair(interval.upper, interval.is_upper_found)}) {
+            const double ssr = GetPinnedSsr(solver, coefficients, value, optimum);
+            if (is_found) {
+                REQUIRE(ssr == Approx(parameters.threshold).epsilon(0.1));
+            } else {
+                REQUIRE(ssr < parameters.threshold);
+            }
+        }
+    }
+}
+
+
+TEST_CASE("ProfileLikelihood with the flux offsets", "[Statistics]") {
+    Problem problem = CreateTinyProblem();
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const SolverParameters solver_parameters;
+    const Eigen::VectorXd optimum = SetOptimumAtMiddle(problem, generator, solver_parameters, 1.0);
+    const int nullity = problem.nullspace.cols();
+    const auto [lower_bounds, upper_bounds] = GetFreeFluxBounds(problem);
+    std::vector<int> reactions;
+    for (int i = 0; i < nullity && reactions.empty(); ++i) {
+        if (lower_bounds(i) < upper_bounds(i)) {
+            reactions.push_back(problem.reactions_total - nullity + i);
+        }
+    }
+    REQUIRE(!reactions.empty());
+
+    // the offset only moves the interval, the walk stops at the same feasible limits
+    ProfileParameters parameters;
+    parameters.total_workers = 1;
+    const FluxMap flux_map = GetFluxMap(problem);
+    FluxMap shifted_flux_map = flux_map;
+    const double offset = -10.0 * (upper_bounds - lower_bounds).maxCoeff();
+    shifted_flux_map.offsets(reactions.front()) = offset;
+    const FluxInterval interval =
+        ProfileLikelihood(problem, generator, solver_parameters, parameters, flux_map).Run(optimum, 0.0, reactions)[0];
+    const FluxInterval shifted_interval =
+        ProfileLikelihood(problem, generator, solver_parameters, parameters, shifted_flux_map)
+            .Run(optimum, 0.0, reactions)[0];
+    REQUIRE(shifted_interval.value - offset == Approx(interval.value));
+    REQUIRE(shifted_interval.lower - offset == Approx(interval.lower));
+    REQUIRE(shifted_interval.upper - offset == Approx(interval.upper));
+    REQUIRE(shifted_interval.is_lower_found == interval.is_lower_found);
+    REQUIRE(shifted_interval.is_upper_found == interval.is_upper_found);
+    REQUIRE(shifted_interval.refits == interval.refits);
+}
@@ -0,0 +1,28 @@
+#include <cmath>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "statistics/quantile.h"
+
+using namespace khnum;
+
+
+TEST_CASE("GetQuantile()", "[Statistics]") {
+    SECTION("Between the ranks") {
+        const std::vector<double> values = {1.0, 2.0, 4.0, 8.0, 16.0};
+        REQUIRE(GetQuantile(values, 0.0) == 1.0);
+        REQUIRE(GetQuantile(values, 0.5) == 4.0);
+        REQUIRE(GetQuantile(values, 1.0) == 16.0);
+        REQUIRE(GetQuantile(values, 0.125) == Approx(1.5));
+        REQUIRE(GetQuantile(values, 0.875) == Approx(12.0));
+    }
+
+    SECTION("One value") {
+        REQUIRE(GetQuantile({3.0}, 0.025) == 3.0);
+        REQUIRE(GetQuantile({3.0}, 0.975) == 3.0);
+    }
+
+    SECTION("No values") {
+        REQUIRE(std::isnan(GetQuantile({}, 0.5)));
+    }
+}